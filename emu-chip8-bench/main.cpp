@@ -0,0 +1,404 @@
+// Throughput benchmark over ROM archives: each program is run for a fixed count of
+// frames with the same scripted input, and timed through run() and doCycle() both.
+
+#include "zip.h"
+
+#include "chip8/Chip8Batch.h"
+#include "chip8/Chip8Display.h"
+#include "chip8/Chip8Interpreter.h"
+#include "chip8/Chip8InterpreterImpl.h"
+#include "chip8/Chip8Keyboard.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif // _WIN32
+
+using namespace chip8;
+
+namespace {
+
+	typedef BasicInterpreter<PackedDisplay, NullKeyPad, FastAccess> BenchInterpreter;
+
+	struct Options {
+		std::vector<const char *> archives;
+		const char *jsonFile;
+		const char *match;									// Only programs, which path contains it.
+
+		chip8::clock frames;
+		chip8::clock frameCycles;
+		size_t repeat;										// Runs per program, the fastest one counts.
+		bool recompiler;
+	};
+
+	const Options OPTIONS_DEFAULT = {
+		{},
+		nullptr,
+		nullptr,
+
+		3600,												// a minute of 60Hz frames
+		1466,												// machine cycles per frame, as the client runs
+		3,
+		false
+	};
+
+	struct Measure {
+		chip8::clock cycles;
+		chip8::clock instructions;
+		chip8::clock calls;									// Calls to run() or doCycle() taken.
+		InterpreterBase::Error error;
+		uint64_t frameHash;
+
+		double seconds;										// Fastest of the runs.
+	};
+
+	struct Result {
+		std::string archive;
+		std::string name;
+		size_t size;
+
+		Measure run;										// Frames went through run().
+		Measure step;										// Frames went through doCycle() one by one.
+
+		size_t peakRSS;										// KiB, zero if unknown.
+	};
+
+	// Input is the same for all the programs: a key out of a fixed pseudo-random
+	// sequence is held for a few frames every half a second, so that menus
+	// and games go on. Returns the keys held from the frame given on.
+	PadKeys scriptedKeys(chip8::clock frame) {
+		if (frame % 30 >= 6) {
+			return KEY_NONE;
+		}
+		uint32_t hash = uint32_t(frame / 30) * 0x9E3779B1U;
+		hash ^= hash >> 15;
+
+		return PadKeys(1 << (hash % 16));
+	}
+
+	// Peak RSS is reset before each program on Linux, elsewhere it's the process-wide one.
+	void resetPeakRSS() {
+#if defined(__linux__)
+		std::ofstream clearRefs("/proc/self/clear_refs");
+		clearRefs << "5";
+#endif // __linux__
+	}
+
+	size_t getPeakRSS() {
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+			return counters.PeakWorkingSetSize / 1024;
+		}
+		return 0;
+#elif defined(__linux__)
+		std::ifstream status("/proc/self/status");
+		std::string line;
+
+		while (std::getline(status, line)) {
+			if (line.compare(0, 6, "VmHWM:") == 0) {
+				return size_t(strtoull(line.c_str() + 6, nullptr, 10));
+			}
+		}
+		return 0;
+#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+			return size_t(usage.ru_maxrss / 1024);
+#else
+			return size_t(usage.ru_maxrss);
+#endif // __APPLE__
+		}
+		return 0;
+#endif // _WIN32
+	}
+
+	// ROMs are the files with .ch8/.c8x extensions or with none (as in c8games.zip).
+	bool isProgram(const std::string &name) {
+		const size_t slash = name.rfind('/');
+		const size_t dot = name.rfind('.');
+
+		if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+			return true;
+		}
+		const std::string extension = name.substr(dot);
+		return extension == ".ch8" || extension == ".c8x";
+	}
+
+	Measure measure(const Options &options, const std::vector<unsigned char> &program, bool stepping) {
+		Measure result = { 0, 0, 0, InterpreterBase::INTERPRETER_ERROR_OK, 0, 0 };
+
+		NullKeyPad keyPad;
+		PackedDisplay display;
+		BenchInterpreter interpreter(&display, &keyPad);
+		std::vector<byte> frame(display.area());
+
+		interpreter.enableRecompiler(options.recompiler);
+
+		const chip8::clock cyclesTotal = options.frames * options.frameCycles;
+
+		for (size_t run = 0; run < options.repeat; ++run) {
+			interpreter.setQuirks(InterpreterBase::QUIRK_SHIFT_VX);
+			interpreter.setSeed(0);
+			interpreter.reset(program.data(), program.size());
+
+			PadKeys keys = KEY_NONE;
+			result.calls = 0;
+
+			const auto started = std::chrono::steady_clock::now();
+
+			while (interpreter.isOk() && interpreter.getCyclesCount() < cyclesTotal) {
+				const chip8::clock cycles = interpreter.getCyclesCount();
+				const chip8::clock frameIndex = cycles / options.frameCycles;
+				const chip8::clock frameEnd = (frameIndex + 1) * options.frameCycles;
+
+				if (scriptedKeys(frameIndex) != keys) {
+					keys = scriptedKeys(frameIndex);
+					interpreter.scheduleKeys(frameIndex * options.frameCycles, keys);
+				}
+				if (stepping) {
+					while (interpreter.isOk() && interpreter.getCyclesCount() < frameEnd) {
+						interpreter.doCycle();
+						++result.calls;
+					}
+				}
+				else {
+					interpreter.run(frameEnd - cycles);
+					++result.calls;
+				}
+			}
+
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+			if (run == 0 || seconds < result.seconds) {
+				result.seconds = seconds;
+			}
+		}
+		display.unpack(frame.data());
+
+		result.cycles = interpreter.getCyclesCount();
+		result.instructions = interpreter.getInstructionsCount();
+		result.error = interpreter.getLastError();
+		result.frameHash = Batch::hashFrame(frame.data(), frame.size());
+
+		return result;
+	}
+
+	double perSecond(chip8::clock count, double seconds) {
+		return seconds > 0 ? count / seconds : 0.0;
+	}
+
+	double nanosecondsPer(double seconds, chip8::clock count) {
+		return count > 0 ? seconds * 1e9 / count : 0.0;
+	}
+
+	std::string quoted(const std::string &text) {
+		std::string result = "\"";
+
+		for (char symbol : text) {
+			if (symbol == '"' || symbol == '\\') {
+				result += '\\';
+				result += symbol;
+			}
+			else if (static_cast<unsigned char>(symbol) < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", symbol);
+				result += escaped;
+			}
+			else {
+				result += symbol;
+			}
+		}
+		return result + "\"";
+	}
+
+	void writeMeasure(FILE *file, const char *name, const Measure &measure) {
+		fprintf(file,
+			"\"%s\": { \"cycles\": %llu, \"instructions\": %llu, \"error\": \"%s\", \"frame_hash\": \"0x%016llx\", "
+			"\"seconds\": %.9f, \"instructions_per_second\": %.0f, \"cycles_per_second\": %.0f, \"ns_per_instruction\": %.3f }",
+			name, measure.cycles, measure.instructions, InterpreterBase::errorName(measure.error),
+			static_cast<unsigned long long>(measure.frameHash), measure.seconds,
+			perSecond(measure.instructions, measure.seconds), perSecond(measure.cycles, measure.seconds),
+			nanosecondsPer(measure.seconds, measure.instructions));
+	}
+
+	bool writeJSON(const char *fileName, const Options &options, const std::vector<Result> &results) {
+		FILE *file = fopen(fileName, "w");
+		if (!file) {
+			fprintf(stderr, "Can't write results: %s\n", fileName);
+			return false;
+		}
+		fprintf(file, "{\n\t\"frames\": %llu,\n\t\"frame_cycles\": %llu,\n\t\"repeat\": %zu,\n\t\"programs\": [\n",
+			options.frames, options.frameCycles, options.repeat);
+
+		for (size_t i = 0; i < results.size(); ++i) {
+			const Result &result = results[i];
+
+			fprintf(file, "\t\t{ \"archive\": %s, \"name\": %s, \"size\": %zu, \"peak_rss_kib\": %zu,\n\t\t\t",
+				quoted(result.archive).c_str(), quoted(result.name).c_str(), result.size, result.peakRSS);
+			writeMeasure(file, "run", result.run);
+			fprintf(file, ",\n\t\t\t");
+			writeMeasure(file, "do_cycle", result.step);
+			fprintf(file, ",\n\t\t\t\"ns_per_do_cycle\": %.3f }%s\n",
+				nanosecondsPer(result.step.seconds, result.step.calls), i + 1 < results.size() ? "," : "");
+		}
+		fprintf(file, "\t]\n}\n");
+
+		const bool ok = !ferror(file);
+		fclose(file);
+
+		return ok;
+	}
+
+	void printUsage(const char *name) {
+		fprintf(stderr,
+			"Usage: %s [options] <archive.zip>...\n"
+			"\n"
+			"  -f, --frames N        frames to run each program for (default %llu)\n"
+			"      --frame-cycles N  machine cycles per frame (default %llu)\n"
+			"  -n, --repeat N        runs per program, the fastest one counts (default %zu)\n"
+			"  -m, --match TEXT      run only programs, which path contains the text\n"
+			"  -r, --recompiler      run native code translated from the programs\n"
+			"  -j, --json FILE       write the results as JSON\n"
+			"  -h, --help            print this help\n",
+			name, OPTIONS_DEFAULT.frames, OPTIONS_DEFAULT.frameCycles, OPTIONS_DEFAULT.repeat);
+	}
+
+	bool parseNumber(const char *text, chip8::clock &value) {
+		char *end = nullptr;
+		value = strtoull(text, &end, 0);
+
+		return !!*text && !*end;
+	}
+
+	bool parseOptions(int argc, char *argv[], Options &options) {
+		options = OPTIONS_DEFAULT;
+
+		for (int i = 1; i < argc; ++i) {
+			const std::string arg = argv[i];
+			const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+			chip8::clock number = 0;
+
+			if (arg == "-h" || arg == "--help") {
+				return false;
+			}
+			if (arg[0] != '-') {
+				options.archives.push_back(argv[i]);
+				continue;
+			}
+			if (arg == "-r" || arg == "--recompiler") {
+				options.recompiler = true;
+				continue;
+			}
+			if (!value) {
+				return false;
+			}
+			++i;
+
+			if (arg == "-j" || arg == "--json") {
+				options.jsonFile = value;
+			}
+			else if (arg == "-m" || arg == "--match") {
+				options.match = value;
+			}
+			else if (!parseNumber(value, number) || number == 0) {
+				return false;
+			}
+			else if (arg == "-f" || arg == "--frames") {
+				options.frames = number;
+			}
+			else if (arg == "--frame-cycles") {
+				options.frameCycles = number;
+			}
+			else if (arg == "-n" || arg == "--repeat") {
+				options.repeat = size_t(number);
+			}
+			else {
+				return false;
+			}
+		}
+		return !options.archives.empty();
+	}
+
+} // namespace
+
+
+int main(int argc, char *argv[]) {
+	Options options;
+
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 2;
+	}
+	if (options.recompiler) {
+		NullKeyPad keyPad;
+		PackedDisplay display;
+
+		if (!BenchInterpreter(&display, &keyPad).enableRecompiler(true)) {
+			fprintf(stderr, "Can't run native code on this host\n");
+			return 2;
+		}
+	}
+
+	std::vector<Result> results;
+	Measure total = { 0, 0, 0, InterpreterBase::INTERPRETER_ERROR_OK, 0, 0 };
+
+	printf("%-56s %8s %12s %10s %10s %10s  %s\n", "program", "size", "instructions", "MIPS", "ns/doCycle", "peak KiB", "error");
+
+	for (const char *archive : options.archives) {
+		std::vector<zip::Entry> entries;
+		std::string error;
+
+		if (!zip::read(archive, entries, error)) {
+			fprintf(stderr, "Can't read %s: %s\n", archive, error.c_str());
+			return 2;
+		}
+
+		for (const zip::Entry &entry : entries) {
+			if (!isProgram(entry.name) || (!!options.match && entry.name.find(options.match) == std::string::npos)) {
+				continue;
+			}
+			Result result;
+			result.archive = archive;
+			result.name = entry.name;
+			result.size = entry.data.size();
+
+			resetPeakRSS();
+			result.run = measure(options, entry.data, false);
+			result.step = measure(options, entry.data, true);
+			result.peakRSS = getPeakRSS();
+
+			printf("%-56.56s %8zu %12llu %10.1f %10.2f %10zu  %s\n",
+				result.name.c_str(), result.size, result.run.instructions,
+				perSecond(result.run.instructions, result.run.seconds) / 1e6,
+				nanosecondsPer(result.step.seconds, result.step.calls),
+				result.peakRSS, InterpreterBase::errorName(result.run.error));
+
+			total.cycles += result.run.cycles;
+			total.instructions += result.run.instructions;
+			total.seconds += result.run.seconds;
+
+			results.push_back(result);
+		}
+	}
+	printf("\n%zu programs, %llu instructions, %llu cycles in %.3f s: %.1f MIPS, %.1f M cycles/s\n",
+		results.size(), total.instructions, total.cycles, total.seconds,
+		perSecond(total.instructions, total.seconds) / 1e6, perSecond(total.cycles, total.seconds) / 1e6);
+
+	if (!!options.jsonFile && !writeJSON(options.jsonFile, options, results)) {
+		return 2;
+	}
+	return 0;
+}
@@ -0,0 +1,416 @@
+#include "zip.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+
+namespace zip {
+
+	namespace {
+
+		typedef std::vector<unsigned char> Bytes;
+
+		enum : uint32_t {
+			SIGNATURE_LOCAL			= 0x04034B50,
+			SIGNATURE_CENTRAL		= 0x02014B50,
+			SIGNATURE_END			= 0x06054B50
+		};
+
+		enum : unsigned {
+			METHOD_STORED			= 0,
+			METHOD_DEFLATED			= 8
+		};
+
+		enum : size_t {
+			SIZE_LOCAL				= 30,
+			SIZE_CENTRAL			= 46,
+			SIZE_END				= 22,
+
+			COMMENT_MAX				= 0xFFFF
+		};
+
+		uint32_t read16(const Bytes &data, size_t offset) {
+			return data[offset] | (data[offset + 1] << 8);
+		}
+		uint32_t read32(const Bytes &data, size_t offset) {
+			return read16(data, offset) | (read16(data, offset + 2) << 16);
+		}
+
+		uint32_t crc32(const Bytes &data) {
+			static uint32_t table[0x100];
+
+			if (table[1] == 0) {
+				for (uint32_t i = 0; i < 0x100; ++i) {
+					uint32_t crc = i;
+					for (size_t bit = 0; bit < 8; ++bit) {
+						crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+					}
+					table[i] = crc;
+				}
+			}
+			uint32_t crc = 0xFFFFFFFF;
+			for (unsigned char value : data) {
+				crc = table[(crc ^ value) & 0xFF] ^ (crc >> 8);
+			}
+			return ~crc;
+		}
+
+
+		// ========================================================
+		// inflate (RFC 1951)
+		//
+		// Plain canonical Huffman decoding a bit at a time, as
+		// archived programs are a few kilobytes at most.
+		// ========================================================
+
+		enum : size_t {
+			CODE_BITS_MAX			= 15,
+			LITERALS_MAX			= 288,
+			DISTANCES_MAX			= 30
+		};
+
+		struct Huffman {
+			short count[CODE_BITS_MAX + 1];					// Codes of each length.
+			short symbol[LITERALS_MAX];						// Symbols in canonical order.
+		};
+
+		class Inflater {
+
+			const unsigned char *in;
+			size_t inSize;
+			size_t inPos;
+
+			uint32_t bits;
+			size_t bitsCount;
+
+			Bytes &out;
+
+			bool overrun;
+
+			uint32_t need(size_t count) {
+				while (bitsCount < count) {
+					if (inPos == inSize) {
+						overrun = true;
+						return 0;
+					}
+					bits |= uint32_t(in[inPos++]) << bitsCount;
+					bitsCount += 8;
+				}
+				const uint32_t value = bits & ((1U << count) - 1);
+				bits >>= count;
+				bitsCount -= count;
+
+				return value;
+			}
+
+			int decode(const Huffman &huffman) {
+				int code = 0, first = 0, index = 0;
+
+				for (size_t length = 1; length <= CODE_BITS_MAX; ++length) {
+					code |= need(1);
+
+					const int count = huffman.count[length];
+					if (code - count < first) {
+						return huffman.symbol[index + (code - first)];
+					}
+					index += count;
+					first = (first + count) << 1;
+					code <<= 1;
+				}
+				return -1;
+			}
+
+			// Returns false, if lengths over-subscribe the codes.
+			static bool build(Huffman &huffman, const short *lengths, size_t count) {
+				short offsets[CODE_BITS_MAX + 1];
+
+				memset(huffman.count, 0, sizeof(huffman.count));
+				for (size_t i = 0; i < count; ++i) {
+					++huffman.count[lengths[i]];
+				}
+
+				int left = 1;
+				for (size_t length = 1; length <= CODE_BITS_MAX; ++length) {
+					left = (left << 1) - huffman.count[length];
+					if (left < 0) {
+						return false;
+					}
+				}
+
+				offsets[1] = 0;
+				for (size_t length = 1; length < CODE_BITS_MAX; ++length) {
+					offsets[length + 1] = offsets[length] + huffman.count[length];
+				}
+				for (size_t i = 0; i < count; ++i) {
+					if (lengths[i] != 0) {
+						huffman.symbol[offsets[lengths[i]]++] = short(i);
+					}
+				}
+				return true;
+			}
+
+			bool stored() {
+				bits = 0;
+				bitsCount = 0;
+
+				if (inPos + 4 > inSize) {
+					return false;
+				}
+				const size_t length = in[inPos] | (in[inPos + 1] << 8);
+				const size_t complement = in[inPos + 2] | (in[inPos + 3] << 8);
+				inPos += 4;
+
+				if (length != (~complement & 0xFFFF) || inPos + length > inSize) {
+					return false;
+				}
+				out.insert(out.end(), in + inPos, in + inPos + length);
+				inPos += length;
+
+				return true;
+			}
+
+			bool codes(const Huffman &literals, const Huffman &distances) {
+				static const short lengthBase[29] = {
+					3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+					35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+				static const short lengthExtra[29] = {
+					0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+					3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+				static const short distanceBase[30] = {
+					1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+					257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+				static const short distanceExtra[30] = {
+					0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+					7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+				for (;;) {
+					int symbol = decode(literals);
+
+					if (symbol < 0 || overrun) {
+						return false;
+					}
+					if (symbol < 0x100) {
+						out.push_back((unsigned char)(symbol));
+						continue;
+					}
+					if (symbol == 0x100) {
+						return true;
+					}
+					symbol -= 257;
+					if (symbol >= 29) {
+						return false;
+					}
+					const size_t length = lengthBase[symbol] + need(lengthExtra[symbol]);
+
+					symbol = decode(distances);
+					if (symbol < 0 || symbol >= 30) {
+						return false;
+					}
+					const size_t distance = distanceBase[symbol] + need(distanceExtra[symbol]);
+
+					if (distance > out.size() || overrun) {
+						return false;
+					}
+					for (size_t i = 0; i < length; ++i) {
+						out.push_back(out[out.size() - distance]);
+					}
+				}
+			}
+
+			bool fixed() {
+				static Huffman literals, distances;
+
+				if (literals.count[7] == 0) {
+					short lengths[LITERALS_MAX];
+					size_t symbol = 0;
+
+					for (; symbol < 144; ++symbol) lengths[symbol] = 8;
+					for (; symbol < 256; ++symbol) lengths[symbol] = 9;
+					for (; symbol < 280; ++symbol) lengths[symbol] = 7;
+					for (; symbol < LITERALS_MAX; ++symbol) lengths[symbol] = 8;
+					build(literals, lengths, LITERALS_MAX);
+
+					for (symbol = 0; symbol < DISTANCES_MAX; ++symbol) lengths[symbol] = 5;
+					build(distances, lengths, DISTANCES_MAX);
+				}
+				return codes(literals, distances);
+			}
+
+			bool dynamic() {
+				static const unsigned char order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+				short lengths[LITERALS_MAX + DISTANCES_MAX] = { 0 };
+				Huffman lengthCodes, literals, distances;
+
+				const size_t literalsCount = need(5) + 257;
+				const size_t distancesCount = need(5) + 1;
+				const size_t codesCount = need(4) + 4;
+
+				if (literalsCount > LITERALS_MAX || distancesCount > DISTANCES_MAX) {
+					return false;
+				}
+				for (size_t i = 0; i < codesCount; ++i) {
+					lengths[order[i]] = short(need(3));
+				}
+				if (!build(lengthCodes, lengths, 19)) {
+					return false;
+				}
+
+				for (size_t index = 0; index < literalsCount + distancesCount; ) {
+					const int symbol = decode(lengthCodes);
+
+					if (symbol < 0 || overrun) {
+						return false;
+					}
+					if (symbol < 16) {
+						lengths[index++] = short(symbol);
+						continue;
+					}
+					short length = 0;
+					size_t repeat;
+
+					if (symbol == 16) {
+						if (index == 0) {
+							return false;
+						}
+						length = lengths[index - 1];
+						repeat = 3 + need(2);
+					}
+					else if (symbol == 17) {
+						repeat = 3 + need(3);
+					}
+					else {
+						repeat = 11 + need(7);
+					}
+					if (index + repeat > literalsCount + distancesCount) {
+						return false;
+					}
+					while (repeat--) {
+						lengths[index++] = length;
+					}
+				}
+				if (lengths[0x100] == 0
+					|| !build(literals, lengths, literalsCount)
+					|| !build(distances, lengths + literalsCount, distancesCount)) {
+
+					return false;
+				}
+				return codes(literals, distances);
+			}
+
+		public:
+
+			Inflater(const unsigned char *in, size_t inSize, Bytes &out)
+				: in(in), inSize(inSize), inPos(0), bits(0), bitsCount(0), out(out), overrun(false) {
+
+				/* Nothing to do */
+			}
+
+			bool run() {
+				for (bool last = false; !last; ) {
+					last = !!need(1);
+
+					bool ok;
+					switch (need(2)) {
+					case 0:		ok = stored();		break;
+					case 1:		ok = fixed();		break;
+					case 2:		ok = dynamic();		break;
+					default:	ok = false;			break;
+					}
+					if (!ok || overrun) {
+						return false;
+					}
+				}
+				return true;
+			}
+		};
+
+	} // namespace
+
+
+	bool read(const char *fileName, std::vector<Entry> &entries, std::string &error) {
+		std::ifstream stream(fileName, std::ios_base::binary);
+		if (!stream) {
+			error = "can't open the file";
+			return false;
+		}
+		const Bytes archive((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+		// End of central directory goes last, followed by a comment only.
+		const size_t endMin = archive.size() > SIZE_END + COMMENT_MAX ? archive.size() - SIZE_END - COMMENT_MAX : 0;
+		size_t end = archive.size() >= SIZE_END ? archive.size() - SIZE_END + 1 : 0;
+
+		bool found = false;
+		while (!found && end-- > endMin) {
+			found = read32(archive, end) == SIGNATURE_END;
+		}
+		if (!found) {
+			error = "no central directory";
+			return false;
+		}
+
+		const size_t count = read16(archive, end + 10);
+		size_t offset = read32(archive, end + 16);
+
+		for (size_t i = 0; i < count; ++i) {
+			if (offset + SIZE_CENTRAL > archive.size() || read32(archive, offset) != SIGNATURE_CENTRAL) {
+				error = "corrupted central directory";
+				return false;
+			}
+			const unsigned method = read16(archive, offset + 10);
+			const uint32_t crc = read32(archive, offset + 16);
+			const size_t packedSize = read32(archive, offset + 20);
+			const size_t size = read32(archive, offset + 24);
+			const size_t nameLength = read16(archive, offset + 28);
+			const size_t local = read32(archive, offset + 42);
+
+			const size_t next = offset + SIZE_CENTRAL + nameLength
+				+ read16(archive, offset + 30) + read16(archive, offset + 32);
+
+			if (next > archive.size()) {
+				error = "corrupted central directory";
+				return false;
+			}
+			Entry entry;
+			entry.name.assign(archive.begin() + offset + SIZE_CENTRAL, archive.begin() + offset + SIZE_CENTRAL + nameLength);
+			offset = next;
+
+			if (!entry.name.empty() && entry.name.back() == '/') {
+				continue;
+			}
+
+			if (local + SIZE_LOCAL > archive.size() || read32(archive, local) != SIGNATURE_LOCAL) {
+				error = "corrupted entry " + entry.name;
+				return false;
+			}
+			const size_t data = local + SIZE_LOCAL + read16(archive, local + 26) + read16(archive, local + 28);
+			if (data + packedSize > archive.size()) {
+				error = "corrupted entry " + entry.name;
+				return false;
+			}
+
+			entry.data.reserve(size);
+			if (method == METHOD_STORED) {
+				entry.data.assign(archive.begin() + data, archive.begin() + data + packedSize);
+			}
+			else if (method != METHOD_DEFLATED) {
+				error = "unsupported compression of " + entry.name;
+				return false;
+			}
+			else if (!Inflater(archive.data() + data, packedSize, entry.data).run()) {
+				error = "corrupted data of " + entry.name;
+				return false;
+			}
+
+			if (entry.data.size() != size || crc32(entry.data) != crc) {
+				error = "CRC mismatch of " + entry.name;
+				return false;
+			}
+			entries.push_back(std::move(entry));
+		}
+		return true;
+	}
+
+} // namespace zip
@@ -0,0 +1,23 @@
+#pragma once
+
+#ifndef BENCH_ZIP_
+#define BENCH_ZIP_
+
+#include <string>
+#include <vector>
+
+namespace zip {
+
+	struct Entry {
+		std::string name;									// Path within the archive, '/' separated.
+		std::vector<unsigned char> data;
+	};
+
+	// Read all the files of an archive, which are stored or deflated (directories
+	// are skipped). Each file is checked against its CRC. Returns false and the
+	// reason, if the archive can't be read.
+	bool read(const char *fileName, std::vector<Entry> &entries, std::string &error);
+
+} // namespace zip
+
+#endif // BENCH_ZIP_
@@ -0,0 +1,490 @@
+// Headless runner: loads a program, runs it for a number of frames or cycles
+// with scripted input, then reports the final frame, cycles, error and speed.
+
+#include "chip8/Chip8Batch.h"
+#include "chip8/Chip8Display.h"
+#include "chip8/Chip8FramePacer.h"
+#include "chip8/Chip8Input.h"
+#include "chip8/Chip8Interpreter.h"
+#include "chip8/Chip8InterpreterImpl.h"
+#include "chip8/Chip8Keyboard.h"
+#include "chip8/Chip8Profiler.h"
+#include "chip8/Chip8Trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace chip8;
+
+namespace {
+
+	typedef BasicInterpreter<PackedDisplay, NullKeyPad, FastAccess> RunnerInterpreter;
+
+	enum : int {
+		EXIT_OK = 0,
+		EXIT_INTERPRETER_ERROR = 1,
+		EXIT_USAGE = 2
+	};
+
+	struct Options {
+		const char *program;
+		const char *keysFile;
+		const char *replayFile;								// Input log, its seed, quirks and cycles are taken.
+		const char *saveInputFile;
+		const char *pbmFile;
+		const char *countersFile;							// JSON, if the name ends with .json, text otherwise.
+		const char *profileFile;
+		const char *foldedFile;
+		const char *traceFile;
+		const char *decodeFile;								// Trace to print, instead of running a program.
+
+		chip8::clock frames;
+		chip8::clock cycles;								// Overrides frames, if not zero.
+		chip8::clock frameCycles;
+		chip8::clock sampleCycles;
+
+		unsigned quirks;
+		word seed;
+		bool recompiler;
+		bool realtime;
+	};
+
+	const Options OPTIONS_DEFAULT = {
+		nullptr,
+		nullptr,
+		nullptr,
+		nullptr,
+		nullptr,
+		nullptr,
+		nullptr,
+		nullptr,
+		nullptr,
+		nullptr,
+
+		600,												// 10 seconds of 60Hz frames
+		0,
+		1466,												// machine cycles per frame, as the client runs
+		101,												// prime, so that samples don't lock onto program loops
+
+		InterpreterBase::QUIRK_SHIFT_VX,
+		0,
+		false,
+		false
+	};
+
+	void printUsage(const char *name) {
+		fprintf(stderr,
+			"Usage: %s [options] <program>\n"
+			"       %s --decode FILE\n"
+			"\n"
+			"  -f, --frames N        frames to run (default %llu)\n"
+			"  -c, --cycles N        machine cycles to run, instead of frames\n"
+			"      --frame-cycles N  machine cycles per frame (default %llu)\n"
+			"  -q, --quirks N        quirk flags, see InterpreterBase::Quirk (default 0x%02X)\n"
+			"  -s, --seed N          random generator seed (default %u)\n"
+			"  -k, --keys FILE       input script, lines of \"<frame> <keys>\", where keys\n"
+			"                        are hex digits held, or '-' to release them all\n"
+			"      --replay FILE     play an input log back, with its seed, quirks and cycles\n"
+			"      --save-input FILE write the input the run took as an input log\n"
+			"  -o, --pbm FILE        write the final frame as a binary PBM image\n"
+			"  -r, --recompiler      run native code translated from the program\n"
+			"      --realtime        run frames at 60Hz, as the client does, and report pacing\n"
+			"      --counters FILE   write execution counters, as JSON if FILE ends with .json\n"
+			"                        (needs a build with CHIP8_COUNTERS)\n"
+			"  -p, --profile FILE    write hot routines and addresses of the program\n"
+			"      --folded FILE     write the program call stacks folded for flame graphs\n"
+			"      --sample-cycles N machine cycles between profile samples (default %llu)\n"
+			"  -t, --trace FILE      record each instruction executed to a binary trace\n"
+			"                        (needs a build with CHIP8_TRACE)\n"
+			"      --decode FILE     print a binary trace as text, a line per instruction\n"
+			"  -h, --help            print this help\n",
+			name, name, OPTIONS_DEFAULT.frames, OPTIONS_DEFAULT.frameCycles,
+			OPTIONS_DEFAULT.quirks, unsigned(OPTIONS_DEFAULT.seed), OPTIONS_DEFAULT.sampleCycles);
+	}
+
+	bool parseNumber(const char *text, chip8::clock &value) {
+		char *end = nullptr;
+		value = strtoull(text, &end, 0);
+
+		return !!*text && !*end;
+	}
+
+	bool parseOptions(int argc, char *argv[], Options &options) {
+		options = OPTIONS_DEFAULT;
+
+		for (int i = 1; i < argc; ++i) {
+			const std::string arg = argv[i];
+			const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+			chip8::clock number = 0;
+
+			if (arg == "-h" || arg == "--help") {
+				return false;
+			}
+			if (arg == "-r" || arg == "--recompiler") {
+				options.recompiler = true;
+				continue;
+			}
+			if (arg == "--realtime") {
+				options.realtime = true;
+				continue;
+			}
+			if (arg[0] != '-') {
+				if (!!options.program) {
+					return false;
+				}
+				options.program = argv[i];
+				continue;
+			}
+			if (!value) {
+				return false;
+			}
+			++i;
+
+			if (arg == "-k" || arg == "--keys") {
+				options.keysFile = value;
+			}
+			else if (arg == "--replay") {
+				options.replayFile = value;
+			}
+			else if (arg == "--save-input") {
+				options.saveInputFile = value;
+			}
+			else if (arg == "-o" || arg == "--pbm") {
+				options.pbmFile = value;
+			}
+			else if (arg == "--counters") {
+				options.countersFile = value;
+			}
+			else if (arg == "-p" || arg == "--profile") {
+				options.profileFile = value;
+			}
+			else if (arg == "--folded") {
+				options.foldedFile = value;
+			}
+			else if (arg == "-t" || arg == "--trace") {
+				options.traceFile = value;
+			}
+			else if (arg == "--decode") {
+				options.decodeFile = value;
+			}
+			else if (!parseNumber(value, number)) {
+				return false;
+			}
+			else if (arg == "-f" || arg == "--frames") {
+				options.frames = number;
+			}
+			else if (arg == "-c" || arg == "--cycles") {
+				options.cycles = number;
+			}
+			else if (arg == "--frame-cycles" && number > 0) {
+				options.frameCycles = number;
+			}
+			else if (arg == "--sample-cycles" && number > 0) {
+				options.sampleCycles = number;
+			}
+			else if ((arg == "-q" || arg == "--quirks") && number < InterpreterBase::QUIRKS_COUNT) {
+				options.quirks = unsigned(number);
+			}
+			else if ((arg == "-s" || arg == "--seed") && number <= 0xFFFF) {
+				options.seed = word(number);
+			}
+			else {
+				return false;
+			}
+		}
+		return !!options.program != !!options.decodeFile
+			&& !(!!options.keysFile && !!options.replayFile);
+	}
+
+	// Blank lines and '#' comments are skipped. Entries go in frame order,
+	// each holds keys from the start of its frame until the next one.
+	bool readKeys(const char *fileName, chip8::clock frameCycles, InputLog &log) {
+		std::ifstream stream(fileName);
+		if (!stream) {
+			fprintf(stderr, "Can't open input script: %s\n", fileName);
+			return false;
+		}
+
+		std::string line;
+		for (size_t lineNumber = 1; std::getline(stream, line); ++lineNumber) {
+			line = line.substr(0, line.find('#'));
+
+			std::istringstream fields(line);
+			std::string frame, keys;
+
+			if (!(fields >> frame)) {
+				continue;
+			}
+			chip8::clock timestamp = 0;
+			PadKeys held = KEY_NONE;
+
+			bool valid = parseNumber(frame.c_str(), timestamp) && !!(fields >> keys);
+			timestamp *= frameCycles;
+
+			valid = valid && (log.getEntries().empty() || log.getEntries().back().timestamp <= timestamp);
+
+			for (size_t i = 0; valid && keys != "-" && i < keys.size(); ++i) {
+				const char digit[] = { keys[i], '\0' };
+				char *end = nullptr;
+				const unsigned long key = strtoul(digit, &end, 16);
+
+				valid = !*end;
+				held = PadKeys(held | (1 << key));
+			}
+			if (!valid) {
+				fprintf(stderr, "%s:%zu: expected \"<frame> <keys>\" in frame order\n", fileName, lineNumber);
+				return false;
+			}
+			log.record(timestamp, held);
+		}
+		return true;
+	}
+
+	bool readInputLog(const char *fileName, InputLog &log) {
+		std::ifstream stream(fileName);
+		if (!stream) {
+			fprintf(stderr, "Can't open input log: %s\n", fileName);
+			return false;
+		}
+		if (!log.read(stream)) {
+			fprintf(stderr, "Not an input log: %s\n", fileName);
+			return false;
+		}
+		return true;
+	}
+
+	bool writeInputLog(const char *fileName, const InputLog &log) {
+		std::ofstream stream(fileName);
+		if (!stream || !log.write(stream)) {
+			fprintf(stderr, "Can't write input log: %s\n", fileName);
+			return false;
+		}
+		return true;
+	}
+
+	bool writePBM(const char *fileName, const PackedDisplay &display) {
+		std::ofstream stream(fileName, std::ios_base::binary);
+		if (!stream) {
+			fprintf(stderr, "Can't write frame: %s\n", fileName);
+			return false;
+		}
+		stream << "P4\n" << unsigned(display.width()) << ' ' << unsigned(display.height()) << '\n';
+
+		std::vector<byte> line(display.width());
+		std::vector<char> bits(display.width() / 8);
+
+		for (byte y = 0; y < display.height(); ++y) {
+			display.unpackLine(y, line.data());
+
+			std::fill(bits.begin(), bits.end(), 0);
+			for (size_t x = 0; x < line.size(); ++x) {
+				bits[x / 8] |= !!line[x] << (7 - x % 8);
+			}
+			stream.write(bits.data(), bits.size());
+		}
+		return !!stream;
+	}
+
+	bool writeProfile(const char *fileName, const Profiler &profiler, bool folded) {
+		std::ofstream stream(fileName);
+		if (!stream) {
+			fprintf(stderr, "Can't write profile: %s\n", fileName);
+			return false;
+		}
+		if (folded) {
+			profiler.writeFolded(stream);
+		}
+		else {
+			profiler.writeReport(stream);
+		}
+		return !!stream;
+	}
+
+	bool decodeTrace(const char *fileName) {
+		std::ifstream stream(fileName, std::ios_base::binary);
+		if (!stream) {
+			fprintf(stderr, "Can't open trace: %s\n", fileName);
+			return false;
+		}
+		if (!TraceRecorder::decode(stream, std::cout)) {
+			fprintf(stderr, "Not a trace: %s\n", fileName);
+			return false;
+		}
+		return true;
+	}
+
+	bool writeCounters(const char *fileName, const InterpreterBase::Counters &counters) {
+		if (!CHIP8_COUNTERS) {
+			fprintf(stderr, "Counters are off, rebuild with CHIP8_COUNTERS=1\n");
+			return false;
+		}
+		std::ofstream stream(fileName);
+		if (!stream) {
+			fprintf(stderr, "Can't write counters: %s\n", fileName);
+			return false;
+		}
+		const std::string name = fileName;
+
+		if (name.size() > 5 && name.compare(name.size() - 5, 5, ".json") == 0) {
+			InterpreterBase::writeCountersJSON(stream, counters);
+		}
+		else {
+			InterpreterBase::writeCounters(stream, counters);
+		}
+		return !!stream;
+	}
+
+} // namespace
+
+
+int main(int argc, char *argv[]) {
+	Options options;
+
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return EXIT_USAGE;
+	}
+
+	if (!!options.decodeFile) {
+		return decodeTrace(options.decodeFile) ? EXIT_OK : EXIT_USAGE;
+	}
+
+	// Scripted keys go through the same log as replayed ones.
+	InputLog input;
+	input.clear(options.seed, options.quirks);
+
+	if (!!options.keysFile && !readKeys(options.keysFile, options.frameCycles, input)) {
+		return EXIT_USAGE;
+	}
+	if (!!options.replayFile && !readInputLog(options.replayFile, input)) {
+		return EXIT_USAGE;
+	}
+
+	std::ifstream program(options.program, std::ios_base::binary);
+	if (!program) {
+		fprintf(stderr, "Can't open program: %s\n", options.program);
+		return EXIT_USAGE;
+	}
+
+	NullKeyPad keyPad;
+	PackedDisplay display;
+	RunnerInterpreter interpreter(&display, &keyPad);
+
+	InputReplay replay(input);
+	replay.prepare(interpreter);
+
+	if (interpreter.enableRecompiler(options.recompiler) != options.recompiler) {
+		fprintf(stderr, "Can't run native code on this host\n");
+		return EXIT_USAGE;
+	}
+	interpreter.reset(program);
+
+	Profiler profiler(options.sampleCycles, InterpreterBase::OFFSET_PROGRAM_START);
+	if (!!options.profileFile || !!options.foldedFile) {
+		interpreter.setProfiler(&profiler);
+	}
+
+	TraceRecorder tracer;
+	if (!!options.traceFile) {
+		if (!CHIP8_TRACE) {
+			fprintf(stderr, "Tracing is off, rebuild with CHIP8_TRACE=1\n");
+			return EXIT_USAGE;
+		}
+		if (!tracer.open(options.traceFile)) {
+			fprintf(stderr, "Can't write trace: %s\n", options.traceFile);
+			return EXIT_USAGE;
+		}
+		interpreter.setTracer(&tracer);
+	}
+
+	chip8::clock cyclesTotal = options.cycles > 0 ? options.cycles : options.frames * options.frameCycles;
+	if (!!options.replayFile && options.cycles == 0 && input.getCycles() > 0) {
+		cyclesTotal = input.getCycles();
+	}
+
+	// Frames are cycle ranges, each run ends on the first instruction boundary past the frame
+	// end. Frame boundaries don't depend on how far runs go past them, so neither do results.
+	const auto started = std::chrono::steady_clock::now();
+	FramePacer pacer;
+	chip8::clock framesPaced = 0;
+
+	while (interpreter.isOk() && interpreter.getCyclesCount() < cyclesTotal) {
+		const chip8::clock cycles = interpreter.getCyclesCount();
+
+		// Frames a run went past (a key await takes longer than a frame) are waited for too.
+		while (options.realtime && framesPaced <= cycles / options.frameCycles) {
+			pacer.wait();
+			++framesPaced;
+		}
+		const chip8::clock frameEnd = std::min<chip8::clock>((cycles / options.frameCycles + 1) * options.frameCycles, cyclesTotal);
+
+		replay.run(interpreter, frameEnd - cycles);
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+	interpreter.setTracer(nullptr);
+	if (!!options.traceFile) {
+		if (!tracer.close()) {
+			fprintf(stderr, "Can't write trace: %s\n", options.traceFile);
+			return EXIT_USAGE;
+		}
+	}
+	const chip8::clock frames = interpreter.getCyclesCount() / options.frameCycles;
+	const double secondsEmulated = double(interpreter.getCyclesCount()) / options.frameCycles / 60;
+
+	std::vector<byte> frame(display.area());
+	display.unpack(frame.data());
+
+	printf("program: %s\n", options.program);
+	printf("frames: %llu\n", frames);
+	printf("cycles: %llu\n", interpreter.getCyclesCount());
+	printf("instructions: %llu\n", interpreter.getInstructionsCount());
+	printf("error: %s\n", InterpreterBase::errorName(interpreter.getLastError()));
+	printf("frame_hash: 0x%016llx\n", static_cast<unsigned long long>(Batch::hashFrame(frame.data(), frame.size())));
+	printf("seconds: %.6f\n", seconds);
+	printf("instructions_per_second: %.0f\n", seconds > 0 ? interpreter.getInstructionsCount() / seconds : 0.0);
+	printf("cycles_per_second: %.0f\n", seconds > 0 ? interpreter.getCyclesCount() / seconds : 0.0);
+	printf("realtime_factor: %.1f\n", seconds > 0 ? secondsEmulated / seconds : 0.0);
+
+	if (options.realtime) {
+		const FramePacer::Stats &stats = pacer.getStats();
+		const double jitterMean = stats.frames > 0
+			? std::chrono::duration<double, std::micro>(stats.jitterTotal).count() / stats.frames : 0.0;
+
+		printf("pacer_late_frames: %llu\n", stats.late);
+		printf("pacer_restarts: %llu\n", stats.restarts);
+		printf("pacer_jitter_mean_us: %.1f\n", jitterMean);
+		printf("pacer_jitter_max_us: %.1f\n", std::chrono::duration<double, std::micro>(stats.jitterMax).count());
+		printf("pacer_slept_seconds: %.3f\n", std::chrono::duration<double>(stats.slept).count());
+		printf("pacer_spun_seconds: %.3f\n", std::chrono::duration<double>(stats.spun).count());
+		printf("pacer_spin_margin_us: %.1f\n", std::chrono::duration<double, std::micro>(pacer.getSpinMargin()).count());
+	}
+
+	input.setCycles(interpreter.getCyclesCount());
+
+	if (!!options.saveInputFile && !writeInputLog(options.saveInputFile, input)) {
+		return EXIT_USAGE;
+	}
+	if (!!options.pbmFile && !writePBM(options.pbmFile, display)) {
+		return EXIT_USAGE;
+	}
+	if (!!options.profileFile && !writeProfile(options.profileFile, profiler, false)) {
+		return EXIT_USAGE;
+	}
+	if (!!options.foldedFile && !writeProfile(options.foldedFile, profiler, true)) {
+		return EXIT_USAGE;
+	}
+	if (!!options.countersFile && !writeCounters(options.countersFile, interpreter.getCounters())) {
+		return EXIT_USAGE;
+	}
+	return interpreter.isOk() ? EXIT_OK : EXIT_INTERPRETER_ERROR;
+}
@@ -50,7 +50,7 @@ namespace platform {
 			}
 		}
 
-		virtual chip8::PadKeys getState() const {
+		chip8::PadKeys getState() const final {
 			return kbstate.load();
 		}
 	};
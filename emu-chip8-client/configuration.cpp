@@ -6,6 +6,10 @@ namespace config {
 
 	const Configuration Configuration::DEFAULT = {
 		1466,						// macine cycles per step
+		0x01,						// machine quirks (8XY6/8XYE shift VX)
+
+		0x400000,					// rewind history budget (bytes)
+		6,							// rewind snapshot interval (frames)
 
 		10,							// display cell size
 		{ 0x00, 0xA7, 0x00 },		// display cell color
@@ -8,6 +8,11 @@ namespace config {
 
 		// Interpretation
 		size_t machineCyclesPerStep;
+		unsigned machineQuirks;
+
+		// Rewind
+		size_t rewindBudget;
+		unsigned rewindInterval;
 
 		// Display
 		unsigned displayCellSize;
@@ -3,12 +3,15 @@
 
 #include "stdafx.h"
 
-#include "chip8\Chip8Interpreter.h"
+#include "chip8\Chip8InterpreterImpl.h"
 #include "chip8\Chip8Display.h"
+#include "chip8\Chip8Executor.h"
+#include "chip8\Chip8FrameChannel.h"
+#include "chip8\Chip8FramePacer.h"
+#include "chip8\Chip8Input.h"
+#include "chip8\Chip8Rewind.h"
 
-#include "NBufferedDisplay.h"
 #include "VKMappedKeyPad.h"
-#include "QueueThread.h"
 
 #include "main.h"
 #include "configuration.h"
@@ -29,54 +32,71 @@
 #define INTERPRETATION_EVENT_ERROR		3
 
 
+// Interpreter bound to the client devices at compile time,
+// so that its hot paths call them directly, with no virtual dispatch.
+// Keys are logged as the interpreter sees them, see chip8::InputLog.
+typedef chip8::RecordingKeyPad<platform::VKMappedKeypad> ClientKeyPad;
+typedef chip8::BasicInterpreter<chip8::FrameChannel, ClientKeyPad, chip8::FastAccess> ClientInterpreter;
+
+
 class Interpretation {
 
-	platform::NBufferedDisplay<4>	*display;
+	chip8::FrameChannel				*display;
 	platform::VKMappedKeypad		*keypad;
-	chip8::Interpreter				*interpreter;
-	platform::QueueThread			*executionThread;
+	ClientKeyPad					*recordingKeypad;
+	chip8::InputLog					*input;
+	ClientInterpreter				*interpreter;
+	chip8::Rewind					*history;
+	chip8::Executor					*executionThread;
 
 	HWND hWndOwner;
 
 	chip8::clock cyclesPerFrame;
 	chip8::clock cycles;
 
-	LARGE_INTEGER ticksPerFrame;
-	LARGE_INTEGER ticks, ticksCurrent;
+	size_t snapshotsPerSecond;
+
+	chip8::FramePacer pacer;
+	chip8::FramePacer::Sleeper sleeper;
 
 	void threadFunc() {
+		// Commands posted wake the thread up, they are run before the wait goes on.
+		if (!pacer.wait(sleeper)) {
+			return;
+		}
 		bool isPlayingSound = interpreter->isPlayingSound();
 
-        if (display->isInvalid()) {
-            PostMessage(hWndOwner, WM_INTERPRETATION, INTERPRETATION_EVENT_DISPLAY, 0);
+		if (display->isInvalid()) {
+			display->publish();
+			display->validate();
 
-            (++*display).validate();
-        }
+			PostMessage(hWndOwner, WM_INTERPRETATION, INTERPRETATION_EVENT_DISPLAY, 0);
+		}
 
-		cycles = 0;
-		while (cycles < cyclesPerFrame) {
-			if (interpreter->isOk()) {
-				cycles += interpreter->doCycle();
-			}
-			else {
-				PostMessage(hWndOwner, WM_INTERPRETATION, INTERPRETATION_EVENT_ERROR, interpreter->getLastError());
-				pause();
+		auto status = interpreter->run(cyclesPerFrame);
+		cycles = status.cycles;
 
-				return;
-			}
-		}
+		if (!!(status.stoppedBy & ClientInterpreter::INTERPRETER_STOP_ERROR)) {
+			PostMessage(hWndOwner, WM_INTERPRETATION, INTERPRETATION_EVENT_ERROR, interpreter->getLastError());
+			pause();
 
-		interpreter->refreshTimers();
+			return;
+		}
+		history->onFrame(*interpreter);
 
 		if (interpreter->isPlayingSound() != isPlayingSound) {
 			PostMessage(hWndOwner, WM_INTERPRETATION, INTERPRETATION_EVENT_SPEAKER, !isPlayingSound);
 		}
+	}
 
-		do {
-			QueryPerformanceCounter(&ticks);
-		} while (ticks.QuadPart - ticksCurrent.QuadPart < ticksPerFrame.QuadPart);
-
-		QueryPerformanceCounter(&ticksCurrent);
+	// Commands are run by the execution thread between frames, they are stored
+	// inline within its queue. UI posts a few of them at a time, so the queue
+	// never gets full, unless the thread is stuck.
+	template <class TTask>
+	void post(TTask &&task) {
+		if (!executionThread->post(std::forward<TTask>(task))) {
+			LOGGER_PRINT_TEXTLN(_T("Execution queue is full, command is dropped"));
+		}
 	}
 
 	Interpretation(const Interpretation &);
@@ -89,19 +109,27 @@ public:
 
 		UNREFERENCED_PARAMETER(settings);
 
-		display = new platform::NBufferedDisplay<4>();
+		display = new chip8::FrameChannel();
 		keypad = new platform::VKMappedKeypad();
-		interpreter = new chip8::Interpreter(display, keypad);
-		executionThread = new platform::QueueThread(&Interpretation::threadFunc, this);
-
-		QueryPerformanceFrequency(&ticksPerFrame);
-		ticksPerFrame.QuadPart = (ticksPerFrame.QuadPart + 30) / 60;
-		ticksCurrent.QuadPart = 0;
+		input = new chip8::InputLog();
+		recordingKeypad = new ClientKeyPad(keypad, input);
+		interpreter = new ClientInterpreter(display, recordingKeypad);
+		interpreter->setQuirks(settings.machineQuirks);
+		recordingKeypad->bind(interpreter);
+		history = new chip8::Rewind(settings.rewindBudget, settings.rewindInterval);
+		snapshotsPerSecond = std::max<size_t>(60 / settings.rewindInterval, 1);
+		sleeper = [this](chip8::FramePacer::Clock::time_point deadline) {
+			return executionThread->waitUntil(deadline);
+		};
+		executionThread = new chip8::Executor([this]() { threadFunc(); });
 	}
 
 	~Interpretation() {
 		delete executionThread;
+		delete history;
 		delete interpreter;
+		delete recordingKeypad;
+		delete input;
 		delete keypad;
 		delete display;
 	}
@@ -116,8 +144,9 @@ public:
 		return display;
 	}
 
-	const byte *consumeDisplayData() {
-		return display->consume();
+	// UI thread is the consumer of frames published.
+	chip8::FrameChannel *getFrameChannel() {
+		return display;
 	}
 
 
@@ -131,51 +160,46 @@ public:
 
 
 	void load(LPCTSTR programFile) {
-		class LoadTask : public platform::ITask {
-
-			chip8::Interpreter *interpreter;
-
-			std::_tstring programFile;
-
-
-		public:
-			
-			LoadTask(chip8::Interpreter *interpreter, LPCTSTR programFile)
-				: interpreter(interpreter), programFile(programFile) {
-
-				/* Nothing to do */
-			}
-
-
-			void perform() {
-				interpreter->reset(std::ifstream(programFile, std::ios_base::binary));
-			}
-		};
-		executionThread->post(std::shared_ptr<platform::ITask>(new LoadTask(interpreter, programFile)));
+		post([this, file = std::_tstring(programFile)]() {
+			const word seed = word(GetTickCount());
+
+			interpreter->setSeed(seed);
+			interpreter->reset(std::ifstream(file, std::ios_base::binary));
+			history->clear();
+			input->clear(seed, interpreter->getQuirks());
+		});
 		executionThread->resume();
 	}
 
 	void reset() {
-		class ResetTask : public platform::ITask {
-
-			chip8::Interpreter *interpreter;
-
-
-		public:
-
-			ResetTask(chip8::Interpreter *interpreter)
-				: interpreter(interpreter) {
+		post([this]() {
+			const word seed = word(GetTickCount());
+
+			interpreter->setSeed(seed);
+			interpreter->reset();
+			history->clear();
+			input->clear(seed, interpreter->getQuirks());
+		});
+		executionThread->resume();
+	}
 
-				/* Nothing to do */
-			}
+	void rewind(unsigned seconds) {
+		post([this, steps = seconds * snapshotsPerSecond]() {
+			history->rewind(*interpreter, steps);
+		});
+	}
 
+	// Write keys held since the last load or reset, along with the seed and quirks,
+	// so that the run is played back by emu-chip8-cli --replay.
+	void saveInput(LPCTSTR inputFile) {
+		post([this, file = std::_tstring(inputFile)]() {
+			input->setCycles(interpreter->getCyclesCount());
 
-			void perform() {
-				interpreter->reset();
+			std::ofstream stream(file);
+			if (!input->write(stream)) {
+				LOGGER_PRINT_FORMATTED_TEXTLN(_T("Can't write input log: %s"), file.c_str());
 			}
-		};
-		executionThread->post(std::shared_ptr<platform::ITask>(new ResetTask(interpreter)));
-		executionThread->resume();
+		});
 	}
 
 
@@ -690,6 +714,7 @@ static VOID Chip8DisplayCommand(HWND hWnd, int id, HWND hWndCtl, UINT codeNotify
 			{
 				EnableMenuItem(hMenu, ID_FILE_RESET, MF_ENABLED);
 				EnableMenuItem(hMenu, ID_FILE_PAUSE, MF_ENABLED);
+				EnableMenuItem(hMenu, ID_FILE_SAVEINPUT, MF_ENABLED);
 			}
 			CheckMenuItem(hMenu, ID_FILE_PAUSE, MF_UNCHECKED);
 			break;
@@ -699,6 +724,24 @@ static VOID Chip8DisplayCommand(HWND hWnd, int id, HWND hWndCtl, UINT codeNotify
 
 			CheckMenuItem(GetMenu(hWnd), ID_FILE_PAUSE, MF_UNCHECKED);
 			break;
+		case ID_FILE_SAVEINPUT:
+		{
+			OPENFILENAME ofn = { 0 };
+			{
+				ofn.lStructSize = sizeof(OPENFILENAME);
+				ofn.Flags = OFN_PATHMUSTEXIST | OFN_OVERWRITEPROMPT;
+				ofn.hwndOwner = hWnd;
+
+				ofn.nMaxFile = 32767;
+				ofn.lpstrFile = new TCHAR[ofn.nMaxFile + 1];
+				ofn.lpstrFile[0] = _T('\0');
+			}
+			if (GetSaveFileName(&ofn)) {
+				interpretation->saveInput(ofn.lpstrFile);
+			}
+			delete[] ofn.lpstrFile;
+			break;
+		}
 		case ID_FILE_PAUSE:
 		{
 			auto hMenu = GetMenu(hWnd);
@@ -738,6 +781,11 @@ static VOID Chip8DisplayKeyUpDown(HWND hWnd, UINT vk, BOOL fDown, int cRepeat, U
 			PostMessage(hWnd, WM_COMMAND, MAKEWPARAM(ID_FILE_PAUSE, 0), (LPARAM)hWnd);
 		}
 	}
+	else if (vk == VK_BACK) {
+		if (!fDown) {
+			interpretation->rewind(1);
+		}
+	}
 	else {
 		interpretation->updateKeypadKey(vk, fDown);
 	}
@@ -747,10 +795,30 @@ static VOID Chip8DisplayInterpretation(HWND hWnd, UINT what, LPARAM lParam) {
 	switch (what) {
 	case INTERPRETATION_EVENT_DISPLAY:
 	{
-		const chip8::IDisplay *display = interpretation->getDisplay();
+		chip8::FrameChannel *frames = interpretation->getFrameChannel();
 
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, display->width(), display->height(),
-			GL_RED, GL_UNSIGNED_BYTE, interpretation->consumeDisplayData());
+		// Messages pile up, while the UI is busy, the latest frame is taken by the first one.
+		if (!frames->acquire()) {
+			break;
+		}
+		const byte *data = frames->getFrame();
+
+		// Upload runs of changed lines only.
+		uint64_t lines = frames->getChangedLines();
+		for (GLint y = 0; !!lines; ) {
+			if (!(lines & 0x01)) {
+				lines >>= 1;
+				++y;
+				continue;
+			}
+			GLint h = 0;
+			for (; !!(lines & 0x01); lines >>= 1) {
+				++h;
+			}
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, frames->width(), h,
+				GL_RED, GL_UNSIGNED_BYTE, data + y * frames->width());
+			y += h;
+		}
 
 		InvalidateRect(hWnd, NULL, FALSE);
 		break;
@@ -18,7 +18,6 @@
 #include <exception>
 #include <fstream>
 #include <memory>
-#include <queue>
 #include <sstream>
 #include <thread>
 #include <type_traits>
@@ -39,4 +38,3 @@
 
 #include "unicode.h"
 #include "string.h"
-#include "decay_copy.h"
@@ -1,8 +1,26 @@
 #include "stdafx.h"
 
-#include "chip8\Chip8Interpreter.h"
-
+#include "chip8/Chip8Interpreter.h"
+#include "chip8/Chip8InterpreterImpl.h"
+#include "chip8/Chip8Batch.h"
+#include "chip8/Chip8Executor.h"
+#include "chip8/Chip8FrameChannel.h"
+#include "chip8/Chip8FramePacer.h"
+#include "chip8/Chip8Input.h"
+#include "chip8/Chip8Lockstep.h"
+#include "chip8/Chip8Profiler.h"
+#include "chip8/Chip8Rewind.h"
+#include "chip8/Chip8Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace chip8;
 
@@ -13,22 +31,30 @@ protected:
 	class MockPad : public IKeyPad {
 
 		PadKeys state;
+		mutable size_t polls;
 
 	public:
+		MockPad() : state(PadKeys::KEY_NONE), polls(0) {}
+
 		void setState(PadKeys state) {
 			this->state = state;
 		}
 
 		virtual PadKeys getState() const {
+			++polls;
 			return state;
 		}
+
+		size_t getPolls() const {
+			return polls;
+		}
 	};
 
 	typedef byte(Frame)[DefaultDisplay::FRAME_WIDTH * DefaultDisplay::FRAME_HEIGHT];
 
-	std::auto_ptr<DefaultDisplay>	display;
-	std::auto_ptr<MockPad>			keypad;
-	std::auto_ptr<Interpreter>		interpreter;
+	std::unique_ptr<DefaultDisplay>	display;
+	std::unique_ptr<MockPad>			keypad;
+	std::unique_ptr<Interpreter>		interpreter;
 
 	Interpreter::Snapshot snapshot;
 	word aluProfileActive;
@@ -72,7 +98,8 @@ public:
 TEST_F(OriginalInterpreterTest, Initialization) {
 	// Valid
 	{
-		interpreter->reset(std::ifstream("15PUZZLE"));
+		std::ifstream program("15PUZZLE", std::ios_base::binary);
+		interpreter->reset(program);
 
 		EXPECT_TRUE(*interpreter);
 		EXPECT_EQ(0, interpreter->getCyclesCount());
@@ -990,6 +1017,1664 @@ TEST_F(OriginalInterpreterTest, OpcodeFXNN_6XNN_ANNN) {
 	}
 }
 
+TEST_F(OriginalInterpreterTest, DoCycles) {
+	const byte program[] = { 
+		0x62,0x07, 
+		
+		// Loop: draw digit (V0 & 7) at (V0; V0) until V0 is 0x40
+		0x70,0x01, 0x81,0x00, 0x81,0x22, 0xF1,0x29, 0xD0,0x05, 0x30,0x40, 0x12,0x02,
+
+		0x12,0x10 
+	};
+	DefaultDisplay referenceDisplay;
+	Interpreter reference(&referenceDisplay, keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL);
+	
+	Interpreter::Snapshot referenceSnapshot;
+	Interpreter::Snapshot::obtain(referenceSnapshot, reference);
+
+	interpreter->reset(program);
+	reference.reset(program);
+
+	for (chip8::clock cyclesMin : { 1, 1000, 10000, 100000, 1000000 }) {
+		chip8::clock cycles = 0;
+		while (cycles < cyclesMin && reference.isOk()) {
+			cycles += reference.doCycle();
+		}
+		EXPECT_EQ(cycles, interpreter->doCycles(cyclesMin));
+		EXPECT_EQ(reference.getCyclesCount(), interpreter->getCyclesCount());
+		EXPECT_EQ(referenceSnapshot.getProgramCounterValue(), snapshot.getProgramCounterValue());
+		EXPECT_EQ(referenceSnapshot.getIndexValue(), snapshot.getIndexValue());
+		EXPECT_EQ(referenceSnapshot.getRegisterValue(0), snapshot.getRegisterValue(0));
+		EXPECT_EQ(referenceSnapshot.getRegisterValue(1), snapshot.getRegisterValue(1));
+		EXPECT_EQ(referenceSnapshot.getCarryValue(), snapshot.getCarryValue());
+		EXPECT_EQ(0, memcmp(*display, referenceDisplay, sizeof(Frame)));
+	}
+	EXPECT_EQ(Interpreter::OFFSET_PROGRAM_START + 16, snapshot.getProgramCounterValue());
+	EXPECT_TRUE(interpreter->isOk());
+}
+
+TEST_F(OriginalInterpreterTest, SeedInstructionsCount) {
+	// Loop: V0, V1, V2 = RND, count passes in V3
+	const byte program[] = { 0xC0,0xFF, 0xC1,0xFF, 0xC2,0x0F, 0x73,0x01, 0x12,0x00 };
+
+	DefaultDisplay referenceDisplay;
+	Interpreter reference(&referenceDisplay, keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL);
+
+	Interpreter::Snapshot referenceSnapshot;
+	Interpreter::Snapshot::obtain(referenceSnapshot, reference);
+
+	interpreter->setSeed(0x1234);
+	reference.setSeed(0x1234);
+
+	// Seed is kept over reset, so the second pass goes the same way.
+	for (size_t pass = 0; pass < 2; ++pass) {
+		interpreter->reset(program);
+		reference.reset(program);
+		EXPECT_EQ(0, interpreter->getInstructionsCount());
+
+		chip8::clock instructions = 0;
+		while (reference.getCyclesCount() < 100000) {
+			reference.doCycle();
+			++instructions;
+		}
+		interpreter->run(100000);
+
+		EXPECT_EQ(reference.getCyclesCount(), interpreter->getCyclesCount());
+		EXPECT_EQ(instructions, reference.getInstructionsCount());
+		EXPECT_EQ(instructions, interpreter->getInstructionsCount());
+		EXPECT_EQ((instructions + 1) / 5 & 0xFF, snapshot.getRegisterValue(3));
+
+		for (size_t i = 0; i < 3; ++i) {
+			EXPECT_EQ(referenceSnapshot.getRegisterValue(i), snapshot.getRegisterValue(i));
+		}
+	}
+}
+
+TEST_F(OriginalInterpreterTest, Counters) {
+	const byte program[] = {
+		0x60,0x05, 0xA0,0x00,
+
+		// Draw digit 0 twice (collision), set timers, await a key, then loop forever
+		0xD0,0x05, 0xD0,0x05, 0xF0,0x15, 0xF0,0x18, 0xF1,0x0A, 0x12,0x0E
+	};
+	auto slotOf = [](const char *name) {
+		size_t slot = 1;
+		while (strcmp(Interpreter::instructionName(slot), name) != 0) {
+			++slot;
+		}
+		return slot;
+	};
+
+	keypad->setState(KEY_NONE);
+	interpreter->reset(program);
+	interpreter->resetCounters();
+
+	interpreter->doCycles(100000);
+	keypad->setState(KEY_1);
+	interpreter->doCycle();
+	keypad->setState(KEY_NONE);
+	interpreter->doCycles(100000);
+
+	const Interpreter::Counters counters = interpreter->getCounters();
+
+	chip8::clock executions = 0, cycles = 0;
+	for (size_t slot = 1; slot < Interpreter::COUNTERS_SLOTS; ++slot) {
+		executions += counters.executions[slot];
+		cycles += counters.cycles[slot];
+	}
+
+#if CHIP8_COUNTERS
+	EXPECT_EQ(1, counters.executions[slotOf("6XNN")]);
+	EXPECT_EQ(1, counters.executions[slotOf("ANNN")]);
+	EXPECT_EQ(2, counters.executions[slotOf("DXYN")]);
+	EXPECT_EQ(1, counters.executions[slotOf("FX15")]);
+	EXPECT_EQ(1, counters.executions[slotOf("FX18")]);
+	EXPECT_EQ(1, counters.executions[slotOf("FX0A")]);
+	EXPECT_LT(1, counters.executions[slotOf("1NNN")]);
+
+	EXPECT_EQ(10, counters.spriteRows);
+	EXPECT_EQ(1, counters.collisions);
+	EXPECT_EQ(2, counters.timerWrites);
+	EXPECT_LT(0, counters.keyWaitCycles);
+
+	EXPECT_EQ(interpreter->getInstructionsCount(), executions);
+	EXPECT_EQ(interpreter->getCyclesCount(), cycles + counters.keyWaitCycles);
+
+	std::ostringstream json;
+	Interpreter::writeCountersJSON(json, counters);
+	EXPECT_NE(std::string::npos, json.str().find("\"DXYN\": { \"executions\": 2"));
+#else
+	EXPECT_EQ(0, executions);
+	EXPECT_EQ(0, cycles);
+	EXPECT_EQ(0, counters.spriteRows);
+	EXPECT_EQ(0, counters.keyWaitCycles);
+#endif // CHIP8_COUNTERS
+
+	interpreter->resetCounters();
+	EXPECT_EQ(0, interpreter->getCounters().executions[slotOf("1NNN")]);
+
+#if CHIP8_COUNTERS
+	// Store over its own opcode still counts as a store
+	const byte store[] = { 0xA2,0x02, 0xF0,0x55, 0x12,0x04 };
+
+	interpreter->reset(store);
+	interpreter->resetCounters();
+	interpreter->doCycle();
+	interpreter->doCycle();
+	EXPECT_EQ(1, interpreter->getCounters().executions[slotOf("FX55")]);
+#endif // CHIP8_COUNTERS
+}
+
+TEST_F(OriginalInterpreterTest, Profiler) {
+	// Main calls 0x206, which calls 0x20C, spinning there on delay timer.
+	const byte program[] = {
+		0x22,0x06, 0x12,0x04, 0x12,0x04,
+		0x22,0x0C, 0x00,0xEE, 0x00,0x00,
+		0x60,0x3C, 0xF0,0x15, 0xF1,0x07, 0x31,0x00, 0x12,0x10, 0x12,0x0C
+	};
+
+	DefaultDisplay referenceDisplay;
+	Interpreter reference(&referenceDisplay, keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL);
+
+	Profiler profiler(100);
+
+	interpreter->setProfiler(&profiler);
+	interpreter->reset(program);
+	reference.reset(program);
+
+	interpreter->run(100000);
+	reference.run(100000);
+
+	// Sampling leaves both the machine and its state alone.
+	EXPECT_EQ(reference.getCyclesCount(), interpreter->getCyclesCount());
+	EXPECT_EQ(reference.getInstructionsCount(), interpreter->getInstructionsCount());
+	EXPECT_EQ(reference.getStateSize(), interpreter->getStateSize());
+
+	EXPECT_EQ(interpreter->getCyclesCount() / 100, profiler.getSamplesCount());
+
+	const std::vector<Profiler::Hotspot> routines = profiler.getHotRoutines();
+	ASSERT_EQ(3, routines.size());
+	EXPECT_EQ(0x20C, routines[0].address);
+	EXPECT_EQ(profiler.getSamplesCount(), routines[0].samples);
+	EXPECT_EQ(profiler.getSamplesCount(), routines[1].samplesTotal);
+	EXPECT_EQ(profiler.getSamplesCount(), routines[2].samplesTotal);
+
+	const std::vector<Profiler::Hotspot> addresses = profiler.getHotAddresses();
+	ASSERT_FALSE(addresses.empty());
+	for (const Profiler::Hotspot &address : addresses) {
+		EXPECT_LE(0x20C, address.address);
+		EXPECT_GE(0x216, address.address);
+	}
+
+	std::ostringstream folded;
+	profiler.writeFolded(folded);
+	EXPECT_EQ("0200;0206;020C " + std::to_string(profiler.getSamplesCount()) + "\n", folded.str());
+
+	// Return addresses, which don't follow a call, are of unknown routines.
+	byte memory[0x300] = {};
+	memory[0x206] = 0x22;
+	memory[0x207] = 0x0C;
+
+	const word stack[] = { 0x208, 0x202 };
+
+	interpreter->setProfiler(nullptr);
+	profiler.clear();
+	profiler.sample(0x20E, stack, 2, memory, sizeof(memory));
+	EXPECT_EQ(1, profiler.getSamplesCount());
+
+	folded.str("");
+	profiler.writeFolded(folded);
+	EXPECT_EQ("0200;????;020C 1\n", folded.str());
+}
+
+TEST_F(OriginalInterpreterTest, Trace) {
+	const char *const fileName = "Trace.tmp";
+
+	// Records go through the file as they are.
+	const TraceRecorder::Record records[] = {
+		{ 18, 0x200, 0x6A05, 0x05, 0xA, TraceRecorder::CARRY_NONE },
+		{ 58, 0x202, 0x8AA4, 0x0A, 0xA, 0x00 },
+		{ 70000, 0x204, 0xA123, 0x123, TraceRecorder::TARGET_INDEX, TraceRecorder::CARRY_NONE },
+		{ 70018, 0x1F0, 0x1200, 0, TraceRecorder::TARGET_NONE, TraceRecorder::CARRY_NONE },
+		{ 70030, 0x200, 0x6A05, 0x05, 0xA, TraceRecorder::CARRY_NONE }
+	};
+	const char *const text =
+		"18 0200 6A05 VA=05\n"
+		"58 0202 8AA4 VA=0A VF=00\n"
+		"70000 0204 A123 I=123\n"
+		"70018 01F0 1200\n"
+		"70030 0200 6A05 VA=05\n";
+
+	TraceRecorder tracer(4);
+	ASSERT_TRUE(tracer.open(fileName));
+	for (const TraceRecorder::Record &record : records) {
+		tracer.record(record);
+	}
+	EXPECT_TRUE(tracer.close());
+	EXPECT_EQ(sizeof(records) / sizeof(records[0]), tracer.getRecordsCount());
+
+	std::ostringstream decoded;
+	{
+		std::ifstream stream(fileName, std::ios_base::binary);
+		EXPECT_TRUE(TraceRecorder::decode(stream, decoded));
+	}
+	EXPECT_EQ(text, decoded.str());
+
+	// Loop: V0 += 1, V1 = V0 + V0 with carry, I = 0x300
+	const byte program[] = { 0x70,0x01, 0x81,0x00, 0x81,0x04, 0xA3,0x00, 0x12,0x00 };
+
+	interpreter->reset(program);
+
+	ASSERT_TRUE(tracer.open(fileName));
+
+	if (!interpreter->setTracer(&tracer)) {
+		EXPECT_FALSE(CHIP8_TRACE);
+		tracer.close();
+		std::remove(fileName);
+		return;
+	}
+	interpreter->run(10000);
+	interpreter->setTracer(nullptr);
+	EXPECT_TRUE(tracer.close());
+	EXPECT_EQ(interpreter->getInstructionsCount(), tracer.getRecordsCount());
+
+	decoded.str("");
+	{
+		std::ifstream stream(fileName, std::ios_base::binary);
+		EXPECT_TRUE(TraceRecorder::decode(stream, decoded));
+	}
+	std::istringstream lines(decoded.str());
+	std::string line;
+
+	ASSERT_TRUE(!!std::getline(lines, line));
+	EXPECT_NE(std::string::npos, line.find(" 0200 7001 V0=01"));
+	ASSERT_TRUE(!!std::getline(lines, line));
+	EXPECT_NE(std::string::npos, line.find(" 0202 8100 V1=01"));
+	ASSERT_TRUE(!!std::getline(lines, line));
+	EXPECT_NE(std::string::npos, line.find(" 0204 8104 V1=02 VF=00"));
+	ASSERT_TRUE(!!std::getline(lines, line));
+	EXPECT_NE(std::string::npos, line.find(" 0206 A300 I=300"));
+	ASSERT_TRUE(!!std::getline(lines, line));
+	EXPECT_NE(std::string::npos, line.find(" 0208 1200"));
+
+	size_t count = 5;
+	for (std::string next; std::getline(lines, next); line = next) {
+		++count;
+	}
+	EXPECT_EQ(interpreter->getInstructionsCount(), count);
+	EXPECT_EQ(std::to_string(interpreter->getCyclesCount()), line.substr(0, line.find(' ')));
+
+	std::remove(fileName);
+}
+
+TEST_F(OriginalInterpreterTest, Run) {
+	const byte program[] = { 0x60,0x20, 0xF0,0x18, 0x00,0xE0, 0xF1,0x0A, 0x71,0x01, 0x00,0x00 };
+	const unsigned stopConditions = Interpreter::INTERPRETER_STOP_DISPLAY 
+		| Interpreter::INTERPRETER_STOP_SOUND | Interpreter::INTERPRETER_STOP_KEY_AWAIT;
+
+	interpreter->reset(program);
+	keypad->setState(PadKeys::KEY_NONE);
+
+	Interpreter::RunStatus status = interpreter->run(100000, stopConditions);
+	EXPECT_EQ(Interpreter::INTERPRETER_STOP_SOUND, status.stoppedBy);
+	EXPECT_EQ(152, status.cycles);
+	EXPECT_EQ(Interpreter::OFFSET_PROGRAM_START + 4, snapshot.getProgramCounterValue());
+
+	status = interpreter->run(100000, stopConditions);
+	EXPECT_EQ(Interpreter::INTERPRETER_STOP_DISPLAY, status.stoppedBy);
+	EXPECT_EQ(64, status.cycles);
+
+	status = interpreter->run(100000, stopConditions);
+	EXPECT_EQ(Interpreter::INTERPRETER_STOP_KEY_AWAIT, status.stoppedBy);
+	EXPECT_EQ(17833, status.cycles);
+	EXPECT_TRUE(interpreter->isKeyAwaited());
+
+	// Key await passes take 9 cycles each
+	status = interpreter->run(100, stopConditions);
+	EXPECT_EQ(Interpreter::INTERPRETER_STOP_BUDGET, status.stoppedBy);
+	EXPECT_EQ(108, status.cycles);
+
+	keypad->setState(PadKeys::KEY_3);
+	status = interpreter->run(100, stopConditions);
+	EXPECT_EQ(Interpreter::INTERPRETER_STOP_BUDGET, status.stoppedBy);
+	EXPECT_TRUE(interpreter->isKeyAwaited());
+
+	// Key release stops the sound, which is left from FX18 above
+	keypad->setState(PadKeys::KEY_NONE);
+	status = interpreter->run(100000, stopConditions);
+	EXPECT_EQ(Interpreter::INTERPRETER_STOP_SOUND, status.stoppedBy);
+	EXPECT_EQ(87, status.cycles);
+	EXPECT_EQ(0x04, snapshot.getRegisterValue(1));
+
+	status = interpreter->run(100000, stopConditions);
+	EXPECT_EQ(Interpreter::INTERPRETER_STOP_ERROR, status.stoppedBy);
+	EXPECT_EQ(40, status.cycles);
+	EXPECT_EQ(Interpreter::INTERPRETER_ERROR_UNEXPECTED, interpreter->getLastError());
+
+	status = interpreter->run(100000, stopConditions);
+	EXPECT_EQ(Interpreter::INTERPRETER_STOP_ERROR, status.stoppedBy);
+	EXPECT_EQ(0, status.cycles);
+}
+
+TEST_F(OriginalInterpreterTest, TimerEvents) {
+	// Delay timer ticks off machine cycles, no host calls needed
+	{
+		const byte program[] = { 0x60,0x03, 0xF0,0x15, 0xF1,0x07, 0x31,0x00, 0x12,0x04, 0x00,0x00 };
+
+		interpreter->reset(program);
+
+		interpreter->doCycle();
+		interpreter->doCycle();
+		EXPECT_EQ(0x03, snapshot.getTimerDelay());
+
+		while (interpreter->isOk() && interpreter->getCyclesCount() < 100000) {
+			interpreter->doCycle();
+		}
+		EXPECT_EQ(Interpreter::INTERPRETER_ERROR_UNEXPECTED, interpreter->getLastError());
+		EXPECT_EQ(0x00, snapshot.getTimerDelay());
+		EXPECT_LE(chip8::clock(3 * 1467), interpreter->getCyclesCount());
+		EXPECT_GT(chip8::clock(3 * 1467 + 500), interpreter->getCyclesCount());
+	}
+	// Scheduled keys are held on top of the key pad ones
+	{
+		const byte program[] = { 0x62,0x05, 0xE2,0x9E, 0x12,0x02, 0x00,0x00 };
+
+		interpreter->reset(program);
+		keypad->setState(PadKeys::KEY_NONE);
+
+		EXPECT_TRUE(interpreter->scheduleKeys(1000, PadKeys::KEY_5));
+
+		while (interpreter->isOk() && interpreter->getCyclesCount() < 100000) {
+			interpreter->doCycle();
+		}
+		EXPECT_EQ(Interpreter::INTERPRETER_ERROR_UNEXPECTED, interpreter->getLastError());
+		EXPECT_LE(chip8::clock(1000), interpreter->getCyclesCount());
+		EXPECT_GT(chip8::clock(1000 + 500), interpreter->getCyclesCount());
+	}
+	// Keys due already are held from the next instruction on
+	{
+		const byte program[] = { 0x62,0x05, 0xE2,0x9E, 0x00,0x00, 0x00,0xE0 };
+
+		interpreter->reset(program);
+		keypad->setState(PadKeys::KEY_NONE);
+
+		interpreter->doCycle();
+		EXPECT_TRUE(interpreter->scheduleKeys(0, PadKeys::KEY_5));
+
+		interpreter->doCycle();
+		EXPECT_EQ(Interpreter::OFFSET_PROGRAM_START + 6, snapshot.getProgramCounterValue());
+	}
+	// Scheduled keys can not take the slots timers need
+	{
+		const byte program[] = { 0x60,0x03, 0xF0,0x15, 0xF0,0x18, 0x12,0x06 };
+
+		interpreter->reset(program);
+
+		size_t scheduled = 0;
+		while (scheduled < Scheduler::CAPACITY && interpreter->scheduleKeys(100000 + scheduled, PadKeys::KEY_5)) {
+			scheduled++;
+		}
+		EXPECT_GT(Scheduler::CAPACITY - Interpreter::EVENTS_RESERVED, scheduled);
+
+		interpreter->doCycle();
+		interpreter->doCycle();
+		interpreter->doCycle();
+		EXPECT_TRUE(interpreter->isOk());
+		EXPECT_EQ(0x03, snapshot.getTimerDelay());
+		EXPECT_EQ(0x03, snapshot.getTimerSound());
+	}
+}
+
+TEST_F(OriginalInterpreterTest, Recompiler) {
+	const byte program[] = {
+		0x60,0x07, 0x61,0x05,
+
+		// Loop: ALU mix, then rewrite the NN of 7XNN above with V0
+		0x70,0x13, 0x80,0x14, 0x82,0x15, 0x83,0x07, 0x84,0x16, 0x85,0x1E, 0x86,0x13,
+		0xF6,0x29, 0xF0,0x1E, 0xF7,0x07, 0xA2,0x05, 0xF0,0x55, 0x41,0x00, 0x12,0x00,
+
+		// Jump through V0 = 0, then restore V0 and go on
+		0x8A,0x00, 0x60,0x00, 0xB2,0x28, 0x12,0x00, 0x80,0xA0, 0xF0,0x15, 0x12,0x04
+	};
+	if (!interpreter->enableRecompiler(true)) {
+		EXPECT_EQ(0, CHIP8_RECOMPILER);
+		return;
+	}
+	DefaultDisplay referenceDisplay;
+	Interpreter reference(&referenceDisplay, keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL);
+
+	Interpreter::Snapshot referenceSnapshot;
+	Interpreter::Snapshot::obtain(referenceSnapshot, reference);
+
+	interpreter->reset(program);
+	reference.reset(program);
+
+	for (chip8::clock i = 0; i < 500; ++i) {
+		chip8::clock cyclesMin = 1 + (i * 37) % 1500;
+		chip8::clock cycles = 0;
+		while (cycles < cyclesMin && reference.isOk()) {
+			cycles += reference.doCycle();
+		}
+		ASSERT_EQ(cycles, interpreter->doCycles(cyclesMin));
+		ASSERT_EQ(reference.getCyclesCount(), interpreter->getCyclesCount());
+		ASSERT_EQ(referenceSnapshot.getProgramCounterValue(), snapshot.getProgramCounterValue());
+		ASSERT_EQ(referenceSnapshot.getIndexValue(), snapshot.getIndexValue());
+		for (size_t idx = 0; idx < Interpreter::REGISTERS_COUNT; ++idx) {
+			ASSERT_EQ(referenceSnapshot.getRegisterValue(idx), snapshot.getRegisterValue(idx));
+		}
+		ASSERT_EQ(referenceSnapshot.getMemoryValue(Interpreter::OFFSET_PROGRAM_START + 5), 
+			snapshot.getMemoryValue(Interpreter::OFFSET_PROGRAM_START + 5));
+	}
+	EXPECT_TRUE(interpreter->isOk());
+}
+
+TEST_F(OriginalInterpreterTest, Quirks) {
+	// Quirk 8XY6 shifts VX
+	{
+		const byte program[] = { 0x63,0x01, 0x6D,0x05, 0x8D,0x36 };
+
+		interpreter->setQuirks(Interpreter::QUIRK_SHIFT_VX);
+		interpreter->reset(program);
+
+		for (size_t i = 0; i < 3; ++i) {
+			interpreter->doCycle();
+		}
+		EXPECT_EQ(0x02, snapshot.getRegisterValue(13));
+		EXPECT_EQ(0x01, snapshot.getRegisterValue(3));
+		EXPECT_EQ(0x01, snapshot.getCarryValue());
+	}
+	// Quirk FX55 keeps I
+	{
+		const byte program[] = { 0xA3,0x00, 0x60,0x01, 0x61,0x02, 0xF1,0x55 };
+
+		interpreter->setQuirks(Interpreter::QUIRK_LOAD_STORE_KEEP_I);
+		interpreter->reset(program);
+
+		for (size_t i = 0; i < 4; ++i) {
+			interpreter->doCycle();
+		}
+		EXPECT_EQ(0x300, snapshot.getIndexValue());
+		EXPECT_EQ(0x01, snapshot.getMemoryValue(0x300));
+		EXPECT_EQ(0x02, snapshot.getMemoryValue(0x301));
+	}
+	// Quirk BXNN jumps to XNN + VX
+	{
+		const byte program[] = { 0x60,0x10, 0x62,0x04, 0xB2,0x04 };
+
+		interpreter->setQuirks(Interpreter::QUIRK_JUMP_VX);
+		interpreter->reset(program);
+
+		for (size_t i = 0; i < 3; ++i) {
+			interpreter->doCycle();
+		}
+		EXPECT_EQ(0x208, snapshot.getProgramCounterValue());
+	}
+	// Quirk DXYN wraps around
+	{
+		const byte program[] = { 0xA2,0x08, 0x60,0x3E, 0x61,0x1F, 0xD0,0x12, 0xC0,0xFF };
+		const size_t width = DefaultDisplay::FRAME_WIDTH;
+
+		interpreter->setQuirks(Interpreter::QUIRK_SPRITE_WRAP);
+		interpreter->reset(program);
+
+		for (size_t i = 0; i < 4; ++i) {
+			interpreter->doCycle();
+		}
+		const byte *frame = *display;
+		EXPECT_EQ(0xFF, frame[31 * width + 62]);
+		EXPECT_EQ(0xFF, frame[31 * width + 63]);
+		EXPECT_EQ(0x00, frame[31 * width + 0]);
+		EXPECT_EQ(0xFF, frame[62]);
+		EXPECT_EQ(0xFF, frame[63]);
+		EXPECT_EQ(0xFF, frame[5]);
+		EXPECT_EQ(0x00, frame[6]);
+		EXPECT_EQ(0x00, snapshot.getCarryValue());
+	}
+	// Quirk 8XY1 resets VF
+	{
+		const byte program[] = { 0x6F,0x05, 0x60,0x01, 0x61,0x02, 0x80,0x11 };
+
+		interpreter->setQuirks(Interpreter::QUIRK_LOGIC_VF_RESET);
+		interpreter->reset(program);
+
+		for (size_t i = 0; i < 4; ++i) {
+			interpreter->doCycle();
+		}
+		EXPECT_EQ(0x03, snapshot.getRegisterValue(0));
+		EXPECT_EQ(0x00, snapshot.getCarryValue());
+	}
+	// Quirks are applied on reset only
+	{
+		const byte program[] = { 0x6F,0x05, 0x60,0x01, 0x61,0x02, 0x80,0x11 };
+
+		interpreter->reset(program);
+		interpreter->setQuirks(Interpreter::QUIRK_NONE);
+
+		for (size_t i = 0; i < 4; ++i) {
+			interpreter->doCycle();
+		}
+		EXPECT_EQ(0x00, snapshot.getCarryValue());
+		EXPECT_EQ(Interpreter::QUIRK_NONE, interpreter->getQuirks());
+
+		interpreter->reset(program);
+
+		for (size_t i = 0; i < 4; ++i) {
+			interpreter->doCycle();
+		}
+		EXPECT_EQ(0x05, snapshot.getCarryValue());
+	}
+	EXPECT_TRUE(interpreter->isOk());
+}
+
+TEST_F(OriginalInterpreterTest, RecompilerQuirks) {
+	const byte program[] = {
+		0x60,0x07, 0x61,0x05, 0x62,0x02,
+
+		// Loop: logic and shifts, then jump through V2
+		0x70,0x13, 0x83,0x04, 0x85,0x12, 0x3F,0x00, 0x71,0x01, 0x86,0x03, 0x86,0x0E, 0x86,0x06,
+		0xB2,0x18, 0x00,0x00, 0x12,0x06
+	};
+	if (!interpreter->enableRecompiler(true)) {
+		EXPECT_EQ(0, CHIP8_RECOMPILER);
+		return;
+	}
+	const unsigned quirks = Interpreter::QUIRK_SHIFT_VX 
+		| Interpreter::QUIRK_JUMP_VX | Interpreter::QUIRK_LOGIC_VF_RESET;
+
+	DefaultDisplay referenceDisplay;
+	Interpreter reference(&referenceDisplay, keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL);
+
+	Interpreter::Snapshot referenceSnapshot;
+	Interpreter::Snapshot::obtain(referenceSnapshot, reference);
+
+	interpreter->setQuirks(quirks);
+	interpreter->reset(program);
+	reference.setQuirks(quirks);
+	reference.reset(program);
+
+	for (chip8::clock i = 0; i < 500; ++i) {
+		chip8::clock cyclesMin = 1 + (i * 37) % 1500;
+		chip8::clock cycles = 0;
+		while (cycles < cyclesMin && reference.isOk()) {
+			cycles += reference.doCycle();
+		}
+		ASSERT_EQ(cycles, interpreter->doCycles(cyclesMin));
+		ASSERT_EQ(reference.getCyclesCount(), interpreter->getCyclesCount());
+		ASSERT_EQ(referenceSnapshot.getProgramCounterValue(), snapshot.getProgramCounterValue());
+		for (size_t idx = 0; idx < Interpreter::REGISTERS_COUNT; ++idx) {
+			ASSERT_EQ(referenceSnapshot.getRegisterValue(idx), snapshot.getRegisterValue(idx));
+		}
+	}
+	EXPECT_TRUE(interpreter->isOk());
+}
+
+TEST_F(OriginalInterpreterTest, DeviceSpecialization) {
+	const byte program[] = { 
+		0x62,0x07, 
+		
+		// Loop: draw digit (V0 & 7) at (V0; V0) until V0 is 0x40
+		0x70,0x01, 0x81,0x00, 0x81,0x22, 0xF1,0x29, 0xD0,0x05, 0x30,0x40, 0x12,0x02,
+
+		0x12,0x10 
+	};
+	typedef BasicInterpreter<DefaultDisplay, MockPad> SpecializedInterpreter;
+
+	DefaultDisplay specializedDisplay;
+	SpecializedInterpreter specialized(&specializedDisplay, keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL);
+
+	SpecializedInterpreter::Snapshot specializedSnapshot;
+	SpecializedInterpreter::Snapshot::obtain(specializedSnapshot, specialized);
+
+	interpreter->reset(program);
+	specialized.reset(program);
+
+	for (chip8::clock cyclesMin : { 1, 1000, 10000, 100000, 1000000 }) {
+		EXPECT_EQ(interpreter->doCycles(cyclesMin), specialized.doCycles(cyclesMin));
+		EXPECT_EQ(interpreter->getCyclesCount(), specialized.getCyclesCount());
+		EXPECT_EQ(snapshot.getProgramCounterValue(), specializedSnapshot.getProgramCounterValue());
+		EXPECT_EQ(snapshot.getIndexValue(), specializedSnapshot.getIndexValue());
+		EXPECT_EQ(snapshot.getRegisterValue(0), specializedSnapshot.getRegisterValue(0));
+		EXPECT_EQ(snapshot.getRegisterValue(1), specializedSnapshot.getRegisterValue(1));
+		EXPECT_EQ(snapshot.getCarryValue(), specializedSnapshot.getCarryValue());
+		EXPECT_EQ(0, memcmp(*display, specializedDisplay, sizeof(Frame)));
+	}
+	EXPECT_TRUE(specialized.isOk());
+}
+
+TEST_F(OriginalInterpreterTest, InvalidAreaAccumulated) {
+	// Draw digit 0 at (2; 3), then digit 1 at (40; 20)
+	const byte program[] = { 0x60,0x02, 0x61,0x03, 0xD0,0x15, 0x60,0x28, 0x61,0x14, 0xD0,0x15 };
+
+	rect invalidRect;
+
+	interpreter->reset(program);
+	display->validate();
+
+	EXPECT_FALSE(*display);
+	EXPECT_EQ(0ULL, display->getInvalidLines());
+
+	for (size_t i = 0; i < 6; ++i) {
+		interpreter->doCycle();
+	}
+	EXPECT_TRUE(*display);
+
+	display->getInvalidArea(invalidRect);
+	EXPECT_EQ( 2, invalidRect.x);
+	EXPECT_EQ( 3, invalidRect.y);
+	EXPECT_EQ(46, invalidRect.w);
+	EXPECT_EQ(22, invalidRect.h);
+	EXPECT_EQ((0x1FULL << 3) | (0x1FULL << 20), display->getInvalidLines());
+
+	display->validate();
+	EXPECT_FALSE(*display);
+	EXPECT_EQ(0ULL, display->getInvalidLines());
+
+	display->getInvalidArea(invalidRect);
+	EXPECT_EQ(0, invalidRect.w);
+	EXPECT_EQ(0, invalidRect.h);
+
+	display->invalidate();
+	EXPECT_EQ(~0ULL >> 32, display->getInvalidLines());
+}
+
+TEST_F(OriginalInterpreterTest, PackedDisplay) {
+	const byte program[] = {
+		0x62,0x07,
+
+		// Loop: draw digit (V0 & 7) at (V0; V0) until V0 wraps to 0
+		0x70,0x05, 0x81,0x00, 0x81,0x22, 0xF1,0x29, 0xD0,0x05, 0x30,0x00, 0x12,0x02,
+
+		0x12,0x10
+	};
+	typedef BasicInterpreter<DefaultDisplay, MockPad> ReferenceInterpreter;
+	typedef BasicInterpreter<PackedDisplay, MockPad> PackedInterpreter;
+
+	const byte sizes[][2] = { { 64, 32 }, { 128, 64 } };
+
+	for (unsigned quirks : { Interpreter::QUIRK_NONE, Interpreter::QUIRK_SPRITE_WRAP }) {
+		for (auto &size : sizes) {
+			DefaultDisplay referenceDisplay(size[0], size[1]);
+			PackedDisplay packedDisplay(size[0], size[1]);
+
+			ReferenceInterpreter reference(&referenceDisplay, keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL);
+			PackedInterpreter packed(&packedDisplay, keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL);
+
+			ReferenceInterpreter::Snapshot referenceSnapshot;
+			ReferenceInterpreter::Snapshot::obtain(referenceSnapshot, reference);
+			PackedInterpreter::Snapshot packedSnapshot;
+			PackedInterpreter::Snapshot::obtain(packedSnapshot, packed);
+
+			reference.setQuirks(quirks);
+			packed.setQuirks(quirks);
+
+			reference.reset(program);
+			packed.reset(program);
+
+			while (referenceSnapshot.getProgramCounterValue() != Interpreter::OFFSET_PROGRAM_START + 0x10) {
+				reference.doCycle();
+				packed.doCycle();
+				ASSERT_EQ(referenceSnapshot.getCarryValue(), packedSnapshot.getCarryValue());
+			}
+			std::vector<byte> referenceFrame(referenceDisplay.area());
+			std::vector<byte> packedFrame(packedDisplay.area());
+
+			referenceDisplay.unpack(referenceFrame.data());
+			packedDisplay.unpack(packedFrame.data());
+			EXPECT_TRUE(referenceFrame == packedFrame);
+		}
+	}
+	// Sprite line crossing words and wrapping around
+	{
+		PackedDisplay packedDisplay(128, 64);
+
+		packedDisplay.clear();
+		EXPECT_FALSE(packedDisplay.xorLine(1, 60, 0xFF));
+		EXPECT_EQ(0x000000000000000FULL, packedDisplay.getPackedLine(1)[0]);
+		EXPECT_EQ(0xF000000000000000ULL, packedDisplay.getPackedLine(1)[1]);
+
+		EXPECT_FALSE(packedDisplay.xorLine(1, 124, 0x81));
+		EXPECT_EQ(0x100000000000000FULL, packedDisplay.getPackedLine(1)[0]);
+		EXPECT_EQ(0xF000000000000008ULL, packedDisplay.getPackedLine(1)[1]);
+
+		EXPECT_TRUE(packedDisplay.xorLine(1, 63, 0x80));
+		EXPECT_EQ(0x100000000000000EULL, packedDisplay.getPackedLine(1)[0]);
+	}
+}
+
+TEST_F(OriginalInterpreterTest, SaveState) {
+	const byte program[] = {
+		0x62,0x07, 0x63,0x30,
+
+		// Loop: draw digit (V0 & 7) at (V0; V0), count V0 up and restart delay timer on each 8th pass
+		0x70,0x01, 0x81,0x00, 0x81,0x22, 0xF1,0x29, 0xD0,0x05, 0xC4,0xFF, 0x31,0x00, 0x12,0x04,
+		0xF3,0x15, 0xF3,0x18, 0x12,0x04
+	};
+	typedef BasicInterpreter<PackedDisplay, MockPad> PackedInterpreter;
+
+	interpreter->reset(program);
+	interpreter->doCycles(20000);
+	EXPECT_TRUE(interpreter->scheduleKeys(1000000, PadKeys::KEY_1));
+
+	std::vector<chip8::clock> buffer(interpreter->getStateSize() / sizeof(chip8::clock) + 1);
+	const size_t size = interpreter->getStateSize();
+
+	EXPECT_FALSE(interpreter->saveState(buffer.data(), size - 1));
+	ASSERT_TRUE(interpreter->saveState(buffer.data(), size));
+
+	const chip8::clock savedCycles = interpreter->getCyclesCount();
+
+	interpreter->doCycles(50000);
+
+	const chip8::clock cycles = interpreter->getCyclesCount();
+	const word timerDelay = snapshot.getTimerDelay();
+	const word timerSound = snapshot.getTimerSound();
+	const word pc = snapshot.getProgramCounterValue();
+	byte registers[Interpreter::REGISTERS_COUNT];
+	for (size_t idx = 0; idx < Interpreter::REGISTERS_COUNT; ++idx) {
+		registers[idx] = byte(snapshot.getRegisterValue(idx));
+	}
+	Frame frame;
+	display->unpack(frame);
+
+	// Same interpreter goes the same way again
+	ASSERT_TRUE(interpreter->loadState(buffer.data(), size));
+	EXPECT_EQ(savedCycles, interpreter->getCyclesCount());
+
+	interpreter->doCycles(50000);
+	EXPECT_EQ(cycles, interpreter->getCyclesCount());
+	EXPECT_EQ(pc, snapshot.getProgramCounterValue());
+	EXPECT_EQ(timerDelay, snapshot.getTimerDelay());
+	EXPECT_EQ(timerSound, snapshot.getTimerSound());
+	for (size_t idx = 0; idx < Interpreter::REGISTERS_COUNT; ++idx) {
+		EXPECT_EQ(registers[idx], snapshot.getRegisterValue(idx));
+	}
+	EXPECT_EQ(0, memcmp(*display, frame, sizeof(Frame)));
+
+	// So does another one over other devices, with the state passed through a stream
+	std::stringstream stream;
+	ASSERT_TRUE(interpreter->loadState(buffer.data(), size));
+	ASSERT_TRUE(interpreter->saveState(stream));
+
+	PackedDisplay packedDisplay;
+	PackedInterpreter packed(&packedDisplay, keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL);
+
+	PackedInterpreter::Snapshot packedSnapshot;
+	PackedInterpreter::Snapshot::obtain(packedSnapshot, packed);
+
+	ASSERT_TRUE(packed.loadState(stream));
+	EXPECT_EQ(size, packed.getStateSize());
+
+	packed.doCycles(50000);
+	EXPECT_EQ(cycles, packed.getCyclesCount());
+	EXPECT_EQ(pc, packedSnapshot.getProgramCounterValue());
+	for (size_t idx = 0; idx < Interpreter::REGISTERS_COUNT; ++idx) {
+		EXPECT_EQ(registers[idx], packedSnapshot.getRegisterValue(idx));
+	}
+	Frame packedFrame;
+	packedDisplay.unpack(packedFrame);
+	EXPECT_EQ(0, memcmp(packedFrame, frame, sizeof(Frame)));
+
+	// States of other machines are rejected
+	DefaultDisplay largeDisplay(128, 64);
+	Interpreter large(&largeDisplay, keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL);
+	Interpreter smaller(display.get(), keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL, 0x800);
+
+	EXPECT_FALSE(large.loadState(buffer.data(), size));
+	EXPECT_FALSE(smaller.loadState(buffer.data(), size));
+	EXPECT_FALSE(interpreter->loadState(buffer.data(), size - 1));
+
+	// So are states with events, which can't be dispatched
+	const size_t eventsCount = reinterpret_cast<const Interpreter::State *>(buffer.data())->eventsCount;
+	ASSERT_LT(size_t(0), eventsCount);
+
+	Scheduler::Event &event = reinterpret_cast<Scheduler::Event *>(reinterpret_cast<byte *>(buffer.data()) + size)[-1];
+	ASSERT_EQ(Interpreter::EVENT_KEYS, event.kind);
+
+	event.kind = Interpreter::EVENT_TIMER_SET;
+	event.target = Interpreter::TIMER_SOUND + 1;
+	EXPECT_FALSE(interpreter->loadState(buffer.data(), size));
+
+	event.kind = Interpreter::EVENT_KEYS + 1;
+	event.target = 0;
+	EXPECT_FALSE(interpreter->loadState(buffer.data(), size));
+
+	event.kind = Interpreter::EVENT_TIMER_SET;
+	event.target = Interpreter::TIMER_SOUND;
+	EXPECT_TRUE(interpreter->loadState(buffer.data(), size));
+}
+
+TEST_F(OriginalInterpreterTest, Rewind) {
+	const byte program[] = {
+		0x62,0x07, 0x63,0x30,
+
+		// Loop: draw digit (V0 & 7) at (V0; V0), store V0 through V4 at random page, restart timers on each 8th pass
+		0x70,0x01, 0x81,0x00, 0x81,0x22, 0xF1,0x29, 0xD0,0x05, 0xC4,0xFF, 0xA3,0x00, 0xF4,0x1E, 0xF4,0x1E,
+		0xF4,0x1E, 0xF4,0x55, 0x31,0x00, 0x12,0x04, 0xF3,0x15, 0xF3,0x18, 0x12,0x04
+	};
+	std::vector<std::vector<byte>> states;
+
+	// Each budget keeps all, some and none of the deltas
+	for (size_t budget : { 0x100000, 0x2000, 0x10 }) {
+		chip8::Rewind history(budget);
+
+		interpreter->reset(program);
+		states.clear();
+
+		for (size_t frame = 0; frame < 40; ++frame) {
+			interpreter->doCycles(1467);
+
+			states.push_back(std::vector<byte>(interpreter->getStateSize()));
+			ASSERT_TRUE(interpreter->saveState(states.back().data(), states.back().size()));
+
+			history.push(*interpreter);
+			EXPECT_EQ(interpreter->getStateSize(), history.getStateSize());
+		}
+		EXPECT_GT(size_t(40), history.getDepth());
+		if (budget > 0x10000) {
+			EXPECT_EQ(size_t(39), history.getDepth());
+		}
+		if (budget < 0x100) {
+			EXPECT_EQ(size_t(0), history.getDepth());
+		}
+
+		// Steps back restore the states saved
+		size_t frame = states.size() - 1;
+		for (size_t steps : { 0, 1, 5, 100 }) {
+			const size_t depth = history.getDepth();
+
+			EXPECT_EQ(std::min(steps, depth), history.rewind(steps));
+			frame -= std::min(steps, depth);
+
+			ASSERT_EQ(states[frame].size(), history.getStateSize());
+			EXPECT_EQ(0, memcmp(states[frame].data(), history.getState(), history.getStateSize()));
+		}
+
+		// Interpreter goes on from the state it's rewound to, and back to it
+		const chip8::clock cycles = reinterpret_cast<const Interpreter::State *>(states[frame].data())->countCycles;
+
+		history.rewind(*interpreter, 0);
+		EXPECT_EQ(cycles, interpreter->getCyclesCount());
+
+		for (size_t i = 0; i < 3; ++i) {
+			interpreter->doCycles(1467);
+			history.push(*interpreter);
+		}
+		const size_t depth = history.getDepth();
+
+		EXPECT_EQ(std::min<size_t>(3, depth), history.rewind(*interpreter, 3));
+		if (depth >= 3) {
+			EXPECT_EQ(cycles, interpreter->getCyclesCount());
+		}
+	}
+	ASSERT_TRUE(interpreter->isOk());
+}
+
+TEST_F(OriginalInterpreterTest, InputReplay) {
+	const byte program[] = {
+		0x65,0x05,
+
+		// Loop: count passes with key 5 held into V1, sum random numbers into V2, await a key on random zero
+		0xC0,0xFF, 0xE5,0xA1, 0x71,0x01, 0x82,0x04, 0x30,0x00, 0x12,0x02, 0xF3,0x0A, 0x12,0x02
+	};
+	const PadKeys pattern[] = {
+		PadKeys::KEY_5, PadKeys::KEY_5, PadKeys::KEY_NONE, PadKeys(PadKeys::KEY_3 | PadKeys::KEY_5),
+		PadKeys::KEY_NONE, PadKeys::KEY_NONE, PadKeys::KEY_3
+	};
+
+	// Record a run from reset, which is stepped back once midway
+	InputLog log;
+	MockPad device;
+	RecordingKeyPad<MockPad> recording(&device, &log);
+
+	Interpreter recorder(display.get(), &recording, Interpreter::ALU_PROFILE_ORIGINAL);
+	Interpreter::Snapshot recorded;
+	Interpreter::Snapshot::obtain(recorded, recorder);
+
+	recording.bind(&recorder);
+	recorder.setSeed(0x1234);
+	recorder.reset(program);
+	log.clear(0x1234, recorder.getQuirks());
+
+	std::vector<byte> state(recorder.getStateSize());
+	for (size_t frame = 0; frame < 300; ++frame) {
+		if (frame == 150) {
+			ASSERT_TRUE(recorder.saveState(state.data(), state.size()));
+		}
+		if (frame == 200) {
+			ASSERT_TRUE(recorder.loadState(state.data(), state.size()));
+		}
+		device.setState(pattern[frame * (frame < 200 ? 1 : 3) % 7]);
+		recorder.run(1466);
+	}
+	ASSERT_TRUE(recorder.isOk());
+	log.setCycles(recorder.getCyclesCount());
+
+	ASSERT_LT(size_t(50), log.getEntries().size());
+	for (size_t i = 1; i < log.getEntries().size(); ++i) {
+		EXPECT_LT(log.getEntries()[i - 1].timestamp, log.getEntries()[i].timestamp);
+		EXPECT_NE(log.getEntries()[i - 1].keys, log.getEntries()[i].keys);
+	}
+	EXPECT_GT(log.getCycles(), log.getEntries().back().timestamp);
+
+	// Log goes through text as is
+	std::stringstream text;
+	ASSERT_TRUE(log.write(text));
+
+	InputLog loaded;
+	ASSERT_TRUE(loaded.read(text));
+	EXPECT_EQ(log.getSeed(), loaded.getSeed());
+	EXPECT_EQ(log.getQuirks(), loaded.getQuirks());
+	EXPECT_EQ(log.getCycles(), loaded.getCycles());
+	ASSERT_EQ(log.getEntries().size(), loaded.getEntries().size());
+	for (size_t i = 0; i < log.getEntries().size(); ++i) {
+		EXPECT_EQ(log.getEntries()[i].timestamp, loaded.getEntries()[i].timestamp);
+		EXPECT_EQ(log.getEntries()[i].keys, loaded.getEntries()[i].keys);
+	}
+
+	std::istringstream garbage("C8IN 1\nseed 1\nquirks 0\ncycles 10\n5 0020\n3 0000\n");
+	EXPECT_FALSE(loaded.read(garbage));
+	EXPECT_EQ(log.getEntries().size(), loaded.getEntries().size());
+
+	// Replay ends where the recording did, in one run or in many
+	keypad->setState(PadKeys::KEY_NONE);
+
+	for (chip8::clock slice : { loaded.getCycles(), chip8::clock(1000), chip8::clock(1) }) {
+		InputReplay replay(loaded);
+		replay.prepare(*interpreter);
+		interpreter->reset(program);
+
+		while (interpreter->isOk() && interpreter->getCyclesCount() < loaded.getCycles()) {
+			replay.run(*interpreter, std::min<chip8::clock>(slice, loaded.getCycles() - interpreter->getCyclesCount()));
+		}
+		ASSERT_TRUE(interpreter->isOk());
+		EXPECT_EQ(recorder.getCyclesCount(), interpreter->getCyclesCount());
+		EXPECT_EQ(recorded.getProgramCounterValue(), snapshot.getProgramCounterValue());
+		EXPECT_EQ(recorder.isKeyAwaited(), interpreter->isKeyAwaited());
+
+		for (byte x = 0; x < 4; ++x) {
+			EXPECT_EQ(recorded.getRegisterValue(x), snapshot.getRegisterValue(x));
+		}
+	}
+}
+
+TEST_F(OriginalInterpreterTest, IdleLoop) {
+	const byte program[] = {
+		0x60,0x30, 0xF0,0x15,
+
+		// Wait for the delay timer, count the wait done, then park in a jump to itself
+		0xF1,0x07, 0x31,0x00, 0x12,0x04, 0x72,0x01, 0x12,0x0C
+	};
+	DefaultDisplay referenceDisplay;
+	Interpreter reference(&referenceDisplay, keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL);
+
+	std::vector<byte> state(interpreter->getStateSize());
+	std::vector<byte> referenceState(reference.getStateSize());
+
+	keypad->setState(PadKeys::KEY_NONE);
+
+	// Runs skip idle passes, but end on the same cycles as the machine run one instruction at a time
+	for (chip8::clock budget : { 100000, 1467, 500, 81, 1 }) {
+		interpreter->setSeed(0x1234);
+		interpreter->reset(program);
+		interpreter->resetCounters();
+
+		reference.setSeed(0x1234);
+		reference.reset(program);
+
+		while (interpreter->getCyclesCount() < 200000) {
+			if (budget == 1467) {
+				interpreter->doCycles(budget);
+			}
+			else {
+				interpreter->run(budget);
+			}
+			while (reference.getCyclesCount() < interpreter->getCyclesCount()) {
+				reference.doCycle();
+			}
+			ASSERT_EQ(reference.getCyclesCount(), interpreter->getCyclesCount());
+		}
+		EXPECT_EQ(reference.getInstructionsCount(), interpreter->getInstructionsCount());
+
+		ASSERT_TRUE(interpreter->saveState(state.data(), state.size()));
+		ASSERT_TRUE(reference.saveState(referenceState.data(), referenceState.size()));
+		EXPECT_EQ(0, memcmp(state.data(), referenceState.data(), state.size()));
+
+		EXPECT_EQ(0x01, snapshot.getRegisterValue(2));
+		EXPECT_EQ(Interpreter::OFFSET_PROGRAM_START + 12, snapshot.getProgramCounterValue());
+
+#if CHIP8_COUNTERS && CHIP8_IDLE_SKIP
+		const Interpreter::Counters counters = interpreter->getCounters();
+		if (budget > 81) {
+			EXPECT_LT(interpreter->getCyclesCount() / 2, counters.idleCycles);
+		}
+#endif // CHIP8_COUNTERS && CHIP8_IDLE_SKIP
+	}
+}
+
+TEST_F(OriginalInterpreterTest, KeyAwaitParked) {
+	// Count the keys hit, forever
+	const byte program[] = { 0xF1,0x0A, 0x72,0x01, 0x12,0x00 };
+
+	DefaultDisplay referenceDisplay;
+	Interpreter reference(&referenceDisplay, keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL);
+
+	std::vector<byte> state(interpreter->getStateSize());
+	std::vector<byte> referenceState(reference.getStateSize());
+
+	const struct {
+		chip8::clock timestamp;
+		PadKeys keys;
+	} hits[] = {
+		{ 20000, PadKeys::KEY_5 }, { 30000, PadKeys::KEY_NONE },
+		{ 100000, PadKeys::KEY_2 }, { 100005, PadKeys::KEY_NONE }
+	};
+
+	keypad->setState(PadKeys::KEY_NONE);
+
+	// Parked runs take keys on the same passes as the machine run one pass at a time
+	for (chip8::clock budget : { 100000, 1467, 500, 1 }) {
+		interpreter->setSeed(0x1234);
+		interpreter->reset(program);
+
+		reference.setSeed(0x1234);
+		reference.reset(program);
+
+		for (const auto &hit : hits) {
+			ASSERT_TRUE(interpreter->scheduleKeys(hit.timestamp, hit.keys));
+			ASSERT_TRUE(reference.scheduleKeys(hit.timestamp, hit.keys));
+		}
+
+		while (interpreter->getCyclesCount() < 200000) {
+			if (budget == 1467) {
+				interpreter->doCycles(budget);
+			}
+			else {
+				interpreter->run(budget);
+			}
+			while (reference.getCyclesCount() < interpreter->getCyclesCount()) {
+				reference.doCycle();
+			}
+			ASSERT_EQ(reference.getCyclesCount(), interpreter->getCyclesCount());
+		}
+		ASSERT_TRUE(interpreter->saveState(state.data(), state.size()));
+		ASSERT_TRUE(reference.saveState(referenceState.data(), referenceState.size()));
+		EXPECT_EQ(0, memcmp(state.data(), referenceState.data(), state.size()));
+
+		EXPECT_EQ(0x02, snapshot.getRegisterValue(2));
+		EXPECT_EQ(0x02, snapshot.getRegisterValue(1));
+		EXPECT_TRUE(interpreter->isKeyAwaited());
+	}
+
+	// Parked machine doesn't poll the key pad each pass, pushed keys wake it up
+	interpreter->reset(program);
+	interpreter->run(100);
+
+	const size_t polls = keypad->getPolls();
+	interpreter->run(1000000);
+	EXPECT_GT(1000000 / 1467 + 2, keypad->getPolls() - polls);
+	EXPECT_TRUE(interpreter->isKeyAwaited());
+
+	interpreter->pushKeys(PadKeys::KEY_7);
+	interpreter->run(100);
+	EXPECT_TRUE(interpreter->isKeyAwaited());
+	EXPECT_EQ(0x04, snapshot.getTimerSound());
+
+	interpreter->pushKeys(PadKeys::KEY_NONE);
+	interpreter->run(100);
+	EXPECT_EQ(0x07, snapshot.getRegisterValue(1));
+	EXPECT_EQ(0x01, snapshot.getRegisterValue(2));
+	EXPECT_EQ(0x00, snapshot.getTimerSound());
+
+	// doCycles() samples the key pad on every pass, parked or not
+	interpreter->reset(program);
+	interpreter->doCycles(100);
+
+	const size_t passPolls = keypad->getPolls();
+	interpreter->doCycles(9000);
+	EXPECT_LE(size_t(9000 / 9), keypad->getPolls() - passPolls);
+	EXPECT_TRUE(interpreter->isKeyAwaited());
+}
+
+TEST_F(OriginalInterpreterTest, Batch) {
+	const byte digits[] = {
+		0x62,0x07,
+
+		// Loop: draw digit (V0 & 7) at (V0; V0) until V0 is 0x40
+		0x70,0x01, 0x81,0x00, 0x81,0x22, 0xF1,0x29, 0xD0,0x05, 0x30,0x40, 0x12,0x02,
+
+		0x12,0x10
+	};
+	const byte keys[] = {
+		// Loop: draw digit of the key hit at (V2; V2), V2 += 5
+		0xF1,0x0A, 0xF1,0x29, 0xD2,0x25, 0x72,0x05, 0x12,0x00
+	};
+	const byte shifts[] = {
+		// Loop: V0 = V1 >> 1 (VX or VY one, see quirks), draw the digit of V0 & 0xF, clear screen each 16th pass
+		0x61,0x9B, 0x80,0x16, 0x63,0x0F, 0x83,0x02, 0xF3,0x29, 0xD4,0x45, 0x74,0x03, 0x71,0x01,
+		0x34,0x30, 0x12,0x02, 0x00,0xE0, 0x64,0x00, 0x12,0x02
+	};
+	const byte random[] = {
+		// Loop: draw a random digit at a random place
+		0xC0,0x0F, 0xF0,0x29, 0xC1,0x3F, 0xC2,0x1F, 0xD1,0x25, 0x12,0x00
+	};
+	const Batch::KeyEvent input[] = {
+		{ 2000, PadKeys::KEY_3 }, { 2500, PadKeys::KEY_NONE },
+		{ 30000, PadKeys::KEY_A }, { 31000, PadKeys::KEY_NONE },
+		{ 90000, PadKeys::KEY_7 }, { 90500, PadKeys::KEY_NONE }
+	};
+
+	std::vector<Batch::Job> jobs;
+	for (unsigned quirks = 0; quirks < Interpreter::QUIRKS_COUNT; quirks += 3) {
+		for (chip8::clock cycles : { 1, 5000, 100000 }) {
+			jobs.push_back({ digits, sizeof(digits), quirks, 0, cycles, nullptr, 0 });
+			jobs.push_back({ keys, sizeof(keys), quirks, 0, cycles, input, sizeof(input) / sizeof(input[0]) });
+			jobs.push_back({ shifts, sizeof(shifts), quirks, 0, cycles, nullptr, 0 });
+			jobs.push_back({ random, sizeof(random), quirks, word(quirks * 0x3D + cycles), cycles, nullptr, 0 });
+			jobs.push_back({ random, sizeof(random), quirks, 0x1234, cycles, nullptr, 0 });
+		}
+	}
+	jobs.push_back({ digits, 0, 0, 0, 1000, nullptr, 0 });
+
+	// Results of the same jobs run one by one
+	std::vector<Batch::Result> expected(jobs.size());
+	keypad->setState(PadKeys::KEY_NONE);
+
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		interpreter->setQuirks(jobs[i].quirks);
+		interpreter->setSeed(jobs[i].seed);
+		interpreter->reset(jobs[i].program, jobs[i].programSize);
+
+		for (size_t key = 0; key < jobs[i].keysCount; ++key) {
+			ASSERT_TRUE(interpreter->scheduleKeys(jobs[i].keys[key].timestamp, jobs[i].keys[key].keys));
+		}
+		if (interpreter->isOk()) {
+			interpreter->run(jobs[i].cycles);
+		}
+		expected[i].frameHash = Batch::hashFrame(*display, display->area());
+		expected[i].cycles = interpreter->getCyclesCount();
+		expected[i].error = interpreter->getLastError();
+	}
+
+	for (chip8::clock slice : { 1, 1000, 0x10000 }) {
+		Batch batch(4, slice, 3);
+		std::vector<Batch::Result> results(jobs.size());
+
+		batch.run(jobs.data(), jobs.size(), results.data());
+
+		for (size_t i = 0; i < jobs.size(); ++i) {
+			EXPECT_EQ(expected[i].frameHash, results[i].frameHash) << "job " << i << ", slice " << slice;
+			EXPECT_EQ(expected[i].cycles, results[i].cycles) << "job " << i << ", slice " << slice;
+			EXPECT_EQ(expected[i].error, results[i].error) << "job " << i << ", slice " << slice;
+		}
+	}
+	EXPECT_EQ(Interpreter::INTERPRETER_ERROR_NO_PROGRAM, expected.back().error);
+}
+
+TEST_F(OriginalInterpreterTest, Lockstep) {
+	const byte keys[] = {
+		// Loop: draw digit of the key hit at (V2; V2), V2 += 5, store its BCD
+		0xF1,0x0A, 0xF1,0x29, 0xD2,0x25, 0x72,0x05, 0xA3,0x00, 0xF2,0x33, 0x12,0x00
+	};
+	const byte random[] = {
+		// Loop: draw random digits at random places, call a routine (sets delay timer) each 8th pass
+		0xC0,0x3F, 0xC1,0x1F, 0xC2,0x0F, 0xF2,0x29, 0xD0,0x15, 0x73,0x01, 0x64,0x07,
+		0x84,0x32, 0x34,0x00, 0x12,0x00, 0x22,0x18, 0x12,0x00,
+
+		0xF3,0x15, 0xF3,0x07, 0xA3,0x00, 0xF3,0x55, 0x00,0xEE
+	};
+	const byte branches[] = {
+		// Loop: V0 += V1, count carries in V2, step V4 while key (V0 & 0xF) is held, draw at (V2; V4), VF shifted
+		0x61,0x13, 0x80,0x14, 0x3F,0x01, 0x12,0x0A, 0x72,0x01, 0x63,0x0F, 0x83,0x02, 0xE3,0x9E,
+		0x12,0x14, 0x74,0x05, 0xF3,0x29, 0xD2,0x42, 0x85,0xF6, 0x12,0x02
+	};
+
+	struct Case {
+		const byte *program;
+		size_t programSize;
+		unsigned quirks;
+	};
+	const Case cases[] = {
+		{ keys, sizeof(keys), Interpreter::QUIRK_NONE },
+		{ random, sizeof(random), Interpreter::QUIRK_SHIFT_VX | Interpreter::QUIRK_LOAD_STORE_KEEP_I },
+		{ branches, sizeof(branches), Interpreter::QUIRK_SPRITE_WRAP | Interpreter::QUIRK_LOGIC_VF_RESET },
+		{ branches, sizeof(branches), Interpreter::QUIRK_NONE }
+	};
+
+	Lockstep<8> lockstep;
+	const size_t lanes = lockstep.LANES_COUNT;
+
+	std::vector<byte> initial[lanes];
+	keypad->setState(PadKeys::KEY_NONE);
+
+	for (const Case &test : cases) {
+		interpreter->setQuirks(test.quirks);
+		lockstep.setQuirks(test.quirks);
+		lockstep.reset(test.program, test.programSize);
+
+		// Each lane gets its own seed and keys, states go through the interpreter.
+		for (size_t lane = 0; lane < lanes; ++lane) {
+			interpreter->reset(test.program, test.programSize);
+
+			for (word hit = 0; hit < 8; ++hit) {
+				const chip8::clock timestamp = 20000 + (hit * lanes + lane) * 7001;
+
+				ASSERT_TRUE(interpreter->scheduleKeys(timestamp, PadKeys(1 << ((lane + hit) % 0x10))));
+				ASSERT_TRUE(interpreter->scheduleKeys(timestamp + 20000 + lane * 100, PadKeys::KEY_NONE));
+			}
+			initial[lane].resize(interpreter->getStateSize());
+			ASSERT_TRUE(interpreter->saveState(initial[lane].data(), initial[lane].size()));
+
+			reinterpret_cast<Interpreter::State *>(initial[lane].data())->rndSeed = word(lane * 0x1F3);
+			ASSERT_TRUE(lockstep.loadState(lane, initial[lane].data(), initial[lane].size()));
+		}
+
+		for (chip8::clock budget : { 1000, 50000, 400000 }) {
+			lockstep.run(budget);
+
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				ASSERT_TRUE(interpreter->loadState(initial[lane].data(), initial[lane].size()));
+				interpreter->run(budget);
+
+				initial[lane].resize(interpreter->getStateSize());
+				ASSERT_TRUE(interpreter->saveState(initial[lane].data(), initial[lane].size()));
+
+				std::vector<byte> state(lockstep.getStateSize(lane));
+				ASSERT_TRUE(lockstep.saveState(lane, state.data(), state.size()));
+
+				EXPECT_TRUE(state == initial[lane]) << "lane " << lane << ", budget " << budget;
+				EXPECT_TRUE(interpreter->isOk());
+			}
+		}
+	}
+	EXPECT_LT(lockstep.getStepsCount(), lockstep.getLaneStepsCount());
+
+	// Lanes refuse states with events, which can't be dispatched
+	std::vector<byte> &state = initial[0];
+	Scheduler::Event &event = reinterpret_cast<Scheduler::Event *>(state.data() + state.size())[-1];
+
+	event.kind = Interpreter::EVENT_TIMER_SET;
+	event.target = Interpreter::TIMER_SOUND + 1;
+	EXPECT_FALSE(lockstep.loadState(0, state.data(), state.size()));
+}
+
+TEST_F(OriginalInterpreterTest, Executor) {
+	// Tasks run in the order each thread posts them
+	{
+		const size_t producers = 4, tasks = 10000;
+
+		std::vector<size_t> done(producers, 0);
+		size_t misordered = 0;
+		std::atomic<bool> finished(false);
+
+		Executor executor;
+		std::vector<std::thread> threads;
+
+		for (size_t id = 0; id < producers; ++id) {
+			threads.emplace_back([&, id]() {
+				for (size_t i = 0; i < tasks; ++i) {
+					while (!executor.post([&, id, i]() { misordered += done[id]++ != i; })) {
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		for (auto &thread : threads) {
+			thread.join();
+		}
+		while (!executor.post([&]() { finished = true; })) {
+			std::this_thread::yield();
+		}
+		while (!finished) {
+			std::this_thread::yield();
+		}
+		EXPECT_EQ(std::vector<size_t>(producers, tasks), done);
+		EXPECT_EQ(0, misordered);
+	}
+
+	// Tasks are stored inline, posts fail once the ring is full, the ones not run are destroyed
+	{
+		std::shared_ptr<int> owner(new int(0));
+		std::atomic<bool> blocked(true);
+
+		{
+			Executor executor;
+
+			ASSERT_TRUE(executor.post([&blocked]() {
+				while (blocked) {
+					std::this_thread::yield();
+				}
+			}));
+			for (size_t i = 1; i < Executor::CAPACITY; ++i) {
+				EXPECT_TRUE(executor.post([owner]() { ++*owner; }));
+			}
+			EXPECT_FALSE(executor.post([owner]() { ++*owner; }));
+
+			blocked = false;
+		}
+		EXPECT_EQ(1, owner.use_count());
+		EXPECT_GE(Executor::CAPACITY - 1, size_t(*owner));
+	}
+
+	// Step runs while resumed only, a post wakes it up from a deadline wait
+	{
+		std::atomic<size_t> steps(0), wakeups(0);
+		std::function<bool()> wait;
+
+		Executor executor([&]() {
+			++steps;
+
+			if (wait()) {
+				++wakeups;
+			}
+		});
+		wait = [&]() { return executor.waitUntil(Executor::Clock::now() + std::chrono::seconds(60)); };
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		EXPECT_TRUE(executor.isPaused());
+		EXPECT_EQ(0, steps);
+
+		executor.resume();
+		while (steps == 0) {
+			std::this_thread::yield();
+		}
+		ASSERT_TRUE(executor.post([]() { /* Nothing to do */ }));
+
+		const auto deadline = Executor::Clock::now() + std::chrono::seconds(10);
+		while (steps < 2 && Executor::Clock::now() < deadline) {
+			std::this_thread::yield();
+		}
+		EXPECT_LE(1, wakeups);
+
+		std::atomic<size_t> stepsPaused(0);
+		executor.pause();
+		ASSERT_TRUE(executor.post([&]() { stepsPaused = size_t(steps); }));
+
+		while (stepsPaused == 0) {
+			std::this_thread::yield();
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		EXPECT_EQ(stepsPaused, steps);
+	}
+}
+
+TEST_F(OriginalInterpreterTest, FrameChannel) {
+	// Publishing copies forward the lines changed, consumer takes the latest frame only
+	{
+		FrameChannel channel;
+
+		channel.xorLine(5, 0, 0xFF);
+		channel.publish();
+		channel.xorLine(7, 8, 0x81);
+		channel.publish();
+		EXPECT_EQ(2, channel.getLinesCopied());
+
+		ASSERT_TRUE(channel.acquire());
+		EXPECT_EQ(2, channel.getFrameSequence());
+		EXPECT_EQ((uint64_t(1) << 5) | (uint64_t(1) << 7), channel.getChangedLines());
+		EXPECT_EQ(0xFF, channel.getFrame()[5 * channel.width() + 7]);
+		EXPECT_EQ(0xFF, channel.getFrame()[7 * channel.width() + 15]);
+		EXPECT_FALSE(channel.acquire());
+
+		std::vector<byte> frame(channel.area());
+		channel.unpack(frame.data());
+		EXPECT_EQ(0, memcmp(frame.data(), channel.getFrame(), frame.size()));
+	}
+
+	// Consumer on another thread sees whole frames, updating the lines changed only
+	{
+		const byte random[] = {
+			// Loop: draw random digits at random places, clear the screen each 64th pass
+			0xC0,0x3F, 0xC1,0x1F, 0xC2,0x0F, 0xF2,0x29, 0xD0,0x15, 0x73,0x01, 0x64,0x3F,
+			0x84,0x32, 0x34,0x00, 0x12,0x00, 0x00,0xE0, 0x12,0x00
+		};
+		const size_t frames = 2000;
+
+		FrameChannel channel;
+		BasicInterpreter<FrameChannel, MockPad> producer(&channel, keypad.get());
+
+		std::vector<byte> expected(channel.area() * (frames + 1), 0x00);
+		size_t mismatches = 0, skipped = 0;
+
+		producer.reset(random);
+
+		std::thread consumer([&]() {
+			std::vector<byte> image(channel.area(), 0x00);
+			uint64_t sequence = 0;
+
+			while (sequence < frames) {
+				if (!channel.acquire()) {
+					std::this_thread::yield();
+					continue;
+				}
+				skipped += size_t(channel.getFrameSequence() - sequence - 1);
+				mismatches += channel.getFrameSequence() <= sequence;
+				sequence = channel.getFrameSequence();
+
+				for (byte y = 0; y < channel.height(); ++y) {
+					if (!!((channel.getChangedLines() >> y) & 0x01)) {
+						memcpy(image.data() + y * channel.width(), channel.getFrame() + y * channel.width(), channel.width());
+					}
+				}
+				mismatches += memcmp(image.data(), &expected[size_t(sequence) * channel.area()], image.size()) != 0;
+			}
+		});
+
+		for (size_t i = 1; i <= frames; ++i) {
+			producer.run(2000);
+			channel.unpack(&expected[i * channel.area()]);
+			channel.publish();
+		}
+		consumer.join();
+
+		EXPECT_TRUE(producer.isOk());
+		EXPECT_EQ(0, mismatches);
+		EXPECT_GT(frames, skipped);
+		EXPECT_GT(frames * channel.height(), channel.getLinesCopied());
+	}
+}
+
+TEST_F(OriginalInterpreterTest, FramePacer) {
+	typedef FramePacer::Clock Clock;
+
+	// Time goes by a microsecond each read, so that spins end, and by the oversleep
+	// given past the time each sleep is up to.
+	Clock::time_point time;
+	Clock::duration oversleep = std::chrono::microseconds(0);
+	size_t sleeps = 0;
+
+	auto timeSource = [&time]() {
+		return time += std::chrono::microseconds(1);
+	};
+	auto sleeper = [&](Clock::time_point until) {
+		++sleeps;
+		time = until + oversleep;
+
+		return false;
+	};
+
+	// Frames keep the rate, none starts before its deadline, the spin margin follows oversleeps
+	{
+		FramePacer pacer(100, timeSource);
+		const Clock::time_point origin = time;
+
+		oversleep = std::chrono::milliseconds(1);
+		for (size_t i = 0; i < 50; ++i) {
+			ASSERT_TRUE(pacer.wait(sleeper));
+
+			// Frames start late, until the margin covers oversleeps.
+			const Clock::time_point due = origin + std::chrono::milliseconds(10) * i;
+			EXPECT_LE(due, time);
+			if (i >= 10) {
+				EXPECT_GT(due + std::chrono::microseconds(10), time);
+			}
+		}
+		// The first frame is due at once.
+		EXPECT_EQ(49, sleeps);
+		EXPECT_EQ(50, pacer.getStats().frames);
+		EXPECT_EQ(1, pacer.getStats().late);
+		EXPECT_LE(std::chrono::milliseconds(1), pacer.getSpinMargin());
+		EXPECT_GT(std::chrono::milliseconds(2), pacer.getSpinMargin());
+
+		oversleep = std::chrono::microseconds(0);
+		for (size_t i = 0; i < 50; ++i) {
+			ASSERT_TRUE(pacer.wait(sleeper));
+		}
+		EXPECT_EQ(std::chrono::microseconds(200), pacer.getSpinMargin());
+		EXPECT_EQ(0, pacer.getStats().restarts);
+	}
+
+	// Wait woken up early keeps the deadline
+	{
+		FramePacer pacer(100, timeSource);
+		const Clock::time_point origin = time;
+
+		ASSERT_TRUE(pacer.wait(sleeper));
+		EXPECT_FALSE(pacer.wait([](Clock::time_point) { return true; }));
+		EXPECT_EQ(1, pacer.getStats().frames);
+
+		ASSERT_TRUE(pacer.wait(sleeper));
+		EXPECT_LE(origin + std::chrono::milliseconds(10), time);
+		EXPECT_EQ(2, pacer.getStats().frames);
+	}
+
+	// Late frames are made up for, frames far behind start the schedule over
+	{
+		FramePacer pacer(100, timeSource);
+		const Clock::time_point origin = time;
+
+		ASSERT_TRUE(pacer.wait(sleeper));
+		time += std::chrono::milliseconds(25);
+
+		// Frames 1 and 2 are due already, frame 3 is back on schedule.
+		sleeps = 0;
+		ASSERT_TRUE(pacer.wait(sleeper));
+		ASSERT_TRUE(pacer.wait(sleeper));
+		EXPECT_EQ(0, sleeps);
+		EXPECT_EQ(3, pacer.getStats().late);
+
+		ASSERT_TRUE(pacer.wait(sleeper));
+		EXPECT_LE(origin + std::chrono::milliseconds(30), time);
+		EXPECT_GT(origin + std::chrono::milliseconds(30) + std::chrono::microseconds(10), time);
+
+		time += std::chrono::milliseconds(100);
+		const Clock::time_point resumed = time;
+
+		ASSERT_TRUE(pacer.wait(sleeper));
+		ASSERT_TRUE(pacer.wait(sleeper));
+		EXPECT_EQ(1, pacer.getStats().restarts);
+		EXPECT_EQ(3, pacer.getStats().late);
+		EXPECT_LE(resumed + std::chrono::milliseconds(10), time);
+		EXPECT_GT(resumed + std::chrono::milliseconds(10) + std::chrono::microseconds(10), time);
+	}
+
+	// Real clock and sleeps don't run frames ahead of time
+	{
+		FramePacer pacer(1000);
+		const Clock::time_point started = Clock::now();
+
+		for (size_t i = 0; i < 5; ++i) {
+			ASSERT_TRUE(pacer.wait());
+		}
+		EXPECT_LE(std::chrono::milliseconds(4), Clock::now() - started);
+	}
+}
+
+TEST_F(OriginalInterpreterTest, FastAccess) {
+	const byte stackOverflow[] = { 0x22,0x00 };
+	const byte stackUnderflow[] = { 0x00,0xEE };
+	const byte programCounterCorrupted[] = { 0x11,0x00 };
+	const byte programCounterOverrun[] = { 0x1F,0xFF };
+	const byte storeOutOfBounds[] = { 0xAF,0xFE, 0xF2,0x55 };
+	const byte storeBelowProgram[] = { 0xA1,0xFF, 0xF0,0x55 };
+	const byte loadOutOfBounds[] = { 0xAF,0xFF, 0xF1,0x65 };
+	const byte bcdOutOfBounds[] = { 0xAF,0xFE, 0xF0,0x33 };
+	const byte spriteOutOfBounds[] = { 0xAF,0xFC, 0xD0,0x05 };
+	const byte valid[] = { 0xA3,0x00, 0x60,0x7B, 0xF0,0x33, 0xF2,0x65, 0xD0,0x13, 0x22,0x0E, 0x12,0x0C, 0x00,0xEE };
+
+	typedef BasicInterpreter<DefaultDisplay, MockPad, FastAccess> FastInterpreter;
+
+	DefaultDisplay fastDisplay;
+	FastInterpreter fast(&fastDisplay, keypad.get(), Interpreter::ALU_PROFILE_ORIGINAL);
+
+	FastInterpreter::Snapshot fastSnapshot;
+	FastInterpreter::Snapshot::obtain(fastSnapshot, fast);
+
+	const struct {
+		const byte *data;
+		size_t size;
+		Interpreter::Error error;
+	} programs[] = {
+		{ stackOverflow, sizeof(stackOverflow), Interpreter::INTERPRETER_ERROR_STACK_OVERFLOW },
+		{ stackUnderflow, sizeof(stackUnderflow), Interpreter::INTERPRETER_ERROR_STACK_OVERFLOW },
+		{ programCounterCorrupted, sizeof(programCounterCorrupted), Interpreter::INTERPRETER_ERROR_PROGRAM_COUNTER_CORRUPTED },
+		{ programCounterOverrun, sizeof(programCounterOverrun), Interpreter::INTERPRETER_ERROR_PROGRAM_COUNTER_CORRUPTED },
+		{ storeOutOfBounds, sizeof(storeOutOfBounds), Interpreter::INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS },
+		{ storeBelowProgram, sizeof(storeBelowProgram), Interpreter::INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS },
+		{ loadOutOfBounds, sizeof(loadOutOfBounds), Interpreter::INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS },
+		{ bcdOutOfBounds, sizeof(bcdOutOfBounds), Interpreter::INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS },
+		{ spriteOutOfBounds, sizeof(spriteOutOfBounds), Interpreter::INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS },
+		{ valid, sizeof(valid), Interpreter::INTERPRETER_ERROR_OK }
+	};
+	for (const auto &program : programs) {
+		interpreter->reset(program.data, program.size);
+		fast.reset(program.data, program.size);
+
+		EXPECT_EQ(interpreter->doCycles(10000), fast.doCycles(10000));
+		EXPECT_EQ(program.error, interpreter->getLastError());
+		EXPECT_EQ(program.error, fast.getLastError());
+		EXPECT_EQ(snapshot.getProgramCounterValue(), fastSnapshot.getProgramCounterValue());
+		EXPECT_EQ(snapshot.getIndexValue(), fastSnapshot.getIndexValue());
+		for (size_t idx = 0; idx < Interpreter::REGISTERS_COUNT; ++idx) {
+			EXPECT_EQ(snapshot.getRegisterValue(idx), fastSnapshot.getRegisterValue(idx));
+		}
+		EXPECT_EQ(0, memcmp(*display, fastDisplay, sizeof(Frame)));
+	}
+	EXPECT_TRUE(fast.isOk());
+}
+
+TEST_F(OriginalInterpreterTest, SelfModifyingCode_FX55_FX33) {
+	// Opcode FX55 rewrites an already executed instruction
+	{
+		const byte program[] = { 0x61,0x01, 0xA2,0x01, 0x60,0x2A, 0xF0,0x55, 0x12,0x00 };
+
+		interpreter->reset(program, sizeof(program));
+
+		interpreter->doCycle();
+		EXPECT_EQ(0x01, snapshot.getRegisterValue(1));
+
+		interpreter->doCycle();
+		interpreter->doCycle();
+		interpreter->doCycle();
+		EXPECT_EQ(0x2A, snapshot.getMemoryValue(Interpreter::OFFSET_PROGRAM_START + 1));
+
+		interpreter->doCycle();
+		EXPECT_EQ(Interpreter::OFFSET_PROGRAM_START, snapshot.getProgramCounterValue());
+
+		interpreter->doCycle();
+		EXPECT_EQ(0x2A, snapshot.getRegisterValue(1));
+		EXPECT_TRUE(interpreter->isOk());
+	}
+	// Opcode FX33 rewrites an already executed instruction
+	{
+		const byte program[] = { 0x61,0x01, 0xA2,0x01, 0x60,0xC8, 0xF0,0x33, 0x12,0x00 };
+
+		interpreter->reset(program, sizeof(program));
+
+		interpreter->doCycle();
+		EXPECT_EQ(0x01, snapshot.getRegisterValue(1));
+
+		interpreter->doCycle();
+		interpreter->doCycle();
+		interpreter->doCycle();
+		interpreter->doCycle();
+		EXPECT_EQ(Interpreter::OFFSET_PROGRAM_START, snapshot.getProgramCounterValue());
+
+		interpreter->doCycle();
+		EXPECT_EQ(0x02, snapshot.getRegisterValue(1));
+		EXPECT_TRUE(interpreter->isOk());
+	}
+}
+
 
 //////////////////////////////////////////////////////////////////////////////
 // Test Interpreter in MODERN ALU profile preset.
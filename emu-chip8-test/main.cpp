@@ -4,14 +4,20 @@
 #include "stdafx.h"
 
 
+#if defined(_WIN32)
 int _tmain(int argc, _TCHAR* argv[])
+#else
+int main(int argc, char* argv[])
+#endif // _WIN32
 {
 	::testing::InitGoogleTest(&argc, argv);
 
 	auto result = RUN_ALL_TESTS();
 
+#if defined(_WIN32) && !defined(CHIP8_TEST_NO_PAUSE)
 	std::cout << std::endl << "Hit ANY key to exit.";
 	_getch();
+#endif // _WIN32 && !CHIP8_TEST_NO_PAUSE
 
 	return result;
 }
@@ -5,11 +5,14 @@
 
 #pragma once
 
+#if defined(_WIN32)
 #include "targetver.h"
 
 #include <conio.h>
-#include <stdio.h>
 #include <tchar.h>
+#endif // _WIN32
+
+#include <stdio.h>
 
 #include <iostream>
 
@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef CHIP8_BATCH_
+#define CHIP8_BATCH_
+
+#include "Chip8Base.h"
+#include "Chip8Keyboard.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace chip8 {
+
+	// Runs many programs headless over all the cores. Each worker thread keeps a few
+	// interpreters active and runs them by turns, a slice of cycles at a time. Jobs,
+	// which are not started yet, wait within per-worker queues, and idle workers
+	// steal them from the others.
+	class Batch {
+	public:
+
+		enum : clock {
+			SLICE_DEFAULT = 0x10000
+		};
+
+		enum : size_t {
+			INSTANCES_PER_WORKER_DEFAULT = 4
+		};
+
+		struct KeyEvent {
+			clock timestamp;								// Cycle the keys get held from.
+			PadKeys keys;
+		};
+
+		struct Job {
+			const byte *program;
+			size_t programSize;
+
+			unsigned quirks;								// See InterpreterBase::Quirk.
+			word seed;										// Random generator seed, see BasicInterpreter::setSeed().
+			clock cycles;									// Cycles to run for.
+
+			const KeyEvent *keys;							// Input in timestamp order, may be nullptr.
+			size_t keysCount;
+		};
+
+		struct Result {
+			uint64_t frameHash;								// FNV-1a of the frame, a byte per pixel.
+			clock cycles;									// Cycles taken.
+			unsigned error;									// See InterpreterBase::Error.
+		};
+
+
+		// Workers count defaults to count of hardware threads.
+		Batch(size_t workersCount = 0, clock slice = SLICE_DEFAULT,
+			size_t instancesPerWorker = INSTANCES_PER_WORKER_DEFAULT);
+
+
+		// Run the jobs, results go in the same order. Returns after all are done.
+		void run(const Job *jobs, size_t count, Result *results);
+
+		size_t getWorkersCount() const {
+			return workersCount;
+		}
+
+
+		static uint64_t hashFrame(const byte *frame, size_t size);
+
+	private:
+
+		Batch(const Batch &);
+
+
+		size_t workersCount;
+		clock slice;
+		size_t instancesPerWorker;
+	};
+
+} // namespace chip8
+
+#endif // CHIP8_BATCH_
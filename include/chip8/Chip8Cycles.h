@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef CHIP8_CYCLES_
+#define CHIP8_CYCLES_
+
+// COSMAC VIP timing model shared by all the execution engines.
+//
+// Every instruction takes a fetch/decode overhead, which depends
+// on the group the opcode belongs to, plus its own execution time.
+#define COUNT_CYCLES_GROUP0_DEFAULT 40
+#define COUNT_CYCLES_GROUPN_DEFAULT 68
+
+#define COUNT_CYCLES_TAKEN_FOR(fetch, exec)		((fetch) + (exec))
+#define COUNT_CYCLES_TAKEN_BY_GROUP0(exec)		COUNT_CYCLES_TAKEN_FOR(COUNT_CYCLES_GROUP0_DEFAULT, (exec))
+#define COUNT_CYCLES_TAKEN_BY_GROUPN(exec)		COUNT_CYCLES_TAKEN_FOR(COUNT_CYCLES_GROUPN_DEFAULT, (exec))
+
+#define COUNT_CYCLES_TAKEN_BY_GROUPN_BRANCH(result, execTrue, execFalse) \
+	COUNT_CYCLES_TAKEN_FOR(COUNT_CYCLES_GROUPN_DEFAULT, (result) ? (execTrue) : (execFalse))
+
+// Timer tick period. Each machine cycle took 8 clock cycles on RCA1802, and
+// machine instructions take 2 to 3 machine cycles, so it takes 20 machine cycles
+// in average. COSMAC VIP operated on 1.76MHz, thus it processed 1760000 / 20 ~ 88000
+// instructions per second. Timer ticks at rate of 60Hz, so 88000 / 60 ~ 1467.
+#define COUNT_CYCLES_TIMER_TICK 1467
+
+// Approx. number of machine cycles that pass before a timer register is set.
+#define COUNT_CYCLES_TIMER_SET 72
+
+// Key await pass of FX0A, it is responsible for key debounce emulation.
+// Not sure, it'll take just 9 cycles.
+//
+// See: http://laurencescotford.co.uk/?p=347 for details.
+#define COUNT_CYCLES_KEY_AWAIT_PASS 9
+
+#endif // CHIP8_CYCLES_
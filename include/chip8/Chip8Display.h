@@ -5,22 +5,44 @@
 
 #include "Chip8Base.h"
 
+#include <algorithm>
+#include <cstdint>
+
 namespace chip8 {
 
 	class IDisplay {
 	public:
+
+		enum : byte {
+			LINES_TRACKED = 64								// Up to SCHIP high resolution mode height.
+		};
+
+
 		virtual ~IDisplay() { /* Nothing to do */ }
 
 		virtual word area() const = 0;
 		virtual byte width() const = 0;
 		virtual byte height() const = 0;
 
-		virtual byte *getLine(byte index, byte offset) = 0;
+		virtual void clear() = 0;
+
+		// XOR 8 pixels (MSB is the leftmost one) into the line starting at the offset,
+		// pixels past the right edge wrap around. Returns true, if any pixel got unset.
+		virtual bool xorLine(byte index, byte offset, byte bits) = 0;
+
+		// Fill the frame with a byte per pixel, 0x00 or 0xFF.
+		virtual void unpack(byte *frame) const = 0;
+
+		// Fill the display from the frame unpack() gives.
+		virtual void load(const byte *frame) = 0;
 		
 		virtual void invalidate() = 0;
 		virtual void invalidate(byte x, byte y, byte w, byte h) = 0;
 
+		// Area and lines cover all the changes made since the display was validated.
+		// Line N is changed, if bit N is set.
 		virtual void getInvalidArea(rect &r) const = 0;
+		virtual uint64_t getInvalidLines() const = 0;
 		virtual bool isInvalid() const = 0;
 
 		operator bool() const {
@@ -29,24 +51,64 @@ namespace chip8 {
 		operator bool() {
 			return isInvalid();
 		}
-		virtual operator byte*() {
-			return getLine(0, 0);
+
+	protected:
+
+		static bool xorPixels(byte *line, byte width, byte offset, byte bits) {
+			bool collision = false;
+
+			for (byte column = offset; !!bits; bits <<= 1) {
+				if (!!(bits & 0x80)) {
+					collision |= !(line[column] ^= 0xFF);
+				}
+				if (++column == width) {
+					column = 0;
+				}
+			}
+			return collision;
+		}
+
+		static uint64_t linesMask(byte y, byte h) {
+			return (h < LINES_TRACKED ? (uint64_t(1) << h) - 1 : ~uint64_t(0)) << y;
+		}
+
+		// Empty area (of zero size) is extended to the one given as is.
+		static void uniteArea(rect &area, byte x, byte y, byte w, byte h) {
+			if (area.w == 0 || area.h == 0) {
+				area.x = x;
+				area.y = y;
+				area.w = w;
+				area.h = h;
+				return;
+			}
+			const byte right = std::max<int>(area.x + area.w, x + w);
+			const byte bottom = std::max<int>(area.y + area.h, y + h);
+
+			area.x = std::min<byte>(area.x, x);
+			area.y = std::min<byte>(area.y, y);
+			area.w = right - area.x;
+			area.h = bottom - area.y;
 		}
 	};
 
 	class DisplayBase : public IDisplay {
 		bool invalid;
 		rect invalidArea;
+		uint64_t invalidLines;
 
 	public:
 
+		DisplayBase();
+
+
 		void validate();
 
-		void invalidate();
-		void invalidate(byte x, byte y, byte w, byte h);
+		void invalidate() final;
+		void invalidate(byte x, byte y, byte w, byte h) final;
 
-		void getInvalidArea(rect &r) const;
-		bool isInvalid() const;
+		void getInvalidArea(rect &r) const final;
+		uint64_t getInvalidLines() const final;
+		bool isInvalid() const final;
 	};
 
 	class DefaultDisplay : public DisplayBase {		
@@ -70,11 +132,103 @@ namespace chip8 {
 
 
 
-		word area() const;
-		byte width() const;
-		byte height() const;
+		word area() const final {
+			return a;
+		}
+		byte width() const final {
+			return w;
+		}
+		byte height() const final {
+			return h;
+		}
+
+		byte *getLine(byte index, byte offset) {
+			return buffer + index * w + offset;
+		}
+
+		operator byte*() {
+			return buffer;
+		}
+
+
+		void clear() final;
+
+		bool xorLine(byte index, byte offset, byte bits) final {
+			return xorPixels(buffer + index * w, w, offset, bits);
+		}
+
+		void unpack(byte *frame) const final;
+
+		void load(const byte *frame) final;
+	};
+
+	// Keeps a bit per pixel, so that each line of 64 pixels is a single word.
+	// Sprite line is XOR'ed and tested for collision as a whole. Width must be
+	// a multiple of 64, 128 pixels wide lines take two words.
+	class PackedDisplay : public DisplayBase {
+
+		byte w, h;
+		word a;
+
+		size_t stride;								// Words per line.
+
+		uint64_t *buffer;
+
+	public:
+
+		enum : byte {
+			WORD_PIXELS = 64
+		};
+
+
+		PackedDisplay(byte width = DefaultDisplay::FRAME_WIDTH, byte height = DefaultDisplay::FRAME_HEIGHT);
+
+		virtual ~PackedDisplay();
+
+
+
+		word area() const final {
+			return a;
+		}
+		byte width() const final {
+			return w;
+		}
+		byte height() const final {
+			return h;
+		}
+
+		const uint64_t *getPackedLine(byte index) const {
+			return buffer + index * stride;
+		}
+
+
+		void clear() final;
+
+		bool xorLine(byte index, byte offset, byte bits) final {
+			uint64_t *line = buffer + index * stride;
+
+			const size_t first = offset / WORD_PIXELS;
+			const size_t shift = offset % WORD_PIXELS;
+			const size_t second = (first + 1) % stride;
+
+			// Sprite line is aligned to the leftmost pixel of the word, then moved to the offset.
+			// Pixels moved out of the first word go to the next one, or to the first word's start.
+			const uint64_t pixels = uint64_t(bits) << (WORD_PIXELS - 8);
+			const uint64_t head = pixels >> shift;
+			const uint64_t tail = shift > (WORD_PIXELS - 8) ? pixels << (WORD_PIXELS - shift) : 0;
+
+			const bool collision = !!((line[first] & head) | (line[second] & tail));
+
+			line[first] ^= head;
+			line[second] ^= tail;
+
+			return collision;
+		}
+
+		void unpack(byte *frame) const final;
+		void unpackLine(byte index, byte *line) const;
 
-		byte *getLine(byte index, byte offset);
+		void load(const byte *frame) final;
 	};
 
 } // namespace chip8
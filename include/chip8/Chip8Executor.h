@@ -0,0 +1,133 @@
+#pragma once
+
+#ifndef CHIP8_EXECUTOR_
+#define CHIP8_EXECUTOR_
+
+#include "Chip8Base.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace chip8 {
+
+	// Worker thread, which runs tasks posted from any thread and, while resumed, a step
+	// function (a frame of emulation) in between. Tasks go into a bounded lock-free ring,
+	// many producers and the worker as the only consumer, and are stored inline there,
+	// so posting neither locks nor allocates. The worker blocks on a condition variable
+	// only while it has nothing to do, producers take its mutex only to wake it up then.
+	class Executor {
+	public:
+
+		typedef std::chrono::steady_clock Clock;
+
+		enum : size_t {
+			CAPACITY	= 64,									// Tasks, a power of 2.
+			TASK_SIZE	= 64									// Bytes a task may take.
+		};
+
+		explicit Executor(std::function<void()> step = std::function<void()>());
+		~Executor();
+
+
+		// Queue a callable to be run by the worker, in the order posted by this thread.
+		// Returns false, if the ring is full.
+		template <class TTask>
+		bool post(TTask &&task) {
+			typedef typename std::decay<TTask>::type Task;
+
+			static_assert(sizeof(Task) <= TASK_SIZE, "Task must fit the inline storage");
+			static_assert(alignof(Task) <= alignof(std::max_align_t), "Task must fit the inline storage");
+
+			Slot *slot = claim();
+			if (!slot) {
+				return false;
+			}
+			new (slot->storage) Task(std::forward<TTask>(task));
+			slot->perform = &performOf<Task>;
+			slot->discard = &discardOf<Task>;
+
+			publish(slot);
+
+			return true;
+		}
+
+		// Step is run while resumed, tasks are run either way.
+		void pause();
+		void resume();
+
+		bool isPaused() const {
+			return !running.load(std::memory_order_acquire);
+		}
+
+		// Worker only, for the step to wait for a frame deadline: returns as soon as a task
+		// is posted or the executor is paused or stopped (true), or once the deadline
+		// passes (false).
+		bool waitUntil(Clock::time_point deadline);
+
+	private:
+
+		Executor(const Executor &);
+
+
+		struct Slot {
+			std::atomic<size_t> sequence;					// Position it's free for, or that plus 1, once it's published.
+
+			void (*perform) (void *);						// Runs and destroys the task.
+			void (*discard) (void *);						// Destroys it only.
+
+			alignas(std::max_align_t) byte storage[TASK_SIZE];
+		};
+
+		Slot slots[CAPACITY];
+
+		alignas(64) std::atomic<size_t> tail;				// Producers claim positions here.
+		alignas(64) size_t head;							// Worker's position.
+
+		std::atomic<bool> running;
+		std::atomic<bool> stopping;
+		std::atomic<bool> signaled;							// Pause, resume or stop is not seen by the worker yet.
+
+		std::atomic<bool> sleeping;
+		std::mutex mutex;
+		std::condition_variable wakeup;
+
+		std::function<void()> step;
+		std::thread worker;
+
+
+		Slot *claim();
+		void publish(Slot *slot);
+		void notify();
+
+		bool isPending() const;
+		bool isIdle() const;
+
+		// Run the tasks published so far. Returns count of them.
+		size_t drain();
+		void loop();
+
+		template <class TTask>
+		static void performOf(void *storage) {
+			TTask &task = *static_cast<TTask *>(storage);
+
+			task();
+			task.~TTask();
+		}
+
+		template <class TTask>
+		static void discardOf(void *storage) {
+			static_cast<TTask *>(storage)->~TTask();
+		}
+	};
+
+} // namespace chip8
+
+#endif // CHIP8_EXECUTOR_
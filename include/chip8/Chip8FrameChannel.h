@@ -0,0 +1,124 @@
+#pragma once
+
+#ifndef CHIP8_FRAME_CHANNEL_
+#define CHIP8_FRAME_CHANNEL_
+
+#include "Chip8Base.h"
+#include "Chip8Display.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace chip8 {
+
+	// Display, which hands frames from the thread drawing them (producer) over to another
+	// one showing them (consumer). It keeps three planes: the producer draws into its own,
+	// the consumer reads its own, and publish() and acquire() swap theirs with the one in
+	// the middle. Consumer gets the latest frame published, frames it was late for are
+	// skipped. Neither side waits for the other.
+	//
+	// Each frame knows the lines, which differ from the other planes, so that the plane
+	// the producer gets back is brought up to date by copying just these lines, and the
+	// consumer updates just the lines changed since the frame it acquired before.
+	class FrameChannel : public DisplayBase {
+	public:
+
+		FrameChannel(byte width = DefaultDisplay::FRAME_WIDTH, byte height = DefaultDisplay::FRAME_HEIGHT);
+
+		virtual ~FrameChannel();
+
+
+		word area() const final {
+			return a;
+		}
+		byte width() const final {
+			return w;
+		}
+		byte height() const final {
+			return h;
+		}
+
+
+		void clear() final;
+
+		bool xorLine(byte index, byte offset, byte bits) final {
+			linesDrawn |= uint64_t(1) << index;
+
+			return xorPixels(drawing + index * w, w, offset, bits);
+		}
+
+		// The frame being drawn.
+		void unpack(byte *frame) const final;
+
+		void load(const byte *frame) final;
+
+
+		// Producer: hand the frame drawn over, drawing goes on over a copy of it.
+		void publish();
+
+		// Lines copied by publish() so far.
+		clock getLinesCopied() const {
+			return linesCopied;
+		}
+
+
+		// Consumer: take the latest frame published. Returns false and keeps the frame held,
+		// if nothing is published since. Frames start blank, with sequence 0.
+		bool acquire();
+
+		const byte *getFrame() const {
+			return planes[front].buffer;
+		}
+
+		// Frames are numbered by publish() from 1 on.
+		uint64_t getFrameSequence() const {
+			return planes[front].sequence;
+		}
+
+		// Line N of the frame held differs from the frame held before, if bit N is set.
+		uint64_t getChangedLines() const {
+			return linesChanged;
+		}
+
+	private:
+
+		FrameChannel(const FrameChannel &);
+
+
+		enum : unsigned {
+			PLANES_COUNT	= 3,
+
+			PLANE_INDEX		= 0x3,
+			PLANE_FRESH		= 0x4								// Plane in the middle is not acquired yet.
+		};
+
+		struct Plane {
+			byte *buffer;
+			uint64_t sequence;
+			uint64_t linesSince[PLANES_COUNT];					// Lines differing from each plane, as of publish().
+		};
+
+		byte w, h;
+		word a;
+
+		byte *buffer;
+		Plane planes[PLANES_COUNT];
+
+		// Producer side.
+		unsigned back;
+		byte *drawing;
+		uint64_t sequence;
+		uint64_t linesDrawn;								// Since the last publish().
+		uint64_t linesPending[PLANES_COUNT];				// Lines a plane misses of the latest frame.
+		clock linesCopied;
+
+		alignas(64) std::atomic<unsigned> middle;
+
+		// Consumer side.
+		alignas(64) unsigned front;
+		uint64_t linesChanged;
+	};
+
+} // namespace chip8
+
+#endif // CHIP8_FRAME_CHANNEL_
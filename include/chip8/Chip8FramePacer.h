@@ -0,0 +1,88 @@
+#pragma once
+
+#ifndef CHIP8_FRAME_PACER_
+#define CHIP8_FRAME_PACER_
+
+#include "Chip8Base.h"
+
+#include <chrono>
+#include <functional>
+
+namespace chip8 {
+
+	// Paces frames at a fixed rate without holding a core busy: the thread sleeps until
+	// shortly before each deadline and spins only for the rest. The spin margin follows
+	// how much sleeps overshoot. Deadlines are counted from the start of the schedule,
+	// not from the previous frame, so a late frame is made up by the next ones and the
+	// rate is exact in the long run.
+	class FramePacer {
+	public:
+
+		typedef std::chrono::steady_clock Clock;
+
+		// Sleeps up to the time given. Returns true, if woken up before it for something
+		// else to do, as Executor::waitUntil() does.
+		typedef std::function<bool (Clock::time_point)> Sleeper;
+
+		// Reads the current time, Clock::now() unless given otherwise.
+		typedef std::function<Clock::time_point ()> TimeSource;
+
+		enum : unsigned {
+			RATE_DEFAULT	= 60,								// Frames per second.
+			LAG_MAX			= 4									// Frames behind, the schedule is started over past.
+		};
+
+		struct Stats {
+			clock frames;
+			clock late;										// Frames, which were due already as wait() was called.
+			clock restarts;									// Schedule restarts, as frames fell LAG_MAX behind.
+
+			Clock::duration jitterTotal;					// Time frames started past their deadlines.
+			Clock::duration jitterMax;
+
+			Clock::duration slept;
+			Clock::duration spun;
+		};
+
+		explicit FramePacer(unsigned rate = RATE_DEFAULT, TimeSource timeSource = &Clock::now);
+
+
+		// Start the schedule over, the next frame is due now.
+		void restart();
+
+		// Wait for the next frame deadline. Returns false, if the sleeper is woken up
+		// before it, the deadline stays for the next call then. The default sleeper
+		// sleeps the thread, so it goes with the default time source only.
+		bool wait();
+		bool wait(const Sleeper &sleeper);
+
+		const Stats &getStats() const {
+			return stats;
+		}
+
+		Clock::duration getSpinMargin() const {
+			return margin;
+		}
+
+	private:
+
+		const unsigned rate;
+		const Clock::duration period;
+		const TimeSource timeSource;
+
+		Clock::time_point origin;
+		clock frame;										// Frames since origin.
+
+		Clock::duration margin;
+		double oversleepMean;								// Nanoseconds.
+		double oversleepDeviation;
+
+		Stats stats;
+
+		Clock::time_point deadline() const;
+		void calibrate(Clock::duration oversleep);
+	};
+
+} // namespace chip8
+
+#endif // CHIP8_FRAME_PACER_
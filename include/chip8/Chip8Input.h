@@ -0,0 +1,218 @@
+#pragma once
+
+#ifndef CHIP8_INPUT_
+#define CHIP8_INPUT_
+
+#include "Chip8Base.h"
+#include "Chip8Interpreter.h"
+#include "Chip8Keyboard.h"
+#include "Chip8Scheduler.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace chip8 {
+
+	// Keys held over a run as the interpreter saw them, stamped with the machine cycle
+	// of each change, along with the seed and quirks the run is reset with. A run is
+	// played back from it exactly, see InputReplay.
+	class InputLog {
+	public:
+
+		struct Entry {
+			clock timestamp;								// Cycle the keys are held from.
+			PadKeys keys;
+		};
+
+		InputLog();
+
+
+		// Start over for a run reset with the seed and quirks given.
+		void clear(word seed, unsigned quirks);
+
+		// Keys held from the cycle given on. Entries past it are dropped first, so that
+		// a run stepped back (see Rewind) is logged over. Nothing is added, if the keys
+		// are held already.
+		void record(clock timestamp, PadKeys keys);
+
+		// Keys held since the last entry.
+		PadKeys getKeys() const {
+			return entries.empty() ? KEY_NONE : entries.back().keys;
+		}
+
+		const std::vector<Entry> &getEntries() const {
+			return entries;
+		}
+
+		word getSeed() const {
+			return seed;
+		}
+
+		unsigned getQuirks() const {
+			return quirks;
+		}
+
+		// Length of the run, set once it's over. Zero, if unknown.
+		clock getCycles() const {
+			return cycles;
+		}
+		void setCycles(clock cycles) {
+			this->cycles = cycles;
+		}
+
+
+		// Text lines: a header of "C8IN <version>", "seed", "quirks" and "cycles"
+		// lines, then a "<cycle> <keys>" line per entry, keys as a hex mask.
+		bool write(std::ostream &stream) const;
+
+		// Returns false and leaves the log intact, if the stream is not a log.
+		bool read(std::istream &stream);
+
+	private:
+
+		enum : unsigned {
+			VERSION = 1
+		};
+
+		std::vector<Entry> entries;							// Timestamp order, no two hold the same keys in a row.
+
+		word seed;
+		unsigned quirks;
+		clock cycles;
+	};
+
+
+	// Key pad device, which logs the keys of the key pad it wraps each time they are
+	// polled and differ from the ones logged last. Changes are stamped with the cycles
+	// count of the interpreter bound.
+	template <class TKeyPad>
+	class RecordingKeyPad final : public IKeyPad {
+	public:
+
+		RecordingKeyPad(const TKeyPad *keyPad, InputLog *log)
+			: keyPad(keyPad), log(log), source(nullptr), cycles(nullptr) {
+
+			/* Nothing to do */
+		}
+
+		template <class TInterpreter>
+		void bind(const TInterpreter *interpreter) {
+			source = interpreter;
+			cycles = &cyclesOf<TInterpreter>;
+		}
+
+		PadKeys getState() const final {
+			const PadKeys keys = keyPad->getState();
+
+			if (!!source) {
+				const clock timestamp = cycles(source);
+
+				// Cycles go back, if the run is stepped back.
+				if (keys != log->getKeys()
+					|| (!log->getEntries().empty() && timestamp < log->getEntries().back().timestamp)) {
+
+					log->record(timestamp, keys);
+				}
+			}
+			return keys;
+		}
+
+	private:
+
+		const TKeyPad *keyPad;
+		InputLog *log;
+
+		const void *source;
+		clock (*cycles) (const void *);
+
+		template <class TInterpreter>
+		static clock cyclesOf(const void *interpreter) {
+			return static_cast<const TInterpreter *>(interpreter)->getCyclesCount();
+		}
+	};
+
+
+	// Plays a log back, keys go down and up at the cycles they were logged at, however
+	// the interpreter is run. Entries are fed to it as scheduled keys (see
+	// BasicInterpreter::scheduleKeys), a window at a time. Nothing paces the run,
+	// it goes as fast as the interpreter does.
+	class InputReplay {
+	public:
+
+		explicit InputReplay(const InputLog &log)
+			: log(log), next(0), fired(0) {
+
+			/* Nothing to do */
+		}
+
+		// Apply the seed and quirks of the log, for the reset to follow.
+		template <class TInterpreter>
+		void prepare(TInterpreter &interpreter) {
+			interpreter.setQuirks(log.getQuirks());
+			interpreter.setSeed(log.getSeed());
+
+			next = fired = 0;
+		}
+
+		// The same as BasicInterpreter::run(), with the log keys held.
+		template <class TInterpreter>
+		InterpreterBase::RunStatus run(TInterpreter &interpreter, clock cycleBudget,
+			unsigned stopConditions = InterpreterBase::INTERPRETER_STOP_NONE) {
+
+			const std::vector<InputLog::Entry> &entries = log.getEntries();
+			InterpreterBase::RunStatus status = { 0, InterpreterBase::INTERPRETER_STOP_NONE };
+
+			while (status.cycles < cycleBudget && interpreter.isOk()) {
+				const clock cycles = interpreter.getCyclesCount();
+
+				while (fired < next && entries[fired].timestamp <= cycles) {
+					++fired;
+				}
+				while (next < entries.size() && next - fired < KEYS_IN_FLIGHT
+					&& interpreter.scheduleKeys(entries[next].timestamp, entries[next].keys)) {
+
+					++next;
+				}
+
+				// Runs stop where the first entry not scheduled yet is due.
+				clock budget = cycleBudget - status.cycles;
+				if (next < entries.size() && entries[next].timestamp > cycles) {
+					budget = std::min<clock>(budget, entries[next].timestamp - cycles);
+				}
+				const InterpreterBase::RunStatus slice = interpreter.run(budget, stopConditions);
+
+				status.cycles += slice.cycles;
+				status.stoppedBy = slice.stoppedBy & ~InterpreterBase::INTERPRETER_STOP_BUDGET;
+
+				if (status.stoppedBy != InterpreterBase::INTERPRETER_STOP_NONE) {
+					break;
+				}
+			}
+			if (status.cycles >= cycleBudget) {
+				status.stoppedBy |= InterpreterBase::INTERPRETER_STOP_BUDGET;
+			}
+			return status;
+		}
+
+	private:
+
+		InputReplay(const InputReplay &);
+
+
+		// Keys scheduled ahead are limited, so that interpreter's own events always fit.
+		enum : size_t {
+			KEYS_IN_FLIGHT = Scheduler::CAPACITY / 2
+		};
+
+		const InputLog &log;
+
+		size_t next;										// The first entry not scheduled yet.
+		size_t fired;										// The first entry not fired yet.
+	};
+
+} // namespace chip8
+
+#endif // CHIP8_INPUT_
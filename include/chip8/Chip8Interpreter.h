@@ -6,12 +6,48 @@
 #include "Chip8Base.h"
 #include "Chip8Display.h"
 #include "Chip8Keyboard.h"
+#include "Chip8Profiler.h"
+#include "Chip8Recompiler.h"
+#include "Chip8Scheduler.h"
+#include "Chip8Trace.h"
 
+#include <cstdint>
 #include <istream>
+#include <ostream>
+
+// All the instructions known to interpreter. 0NNN and XXXX stand for 
+// unsupported machine routines and unknown opcodes respectively.
+#define CHIP8_INSTRUCTIONS(X)																	\
+	X(00E0) X(00EE) X(0NNN) X(1NNN) X(2NNN) X(3XNN) X(4XNN) X(5XY0) X(6XNN) X(7XNN)				\
+	X(8XY0) X(8XY1) X(8XY2) X(8XY3) X(8XY4) X(8XY5) X(8XY6) X(8XY7) X(8XYE) X(9XY0)				\
+	X(ANNN) X(BNNN) X(CXNN) X(DXYN) X(EX9E) X(EXA1) X(FX07) X(FX0A) X(FX15) X(FX18)				\
+	X(FX1E) X(FX29) X(FX33) X(FX55) X(FX65) X(XXXX)
+
+// Define CHIP8_COUNTERS=1 (the same for all the sources) to count executions
+// per instruction, see InterpreterBase::Counters. Counting compiles to nothing
+// otherwise, and the counters stay zero.
+#if !defined(CHIP8_COUNTERS)
+#define CHIP8_COUNTERS 0
+#endif // CHIP8_COUNTERS
+
+// Define CHIP8_TRACE=1 (the same for all the sources) to let instructions be
+// recorded, see BasicInterpreter::setTracer. It costs a check per instruction,
+// while no tracer is set.
+#if !defined(CHIP8_TRACE)
+#define CHIP8_TRACE 0
+#endif // CHIP8_TRACE
+
+// Define CHIP8_IDLE_SKIP=0 (the same for all the sources) to run idle loops
+// instruction by instruction. Otherwise runs skip over their passes up to the
+// next event, with the same cycles count, see BasicInterpreter::skipIdleLoop.
+#if !defined(CHIP8_IDLE_SKIP)
+#define CHIP8_IDLE_SKIP 1
+#endif // CHIP8_IDLE_SKIP
 
 namespace chip8 {
 
-	class Interpreter {
+	// Definitions, which don't depend on devices interpreter works with.
+	class InterpreterBase {
 	public:
 
 		static byte font[0x50];
@@ -43,16 +79,249 @@ namespace chip8 {
 			INTERPRETER_ERROR_UNEXPECTED
 		};
 
-		
-		Interpreter(
-			IDisplay *display,
-			IKeyPad *keyPad,
+		// Conditions run() stops on. Budget and error ones are always on.
+		enum StopCondition : unsigned {
+			INTERPRETER_STOP_NONE		= 0x00,
+
+			INTERPRETER_STOP_BUDGET		= 0x01,				// Cycles budget is used up.
+			INTERPRETER_STOP_DISPLAY	= 0x02,				// Display got invalidated.
+			INTERPRETER_STOP_SOUND		= 0x04,				// Sound started or stopped playing.
+			INTERPRETER_STOP_KEY_AWAIT	= 0x08,				// Program started to wait for a key hit.
+			INTERPRETER_STOP_ERROR		= 0x10				// Interpretation failed, see getLastError().
+		};
+
+		struct RunStatus {
+			clock cycles;									// Cycles taken.
+			unsigned stoppedBy;								// StopCondition flags fired.
+		};
+
+		// Behavior differences among the interpreters programs were written for.
+		// No quirks stand for COSMAC VIP, except that VF is kept on logic ops.
+		enum Quirk : unsigned {
+			QUIRK_NONE				= 0x00,
+
+			QUIRK_SHIFT_VX			= 0x01,				// 8XY6/8XYE shift VX in place, VY is ignored.
+			QUIRK_LOAD_STORE_KEEP_I	= 0x02,				// FX55/FX65 leave index register unchanged.
+			QUIRK_JUMP_VX			= 0x04,				// BXNN jumps to XNN + VX, instead of NNN + V0.
+			QUIRK_SPRITE_WRAP		= 0x08,				// Sprites wrap around screen edges, instead of being clipped.
+			QUIRK_LOGIC_VF_RESET	= 0x10,				// 8XY1/8XY2/8XY3 reset VF.
+
+			QUIRKS_COUNT			= 0x20				// Count of quirk combinations.
+		};
+
+		enum : uint32_t {
+			STATE_MAGIC				= 0x53533843,		// "C8SS"
+			STATE_VERSION			= 0x0002
+		};
+
+		// Machine state as saved by saveState(). The layout is fixed (in host byte
+		// order), so that a state is restored by a few plain copies, straight from
+		// a memory mapped file as well. The header is followed by memory, display frame
+		// (a byte per pixel) and eventsCount events in the order they are due. Events go
+		// last, so that the other parts are found at the same place in all the states.
+		struct State {
+			uint32_t magic;
+			word version;
+			word quirks;									// Quirks handlers are specialized for.
+
+			uint32_t memorySize;
+			byte frameWidth;
+			byte frameHeight;
+			word eventsCount;
+
+			clock countCycles;
+
+			word pc;
+			word index;
+			word sp;
+			word kb;
+			word rndSeed;
+			word keysScheduled;
+
+			byte keyHaltRegister;							// STATE_KEY_HALT_UNSET, if no key is awaited.
+			byte lastError;
+			byte timers[2];
+
+			byte registers[REGISTERS_COUNT];
+			word stack[STACK_DEPTH];
+		};
+
+		static_assert(sizeof(State) == 120, "State layout must not depend on compiler");
+
+		enum : byte {
+			STATE_KEY_HALT_UNSET	= 0xFF
+		};
+
+		// Timer ids, State::timers go in this order.
+		enum : size_t {
+			TIMER_DELAY = 0,
+			TIMER_SOUND = 1
+		};
+
+		// Types of the events a state holds.
+		enum : byte {
+			EVENT_TIMER_TICK = 0,
+			EVENT_TIMER_SET,								// Target is timer id.
+			EVENT_KEYS										// Value is PadKeys to hold.
+		};
+
+		// Event slots scheduled keys leave free for the machine's own events: the timer
+		// tick and a timer set, which is due before the instruction setting it is over.
+		enum : size_t {
+			EVENTS_RESERVED = 2
+		};
+
+		// Error constant name without the prefix, e.g. "STACK_OVERFLOW".
+		static const char *errorName(Error error);
+
+
+	protected:
+
+		// State header is followed by memory, frame and events, see State.
+		static size_t stateOffsetMemory() {
+			return sizeof(State);
+		}
+		static size_t stateOffsetFrame(size_t memorySize) {
+			return stateOffsetMemory() + memorySize;
+		}
+		static size_t stateOffsetEvents(size_t memorySize, size_t frameSize) {
+			return (stateOffsetFrame(memorySize) + frameSize + alignof(Scheduler::Event) - 1) & ~(alignof(Scheduler::Event) - 1);
+		}
+		static size_t stateSize(size_t eventsCount, size_t memorySize, size_t frameSize) {
+			return stateOffsetEvents(memorySize, frameSize) + eventsCount * sizeof(Scheduler::Event);
+		}
+
+		// Events of a state are dispatched as they are, so the ones which don't
+		// make sense (e.g. setting a timer, which is not there) are refused.
+		static bool isStateEvent(const Scheduler::Event &event) {
+			return event.kind == EVENT_TIMER_TICK || event.kind == EVENT_KEYS
+				|| (event.kind == EVENT_TIMER_SET && event.target <= TIMER_SOUND);
+		}
+
+
+		// ========================================================
+		// operation code decoder
+		//
+		// It follows the next idea:
+		// all the operations are gathered within so-called
+		// clusters. This allows to avoid switch-based branching.
+		//
+		// Each opcode is decoded only once, on its first execution:
+		// the cluster decoder turns it into an Instruction record
+		// (handler code + pre-extracted operands), which is stored
+		// in the cache slot of the address the opcode resides at.
+		// Memory writes drop the slots they hit, so self-modifying
+		// programs get re-decoded.
+		// ========================================================
+
+		struct Opcode {
+			byte hi;
+			byte lo;
+		};
+
+		enum : byte {
+			INSTRUCTION_NONE = 0,							// Slot is not decoded yet.
+
+#define CHIP8_INSTRUCTION_CODE(id) INSTRUCTION_##id,
+			CHIP8_INSTRUCTIONS(CHIP8_INSTRUCTION_CODE)
+#undef CHIP8_INSTRUCTION_CODE
+
+			INSTRUCTIONS_COUNT
+		};
+
+		struct Instruction {
+			byte code;										// One of INSTRUCTION_* values.
+			byte x;											// VX register index.
+			byte y;											// VY register index.
+			word value;										// N, NN or NNN operand (instruction specific).
+		};
+
+		static void decode0(const Opcode &opcode, Instruction &instruction); static void decode1(const Opcode &opcode, Instruction &instruction);
+		static void decode2(const Opcode &opcode, Instruction &instruction); static void decode3(const Opcode &opcode, Instruction &instruction);
+		static void decode4(const Opcode &opcode, Instruction &instruction); static void decode5(const Opcode &opcode, Instruction &instruction);
+		static void decode6(const Opcode &opcode, Instruction &instruction); static void decode7(const Opcode &opcode, Instruction &instruction);
+		static void decode8(const Opcode &opcode, Instruction &instruction); static void decode9(const Opcode &opcode, Instruction &instruction);
+		static void decodeA(const Opcode &opcode, Instruction &instruction); static void decodeB(const Opcode &opcode, Instruction &instruction);
+		static void decodeC(const Opcode &opcode, Instruction &instruction); static void decodeD(const Opcode &opcode, Instruction &instruction);
+		static void decodeE(const Opcode &opcode, Instruction &instruction); static void decodeF(const Opcode &opcode, Instruction &instruction);
+
+		static void (*const macroCodesLUT[0x10]) (const Opcode &, Instruction &);
+
+		static void decode(const Opcode &opcode, Instruction &instruction);
+
+
+		// What an instruction changes, as its trace record shows, by instruction code.
+		enum : byte {
+			TRACE_TARGET_NONE = 0,
+			TRACE_TARGET_VX,
+			TRACE_TARGET_VX_CARRY,							// VF is set as a flag along with VX.
+			TRACE_TARGET_VF,
+			TRACE_TARGET_INDEX
+		};
+
+		static const byte traceTargets[INSTRUCTIONS_COUNT];
+
+
+	public:
+
+		// ========================================================
+		// execution counters
+		// ========================================================
+
+		enum : size_t {
+			COUNTERS_SLOTS = INSTRUCTIONS_COUNT				// Slots go by instruction code, see instructionName().
+		};
+
+		struct Counters {
+			clock executions[COUNTERS_SLOTS];
+			clock cycles[COUNTERS_SLOTS];
+
+			clock spriteRows;								// Sprite rows drawn (clipped ones are not).
+			clock collisions;								// Sprites drawn over lit pixels.
+			clock keyWaitCycles;							// Cycles spent halted by FX0A.
+			clock timerWrites;								// Timer values set by FX15/FX18.
+
+			clock recompiledInstructions;					// Instructions run as native code blocks,
+			clock recompiledCycles;							// which aren't counted per slot.
+
+			clock idleCycles;								// Cycles of idle loop passes skipped, they're counted per slot.
+		};
+
+		// Opcode pattern of a slot, e.g. "8XY4", or nullptr for the empty one.
+		static const char *instructionName(size_t slot);
+
+		// Per cluster (the first opcode digit) and per slot, only non-zero ones are listed.
+		static void writeCounters(std::ostream &stream, const Counters &counters);
+		static void writeCountersJSON(std::ostream &stream, const Counters &counters);
+	};
+
+	// Memory and stack access policies.
+	//
+	// CheckedAccess validates each access on its own and stores the result
+	// to the last error, even if it is OK. FastAccess validates the whole
+	// range a multi-byte instruction (FX33, FX55, FX65, DXYN) works with
+	// upfront, and touches the last error only when a check fails.
+	// Errors reported for valid and faulty programs are the same.
+	struct CheckedAccess {
+		enum : bool { CHECK_EACH = true };
+	};
+	struct FastAccess {
+		enum : bool { CHECK_EACH = false };
+	};
+
+	template <class TDisplay, class TKeyPad, class TAccess = CheckedAccess>
+	class BasicInterpreter : public InterpreterBase {
+	public:
+
+		BasicInterpreter(
+			TDisplay *display,
+			TKeyPad *keyPad,
 
 			word aluProfile = ALU_PROFILE_MODERN, 
 			size_t memorySize = ADDRESS_SPACE_DEFAULT
 			);
 
-		~Interpreter();
+		~BasicInterpreter();
 
 
 		Error getLastError() const {
@@ -63,8 +332,69 @@ namespace chip8 {
 			return countCycles;
 		}
 
+		// Instructions executed since reset(), not a part of the state.
+		clock getInstructionsCount() const {
+			return countInstructions;
+		}
+
+		// Counters snapshot, they go on counting from zero after resetCounters().
+		// Counters aren't reset along with the machine.
+		Counters getCounters() const;
+		void resetCounters();
+
 		clock doCycle();
-		void refreshTimers();
+		clock doCycles(clock cyclesMin);
+
+		// Run until cycleBudget is used up or any of stopConditions fires.
+		// Key pad is sampled once per call, unlike doCycles() which does it
+		// per instruction and per key await pass.
+		//
+		// While a key is awaited (FX0A), the machine is parked: time goes on in
+		// passes of 9 cycles, but keys are sampled only on the first pass of a call
+		// and on the pass after an event (a timer tick, keys pushed or scheduled).
+		// Passes in between change nothing, so they take no host time.
+		RunStatus run(clock cycleBudget, unsigned stopConditions = INTERPRETER_STOP_NONE);
+
+		// Hold keys down from the cycle given on, along with the key pad
+		// device ones, or from now on, if the cycle is past. Pass KEY_NONE
+		// to release them. Returns false, if too many events are scheduled already,
+		// EVENTS_RESERVED slots are kept for the machine's own ones.
+		bool scheduleKeys(clock timestamp, PadKeys keys);
+
+		// Hold keys down from now on, in place of the ones pushed or scheduled
+		// before. Hosts, which get key pad changes as events, push them here
+		// instead of polling a device. A parked machine takes them on its next pass.
+		void pushKeys(PadKeys keys);
+
+		// Sample the program into profiler each its interval of machine cycles
+		// from now on, pass nullptr to stop. Samples cost nothing in between.
+		// Profiler is not owned, it is to outlive sampling.
+		void setProfiler(Profiler *profiler);
+
+		// Record each instruction executed into tracer, which is to be open, pass
+		// nullptr to stop. Native code blocks aren't run while tracing. Returns false,
+		// if tracing is not built in (see CHIP8_TRACE).
+		bool setTracer(TraceRecorder *tracer);
+
+		// Quirks take effect on the next reset(), so that handlers specialized
+		// for them are picked once per program. ALU profile passed to constructor
+		// is the same as QUIRK_SHIFT_VX on (modern) or off (original).
+		void setQuirks(unsigned quirks);
+
+		unsigned getQuirks() const {
+			return quirks;
+		}
+
+		// Random generator seed, kept over reset(). It defaults to a per-instance
+		// value, set it to get the same CXNN results from run to run.
+		void setSeed(word seed) {
+			rndSeed = seed;
+		}
+
+		// Let doCycles() run native code translated from the program,
+		// where it is possible. Returns true, if translation is on, false
+		// if it's off or memory for native code can't be had.
+		bool enableRecompiler(bool enable);
 
 		template <size_t prgLen>
 		void reset(const byte(&prg)[prgLen]) {
@@ -75,6 +405,20 @@ namespace chip8 {
 		void reset();
 
 
+		// Size of the buffer the current state takes, see State.
+		size_t getStateSize() const;
+
+		// Both return false, if the buffer is too small. A state is loaded only if
+		// it's saved by an interpreter with the same memory and display sizes,
+		// otherwise the interpreter is left intact. The buffer is to be aligned
+		// as State is.
+		bool saveState(void *buffer, size_t size) const;
+		bool loadState(const void *buffer, size_t size);
+
+		bool saveState(std::ostream &stateStream) const;
+		bool loadState(std::istream &stateStream);
+
+
 		bool isPlayingSound() const {
 			return timers[TIMER_SOUND].value > 0;
 		}
@@ -95,39 +439,74 @@ namespace chip8 {
 
 	private:
 
-		Interpreter(const Interpreter&);
+		BasicInterpreter(const BasicInterpreter&);
 
 
-		IDisplay	*deviceDisplay;
-		IKeyPad		*deviceKeyPad;
+		TDisplay	*deviceDisplay;
+		TKeyPad		*deviceKeyPad;
 
 		Error lastError;
 
 
-		typedef void (Interpreter::*ALUFunc) (size_t, size_t);
-
-		ALUFunc shl;
-		ALUFunc shr;
+		unsigned quirks;									// Quirk flags to apply on reset.
+		unsigned quirksActive;								// Quirk flags handlers are specialized for.
 
 		void applyALUProfile(word aluProfile);
 
 
 		enum : size_t {
-			TIMER_DELAY = 0,
-			TIMER_SOUND = 1,
-
 			KEY_HALT_UNSET = size_t(-1),
 		};
 
 		struct countdown_timer {
-			clock timestamp;
-
 			byte value;
 		};
 
 		countdown_timer timers[2];
 
 		clock countCycles;
+		clock countInstructions;
+
+#if CHIP8_COUNTERS
+		Counters counters;
+#endif // CHIP8_COUNTERS
+
+#if CHIP8_TRACE
+		TraceRecorder *tracer;								// nullptr, if not tracing.
+		TraceRecorder::Record traceRecord;					// Instruction being executed.
+		byte traceTarget;
+		byte traceX;
+
+		inline void traceFetch(const Instruction &instruction);
+		inline void traceRetire(clock cycles);
+#endif // CHIP8_TRACE
+
+		// ========================================================
+		// cycle driven events
+		//
+		// Timers tick, timer registers get set, scheduled keys
+		// get pressed and profiler samples get taken once machine
+		// cycles count reaches the cycle an event is stamped with.
+		// The check is a single compare after each instruction,
+		// events are handled off it.
+		// ========================================================
+
+		Scheduler scheduler;
+		clock eventsNext;									// Timestamp of the earliest event scheduled.
+
+		word keysScheduled;									// Keys held by events, on top of key pad ones.
+
+		Profiler *profiler;									// Not a part of the state, so it's not queued with events.
+		clock sampleNext;									// Timestamp of the next sample, the farthest cycle possible if none.
+
+		clock nextEvent() const {
+			return sampleNext < scheduler.next() ? sampleNext : scheduler.next();
+		}
+		void takeSample();
+
+		inline PadKeys pollKeyPad() const;
+		void dispatchEvents();
+		void scheduleEvent(clock timestamp, byte kind, byte target, word value);
 
 		size_t sp;
 		size_t keyHaltRegister;
@@ -145,8 +524,31 @@ namespace chip8 {
 		const size_t memorySize;
 		byte *memory;
 
+		unsigned events;									// StopCondition flags fired since run() has started.
+		unsigned stopConditions;							// StopCondition flags run() stops on.
+		bool keyPadPolling;									// Sample key pad before each instruction.
+
+		// Not a StopCondition, execution stops on it to look for an idle loop.
+		enum : unsigned {
+			INTERPRETER_IDLE_LOOP = 0x100					// A jump went back to a loop, which may idle.
+		};
+
 		void resetImpl();
 		void onTimerTick(word timerId);
+		void onTimerSet(word timerId, byte value);
+
+		inline clock step();
+		clock execute(clock cyclesMin);
+
+		// Key await passes up to cyclesMax, see run(). Returns the cycles they take,
+		// along with the instructions run, once the key is hit.
+		clock awaitKey(clock cyclesMax);
+
+		// Programs idle in a jump to itself or in a delay timer wait "FX07 3X00 1NNN",
+		// until an event (a timer tick most often) changes anything. Passes of such
+		// a loop at pc are accounted at once, as if they were run, up to cyclesMax.
+		// Returns the cycles they take.
+		clock skipIdleLoop(clock cyclesMax);
 
 
 		// ========================================================
@@ -154,7 +556,8 @@ namespace chip8 {
 		// ========================================================
 
 		void jmp(word address);								// Jump straight to address specified.
-		void jmp0(word address);							// Jump to address + V0 location.
+		template <unsigned quirks>
+		void jmp0(word address);							// Jump to address + V0 (VX, see QUIRK_JUMP_VX) location.
 		void call(word address);							// Call a routine on address specified (current sp is placed on stack).
 		void ret();											// Return after routine call (retrieves a previously stored pc from stack).
 
@@ -168,7 +571,9 @@ namespace chip8 {
 		void movn(size_t idx, word value);					// Set VX to NN value.
 		void movy(size_t idx, size_t idy);					// Set VX to VY.
 		void movd(size_t idx);								// Set VX to delay timer value.
+		template <unsigned quirks>
 		void movrs(size_t idx);								// Store the memory values that start at I into registers V0 trough VX.
+		template <unsigned quirks>
 		void movms(size_t idx);								// Store the values of registerx V0 through VX within memory, starting at I.
 
 		void sti(word value);								// Store value to index register.
@@ -183,9 +588,9 @@ namespace chip8 {
 		void shr_original(size_t idx, size_t idy);			// Store VY shifted one bit right to VX, setting VF to least significant bit first. 
 		void shl_original(size_t idx, size_t idy);			// Store VY shifted one bit left to VX, setting VF to most significant bit first.
 
-		void or(size_t idx, size_t idy);					// VX = VX  or  VY.
-		void and(size_t idx, size_t idy);					// VX = VX  and VY.
-		void xor(size_t idx, size_t idy);					// VX = VX  xo  VY.
+		void bor(size_t idx, size_t idy);					// VX = VX  or  VY.
+		void band(size_t idx, size_t idy);					// VX = VX  and VY.
+		void bxor(size_t idx, size_t idy);					// VX = VX  xor VY.
 
 		void sym(size_t idx);								// Fetch an address of the sprite that corresponds to HEX digit, that is stored in VX.
 		void rnd(size_t idx, word value);					// Set VX to RND and NN value.
@@ -193,6 +598,7 @@ namespace chip8 {
 		size_t bcd(size_t idx);								// Store the value of register VX binary-decimal encoded within the memory located at [I, I + 1, I + 2].
 		
 		void cls();											// Clear screen.
+		template <unsigned quirks>
 		void sprite(size_t idx, size_t idy, word value);	// Display a sprite on screen.
 		void sound(size_t idx);								// Set value of sound timer.
 		void delay(size_t idx);								// Set value of delay timer.
@@ -209,28 +615,44 @@ namespace chip8 {
 
 
 		// ========================================================
-		// operation code decoder
-		//
-		// It follows the next idea:
-		// all the operations are gathered within so-called
-		// clusters. This allows to avoid switch-based branching.
+		// instructions execution (see InterpreterBase decoder)
 		// ========================================================
 
-		struct Opcode {
-			byte hi;
-			byte lo;
+		Instruction *instructionCache;						// One slot per each 2-byte aligned address.
+
+		inline const Instruction *fetch(Instruction &scratch);
+		inline void invalidateInstruction(size_t address);
+
+
+		// Every handler is compiled for each quirks combination, so that
+		// quirks are resolved at compile time rather than per instruction.
+#define CHIP8_INSTRUCTION_HANDLER(id) template <unsigned quirks> inline size_t op##id(const Instruction &instruction);
+		CHIP8_INSTRUCTIONS(CHIP8_INSTRUCTION_HANDLER)
+#undef CHIP8_INSTRUCTION_HANDLER
+
+		typedef size_t (BasicInterpreter::*InstructionHandler) (const Instruction &);
+
+		template <unsigned quirks>
+		struct InstructionsLUT {
+			static const InstructionHandler value[INSTRUCTIONS_COUNT];
 		};
 
-		inline size_t op0(const Opcode &opcode); inline size_t op1(const Opcode &opcode);
-		inline size_t op2(const Opcode &opcode); inline size_t op3(const Opcode &opcode);
-		inline size_t op4(const Opcode &opcode); inline size_t op5(const Opcode &opcode);
-		inline size_t op6(const Opcode &opcode); inline size_t op7(const Opcode &opcode);
-		inline size_t op8(const Opcode &opcode); inline size_t op9(const Opcode &opcode);
-		inline size_t opA(const Opcode &opcode); inline size_t opB(const Opcode &opcode);
-		inline size_t opC(const Opcode &opcode); inline size_t opD(const Opcode &opcode);
-		inline size_t opE(const Opcode &opcode); inline size_t opF(const Opcode &opcode);
+		static const InstructionHandler *const instructionsLUT[QUIRKS_COUNT];
+
+		const InstructionHandler *instructions;				// Handlers specialized for quirksActive.
+
+		template <unsigned quirks>
+		struct Dispatcher;									// Threaded code execution loop (see doCycles).
+
+		typedef clock (*DispatchFunc) (BasicInterpreter &, clock);
 
-		static size_t (Interpreter::*const macroCodesLUT[0x10]) (const Opcode &);
+		static const DispatchFunc dispatchersLUT[QUIRKS_COUNT];
+
+		DispatchFunc dispatch;								// Dispatcher specialized for quirksActive.
+
+#if CHIP8_RECOMPILER
+		Recompiler *recompiler;								// Native code blocks, nullptr if disabled.
+#endif // CHIP8_RECOMPILER
 
 
 		// ========================================================
@@ -242,10 +664,10 @@ namespace chip8 {
 
 		class Snapshot {
 
-			Interpreter *soc;
+			BasicInterpreter *soc;
 
 		public:
-			static Snapshot &obtain(Snapshot &snapshot, Interpreter &soc) {
+			static Snapshot &obtain(Snapshot &snapshot, BasicInterpreter &soc) {
 				snapshot.soc = &soc;
 
 				return snapshot;
@@ -293,6 +715,13 @@ namespace chip8 {
 		};
 #endif // _DEBUG
 	};
+
+	// Interpreter over any devices, which implement the interfaces.
+	// It is instantiated within the core library, see Chip8InterpreterImpl.h
+	// to instantiate BasicInterpreter over particular devices.
+	typedef BasicInterpreter<IDisplay, IKeyPad> Interpreter;
+
+	extern template class BasicInterpreter<IDisplay, IKeyPad>;
 } // namespace chip8
 
 #endif // CHIP8_INTERPRETER_
\ No newline at end of file
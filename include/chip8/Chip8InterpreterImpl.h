@@ -0,0 +1,1916 @@
+#pragma once
+
+#ifndef CHIP8_INTERPRETER_IMPL_
+#define CHIP8_INTERPRETER_IMPL_
+
+// BasicInterpreter members definition. It is only needed to instantiate
+// an interpreter over particular devices, as chip8::Interpreter is
+// instantiated by the core library already.
+
+#include "Chip8Interpreter.h"
+#include "Chip8Cycles.h"
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+
+namespace chip8 {
+
+#define INTERPRETER_TEMPLATE template <class TDisplay, class TKeyPad, class TAccess>
+#define INTERPRETER_CLASS BasicInterpreter<TDisplay, TKeyPad, TAccess>
+
+#define FONT_SYMBOL_HEIGHT 5
+
+	// Counting takes an increment or two, if counters are on, and nothing otherwise.
+#if CHIP8_COUNTERS
+#define COUNTERS_ADD(soc, counter, value) ((soc).counters.counter += (value))
+#define COUNTERS_INSTRUCTION(soc, code, taken) ((soc).counters.executions[code] += 1, (soc).counters.cycles[code] += (taken))
+#define COUNTERS_INSTRUCTION_PASSES(soc, code, passes, taken) ((soc).counters.executions[code] += (passes), (soc).counters.cycles[code] += (passes) * (taken))
+#else
+#define COUNTERS_ADD(soc, counter, value) ((void)0)
+#define COUNTERS_INSTRUCTION(soc, code, taken) ((void)0)
+#define COUNTERS_INSTRUCTION_PASSES(soc, code, passes, taken) ((void)0)
+#endif // CHIP8_COUNTERS
+
+	// Tracing takes a check per instruction, if it's built in, and nothing otherwise.
+	// An instruction is taken on fetch, before pc moves, and recorded once it's done.
+#if CHIP8_TRACE
+#define TRACE_ACTIVE(soc) (!!(soc).tracer)
+#define TRACE_FETCH(soc, instruction) (TRACE_ACTIVE(soc) ? (soc).traceFetch(instruction) : (void)0)
+#define TRACE_RETIRE(soc, cycles) (TRACE_ACTIVE(soc) ? (soc).traceRetire(cycles) : (void)0)
+#else
+#define TRACE_ACTIVE(soc) false
+#define TRACE_FETCH(soc, instruction) ((void)0)
+#define TRACE_RETIRE(soc, cycles) ((void)0)
+#endif // CHIP8_TRACE
+
+	INTERPRETER_TEMPLATE
+	INTERPRETER_CLASS::BasicInterpreter(TDisplay *display, TKeyPad *keyPad, 	
+		word aluProfile, size_t memorySize)
+
+		: memorySize(memorySize), carry(registers[REGISTERS_COUNT - 1]) {
+
+		assert(aluProfile == ALU_PROFILE_MODERN 
+			|| aluProfile == ALU_PROFILE_ORIGINAL);
+		applyALUProfile(aluProfile);
+		quirksActive = quirks;
+
+		assert(display);
+		deviceDisplay = display;
+		assert(keyPad);
+		deviceKeyPad = keyPad;
+
+		assert(memorySize > 0);
+		memory = new byte[memorySize];
+		memset(memory, 0x00, memorySize);
+		memcpy(memory, font, sizeof(font));
+
+		instructionCache = new Instruction[(memorySize + 1) / 2];
+#if CHIP8_RECOMPILER
+		recompiler = nullptr;
+#endif // CHIP8_RECOMPILER
+
+		events = INTERPRETER_STOP_NONE;
+		stopConditions = INTERPRETER_STOP_NONE;
+		keyPadPolling = true;
+
+		rndSeed = word(reinterpret_cast<uintptr_t>(this));
+		profiler = nullptr;
+#if CHIP8_TRACE
+		tracer = nullptr;
+#endif // CHIP8_TRACE
+		resetCounters();
+		resetImpl();
+	}
+
+	INTERPRETER_TEMPLATE
+	INTERPRETER_CLASS::~BasicInterpreter() {
+#if CHIP8_RECOMPILER
+		delete recompiler;
+#endif // CHIP8_RECOMPILER
+		delete[] instructionCache;
+		delete[] memory;
+	}
+
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::reset(const byte *prg, size_t prgLen)
+	{
+		assert(prg);
+		resetImpl();
+
+		byte *clientMemory = memory + pc;
+		size_t countPadded = memorySize - pc;
+
+		if (prgLen > 0) {
+			lastError = INTERPRETER_ERROR_OK;
+
+			if (prgLen < sizeof(Opcode)) {
+				lastError = INTERPRETER_ERROR_PROGRAM_TOO_SMALL;
+			}
+			else if (prgLen > countPadded) {
+				lastError = INTERPRETER_ERROR_PROGRAM_TOO_LARGE;
+			}
+			if (isOk()) {
+				memcpy(clientMemory, prg, prgLen);
+
+				clientMemory += prgLen;
+				countPadded -= prgLen;
+			}
+		}
+		if (countPadded > 0) {
+			memset(clientMemory, 0x00, countPadded);
+		}
+		cls();
+	}
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::reset(std::istream &prgStream)
+	{
+		assert(prgStream);
+		resetImpl();
+
+		byte *clientMemory = memory + pc;
+		size_t countPadded = memorySize - pc;
+
+		prgStream.read(reinterpret_cast<char *>(clientMemory), countPadded);
+
+		auto prgLen = size_t(prgStream.gcount());
+
+		if (prgLen > 0) {
+			lastError = INTERPRETER_ERROR_OK;
+
+			if (prgLen < sizeof(Opcode)) {
+				lastError = INTERPRETER_ERROR_PROGRAM_TOO_SMALL;
+			}
+			else if (prgLen > countPadded) {
+				lastError = INTERPRETER_ERROR_PROGRAM_TOO_LARGE;
+			}
+			if (isOk()) {
+				clientMemory += prgLen;
+				countPadded -= prgLen;
+			}
+		}
+		if (countPadded > 0) {
+			memset(clientMemory, 0x00, countPadded);
+		}
+		cls();
+	}
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::reset() {
+		if (isOk()) {
+			resetImpl();
+
+			lastError = INTERPRETER_ERROR_OK;
+		}
+		cls();
+	}
+
+	// ========================================================
+	// state saving
+	// ========================================================
+
+	INTERPRETER_TEMPLATE
+	size_t INTERPRETER_CLASS::getStateSize() const {
+		return stateSize(scheduler.size(), memorySize, deviceDisplay->area());
+	}
+
+	INTERPRETER_TEMPLATE
+	bool INTERPRETER_CLASS::saveState(void *buffer, size_t size) const {
+		assert(buffer);
+		if (size < getStateSize()) {
+			return false;
+		}
+		byte *data = static_cast<byte *>(buffer);
+		State &state = *reinterpret_cast<State *>(data);
+
+		state.magic = STATE_MAGIC;
+		state.version = STATE_VERSION;
+		state.quirks = word(quirksActive);
+
+		state.memorySize = uint32_t(memorySize);
+		state.frameWidth = deviceDisplay->width();
+		state.frameHeight = deviceDisplay->height();
+		state.eventsCount = word(scheduler.save(reinterpret_cast<Scheduler::Event *>(data + stateOffsetEvents(memorySize, deviceDisplay->area()))));
+
+		state.countCycles = countCycles;
+
+		state.pc = pc;
+		state.index = index;
+		state.sp = word(sp);
+		state.kb = kb;
+		state.rndSeed = rndSeed;
+		state.keysScheduled = keysScheduled;
+
+		state.keyHaltRegister = isKeyAwaited() ? byte(keyHaltRegister) : byte(STATE_KEY_HALT_UNSET);
+		state.lastError = byte(lastError);
+		state.timers[TIMER_DELAY] = timers[TIMER_DELAY].value;
+		state.timers[TIMER_SOUND] = timers[TIMER_SOUND].value;
+
+		memcpy(state.registers, registers, sizeof(registers));
+		memcpy(state.stack, stack, sizeof(stack));
+
+		memcpy(data + stateOffsetMemory(), memory, memorySize);
+		deviceDisplay->unpack(data + stateOffsetFrame(memorySize));
+
+		return true;
+	}
+
+	INTERPRETER_TEMPLATE
+	bool INTERPRETER_CLASS::loadState(const void *buffer, size_t size) {
+		assert(buffer);
+		if (size < sizeof(State)) {
+			return false;
+		}
+		const byte *data = static_cast<const byte *>(buffer);
+		const State &state = *reinterpret_cast<const State *>(data);
+
+		if (state.magic != STATE_MAGIC || state.version != STATE_VERSION
+			|| state.memorySize != memorySize
+			|| state.frameWidth != deviceDisplay->width() || state.frameHeight != deviceDisplay->height()
+			|| size < stateSize(state.eventsCount, state.memorySize, deviceDisplay->area())) {
+
+			return false;
+		}
+		if (state.quirks >= QUIRKS_COUNT || state.sp > STACK_DEPTH
+			|| (state.keyHaltRegister != STATE_KEY_HALT_UNSET && state.keyHaltRegister >= REGISTERS_COUNT)
+			|| state.lastError > INTERPRETER_ERROR_UNEXPECTED) {
+
+			return false;
+		}
+		if (!scheduler.load(reinterpret_cast<const Scheduler::Event *>(data + stateOffsetEvents(memorySize, deviceDisplay->area())), state.eventsCount, &isStateEvent)) {
+			return false;
+		}
+		sampleNext = !!profiler ? state.countCycles + profiler->getInterval() : clock(-1);
+		eventsNext = nextEvent();
+
+		quirks = quirksActive = state.quirks;
+		instructions = instructionsLUT[quirksActive];
+		dispatch = dispatchersLUT[quirksActive];
+
+		countCycles = state.countCycles;
+
+		pc = state.pc;
+		index = state.index;
+		sp = state.sp;
+		kb = state.kb;
+		rndSeed = state.rndSeed;
+		keysScheduled = state.keysScheduled;
+
+		keyHaltRegister = state.keyHaltRegister != STATE_KEY_HALT_UNSET ? size_t(state.keyHaltRegister) : size_t(KEY_HALT_UNSET);
+		lastError = Error(state.lastError);
+		timers[TIMER_DELAY].value = state.timers[TIMER_DELAY];
+		timers[TIMER_SOUND].value = state.timers[TIMER_SOUND];
+
+		memcpy(registers, state.registers, sizeof(registers));
+		memcpy(stack, state.stack, sizeof(stack));
+
+		memcpy(memory, data + stateOffsetMemory(), memorySize);
+		memset(instructionCache, INSTRUCTION_NONE, sizeof(Instruction) * ((memorySize + 1) / 2));
+#if CHIP8_RECOMPILER
+		if (!!recompiler) {
+			recompiler->flush(quirksActive);
+		}
+#endif // CHIP8_RECOMPILER
+
+		deviceDisplay->load(data + stateOffsetFrame(memorySize));
+		deviceDisplay->invalidate();
+
+		events = INTERPRETER_STOP_NONE;
+
+		return true;
+	}
+
+	INTERPRETER_TEMPLATE
+	bool INTERPRETER_CLASS::saveState(std::ostream &stateStream) const {
+		// Words of clock size keep the buffer aligned as State is.
+		std::vector<clock> buffer((getStateSize() + sizeof(clock) - 1) / sizeof(clock));
+
+		if (!saveState(buffer.data(), buffer.size() * sizeof(clock))) {
+			return false;
+		}
+		stateStream.write(reinterpret_cast<const char *>(buffer.data()), getStateSize());
+
+		return !!stateStream;
+	}
+
+	INTERPRETER_TEMPLATE
+	bool INTERPRETER_CLASS::loadState(std::istream &stateStream) {
+		State header;
+
+		if (!stateStream.read(reinterpret_cast<char *>(&header), sizeof(header))
+			|| header.eventsCount > Scheduler::CAPACITY || header.memorySize != memorySize) {
+
+			return false;
+		}
+		const size_t size = stateSize(header.eventsCount, header.memorySize, deviceDisplay->area());
+
+		std::vector<clock> buffer((size + sizeof(clock) - 1) / sizeof(clock));
+		memcpy(buffer.data(), &header, sizeof(header));
+
+		char *rest = reinterpret_cast<char *>(buffer.data()) + sizeof(header);
+		if (!stateStream.read(rest, size - sizeof(header))) {
+			return false;
+		}
+		return loadState(buffer.data(), size);
+	}
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::resetImpl() {
+		memset(stack, 0x00, sizeof(stack));
+		memset(registers, 0x00, sizeof(registers));
+
+		timers[TIMER_DELAY].value = 0;
+		timers[TIMER_SOUND].value = 0;
+
+		countCycles = 0;
+		countInstructions = 0;
+
+		scheduler.clear();
+		sampleNext = !!profiler ? profiler->getInterval() : clock(-1);
+		scheduleEvent(COUNT_CYCLES_TIMER_TICK, EVENT_TIMER_TICK, 0, 0);
+		keysScheduled = KEY_NONE;
+
+		sp = STACK_DEPTH;
+		keyHaltRegister = KEY_HALT_UNSET;
+
+		carry = 0;
+		index = 0;
+		pc = OFFSET_PROGRAM_START;
+		kb = KEY_NONE;
+
+		quirksActive = quirks;
+		instructions = instructionsLUT[quirksActive];
+		dispatch = dispatchersLUT[quirksActive];
+
+		memset(instructionCache, INSTRUCTION_NONE, sizeof(Instruction) * ((memorySize + 1) / 2));
+#if CHIP8_RECOMPILER
+		if (!!recompiler) {
+			recompiler->flush(quirksActive);
+		}
+#endif // CHIP8_RECOMPILER
+
+		lastError = INTERPRETER_ERROR_NO_PROGRAM;
+	}
+
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::applyALUProfile(word aluProfile) {
+		switch (aluProfile) {
+		case ALU_PROFILE_MODERN:
+			quirks = QUIRK_SHIFT_VX;
+			break;
+
+		case ALU_PROFILE_ORIGINAL:
+			quirks = QUIRK_NONE;
+			break;
+		}
+	}
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::setQuirks(unsigned quirks) {
+		assert(quirks < QUIRKS_COUNT);
+		this->quirks = quirks & (QUIRKS_COUNT - 1);
+	}
+
+
+	INTERPRETER_TEMPLATE
+	typename INTERPRETER_CLASS::Counters INTERPRETER_CLASS::getCounters() const {
+#if CHIP8_COUNTERS
+		return counters;
+#else
+		Counters result;
+		memset(&result, 0x00, sizeof(result));
+
+		return result;
+#endif // CHIP8_COUNTERS
+	}
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::resetCounters() {
+#if CHIP8_COUNTERS
+		memset(&counters, 0x00, sizeof(counters));
+#endif // CHIP8_COUNTERS
+	}
+
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::onTimerTick(word timerId) {
+		countdown_timer &timer = timers[timerId];
+
+		if (timer.value > 0) {
+			timer.value--;
+
+			if (timerId == TIMER_SOUND && timer.value == 0) {
+				events |= INTERPRETER_STOP_SOUND;
+			}
+		}
+	}
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::onTimerSet(word timerId, byte value) {
+		countdown_timer &timer = timers[timerId];
+
+		COUNTERS_ADD(*this, timerWrites, 1);
+
+		if (timerId == TIMER_SOUND) {
+			// Sound timer values below 2 are ignored by COSMAC VIP.
+			value = value > 1 ? value : 0;
+
+			if ((timer.value > 0) != (value > 0)) {
+				events |= INTERPRETER_STOP_SOUND;
+			}
+		}
+		timer.value = value;
+	}
+
+
+	INTERPRETER_TEMPLATE
+	bool INTERPRETER_CLASS::scheduleKeys(clock timestamp, PadKeys keys) {
+		// Keys due already are held from now on, so that keys scheduled at a run
+		// boundary are seen by its first instruction, as key pad ones are.
+		if (timestamp <= countCycles) {
+			pushKeys(keys);
+
+			return true;
+		}
+		Scheduler::Event event = { timestamp, EVENT_KEYS, 0, keys };
+
+		if (scheduler.size() + EVENTS_RESERVED >= Scheduler::CAPACITY || !scheduler.schedule(event)) {
+			return false;
+		}
+		eventsNext = nextEvent();
+
+		return true;
+	}
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::pushKeys(PadKeys keys) {
+		keysScheduled = keys;
+
+		// A key being awaited is detected against the previous sample,
+		// so the next pass takes the new one itself.
+		if (!isKeyAwaited()) {
+			kb = pollKeyPad();
+		}
+	}
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::setProfiler(Profiler *profiler) {
+		this->profiler = profiler;
+
+		sampleNext = !!profiler ? countCycles + profiler->getInterval() : clock(-1);
+		eventsNext = nextEvent();
+	}
+
+	INTERPRETER_TEMPLATE
+	bool INTERPRETER_CLASS::setTracer(TraceRecorder *tracer) {
+#if CHIP8_TRACE
+		assert(!tracer || tracer->isOpen());
+		this->tracer = tracer;
+
+		return true;
+#else
+		(void)tracer;
+
+		return false;
+#endif // CHIP8_TRACE
+	}
+
+#if CHIP8_TRACE
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::traceFetch(const Instruction &instruction) {
+		traceRecord.pc = pc;
+		traceRecord.opcode = word(memory[pc] << 8 | memory[pc + 1]);
+
+		traceTarget = traceTargets[instruction.code];
+		traceX = instruction.x;
+	}
+
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::traceRetire(clock cycles) {
+		traceRecord.cycle = uint32_t(cycles);
+		traceRecord.value = 0;
+		traceRecord.target = TraceRecorder::TARGET_NONE;
+		traceRecord.carry = TraceRecorder::CARRY_NONE;
+
+		switch (traceTarget) {
+		case TRACE_TARGET_VX_CARRY:
+			traceRecord.carry = carry;
+			// Fall through
+		case TRACE_TARGET_VX:
+			traceRecord.target = traceX;
+			traceRecord.value = registers[traceX];
+			break;
+
+		case TRACE_TARGET_VF:
+			traceRecord.target = REGISTERS_COUNT - 1;
+			traceRecord.value = carry;
+			break;
+
+		case TRACE_TARGET_INDEX:
+			traceRecord.target = TraceRecorder::TARGET_INDEX;
+			traceRecord.value = index;
+			break;
+		}
+		tracer->record(traceRecord);
+	}
+#endif // CHIP8_TRACE
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::scheduleEvent(clock timestamp, byte kind, byte target, word value) {
+		Scheduler::Event event = { timestamp, kind, target, value };
+
+		// Scheduled keys leave room for the few events of its own.
+		if (!scheduler.schedule(event)) {
+			assert(false);
+		}
+		eventsNext = nextEvent();
+	}
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::dispatchEvents() {
+		if (sampleNext <= countCycles) {
+			takeSample();
+		}
+		while (scheduler.next() <= countCycles) {
+			Scheduler::Event event = scheduler.pop();
+
+			switch (event.kind) {
+			case EVENT_TIMER_TICK:
+				onTimerTick(TIMER_DELAY);
+				onTimerTick(TIMER_SOUND);
+
+				event.timestamp += COUNT_CYCLES_TIMER_TICK;
+				scheduler.schedule(event);
+				break;
+
+			case EVENT_TIMER_SET:
+				onTimerSet(event.target, byte(event.value));
+				break;
+
+			case EVENT_KEYS:
+				pushKeys(PadKeys(event.value));
+				break;
+			}
+		}
+		eventsNext = nextEvent();
+	}
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::takeSample() {
+		const clock interval = profiler->getInterval();
+		// An instruction running over several intervals is sampled once,
+		// the sample stands for each of them.
+		const clock weight = (countCycles - sampleNext) / interval + 1;
+		const size_t top = std::min<size_t>(sp, STACK_DEPTH);
+
+		profiler->sample(pc, stack + top, STACK_DEPTH - top, memory, memorySize, weight);
+		sampleNext += weight * interval;
+	}
+
+	INTERPRETER_TEMPLATE
+	inline PadKeys INTERPRETER_CLASS::pollKeyPad() const {
+		return PadKeys(deviceKeyPad->getState() | keysScheduled);
+	}
+
+
+#define MODIFY_REGISTER_OP(idx, op, value)								\
+	{																	\
+		assert(0U <= (idx) && (idx) < REGISTERS_COUNT);	\
+		registers[idx] op (value);										\
+	}
+#define READ_REGISTER(idx)												\
+	(																	\
+		assert(0U <= (idx) && (idx) < REGISTERS_COUNT),	\
+		registers[idx]													\
+	)
+
+#define IN_RANGE_(idx, lower, higher) \
+	(lower <= (idx) && (idx) < higher)
+
+	// See CheckedAccess and FastAccess for the difference.
+#define MODIFY_ARRAY_OP_(arr, idx, op, value, lower, higher, errc)	\
+	(TAccess::CHECK_EACH												\
+		? (lastError = (!IN_RANGE_(idx, lower, higher) ? (errc) : INTERPRETER_ERROR_OK), arr[idx] op (value))	\
+		: (!IN_RANGE_(idx, lower, higher) ? (lastError = (errc), arr[lower]) : (arr[idx] op (value))))
+#define READ_ARRAY_(arr, idx, lower, higher, errc)					\
+	(TAccess::CHECK_EACH												\
+		? (lastError = (!IN_RANGE_(idx, lower, higher) ? (errc) : INTERPRETER_ERROR_OK), arr[idx])	\
+		: (!IN_RANGE_(idx, lower, higher) ? (lastError = (errc), arr[lower]) : arr[idx]))
+
+	// Multi-byte instructions validate the whole range they work with first, 
+	// so FastAccess needs no checks on each access within it.
+#define CHECK_RANGE_(idx, count, lower, higher, errc) \
+	(TAccess::CHECK_EACH || (lower <= (idx) && (idx) + (count) <= higher) || (lastError = (errc), false))
+#define READ_ARRAY_RANGED_(arr, idx, lower, higher, errc) \
+	(TAccess::CHECK_EACH ? READ_ARRAY_(arr, idx, lower, higher, errc) : arr[idx])
+
+#define MODIFY_STACK(idx, value) \
+	MODIFY_ARRAY_OP_(stack, idx, =, value, 0U, STACK_DEPTH, INTERPRETER_ERROR_STACK_OVERFLOW)
+#define READ_STACK(idx) \
+	READ_ARRAY_(stack, idx, 0U, STACK_DEPTH, INTERPRETER_ERROR_STACK_OVERFLOW)
+
+#define MODIFY_MEMORY(idx, value) \
+	(MODIFY_ARRAY_OP_(memory, idx, =, value, OFFSET_PROGRAM_START, memorySize, INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS), invalidateInstruction(idx))
+#define READ_MEMORY(idx) \
+	READ_ARRAY_(memory, idx, 0U, memorySize, INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS)
+
+#define CHECK_MEMORY_MODIFY_RANGE(idx, count) \
+	CHECK_RANGE_(idx, count, OFFSET_PROGRAM_START, memorySize, INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS)
+#define CHECK_MEMORY_READ_RANGE(idx, count) \
+	CHECK_RANGE_(idx, count, 0U, memorySize, INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS)
+#define MODIFY_MEMORY_RANGED(idx, value) \
+	(TAccess::CHECK_EACH ? MODIFY_MEMORY(idx, value) : (memory[idx] = (value), invalidateInstruction(idx)))
+#define READ_MEMORY_RANGED(idx) \
+	READ_ARRAY_RANGED_(memory, idx, 0U, memorySize, INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS)
+
+#define FETCH_OPCODE(offset, lower, higher, errc)					\
+	(TAccess::CHECK_EACH												\
+		? (lastError = (!IN_RANGE_(offset, lower, higher) ? (errc) : INTERPRETER_ERROR_OK), (memory + (offset)))	\
+		: (!IN_RANGE_(offset, lower, higher) ? (lastError = (errc), memory) : (memory + (offset))))
+
+#define PROGRAM_COUNTER_STEP sizeof(Opcode)
+
+	INTERPRETER_TEMPLATE
+	clock INTERPRETER_CLASS::doCycle() {
+		assert(isOk());
+
+		clock result = 0;
+
+		// TODO: it may be allowed to have no keypad in future.
+		PadKeys kbState = pollKeyPad();
+
+		if (isKeyAwaited()) {
+			auto &timer = timers[TIMER_SOUND];
+
+			// This check allows to trigger this method on each loop pass.
+			// So, simply there's no need to track keyboard hit externally.
+			if (kbState == KEY_NONE && kb != KEY_NONE) {
+
+				byte keyIdx = 0;
+				while (((kb >> keyIdx) & 0x01) == 0) {
+					++keyIdx;
+				}
+				registers[keyHaltRegister] = keyIdx;
+				keyHaltRegister = KEY_HALT_UNSET;
+
+				// Reset timer sound as it will be overridden by kbState hit await routine.
+				if (timer.value > 0) {
+					timer.value = 0;
+
+					events |= INTERPRETER_STOP_SOUND;
+				}
+			}
+			else if (kbState != KEY_NONE) {
+				// Continue beep'ing until kbState is not released.
+				if (timer.value == 0) {
+					timer.value = 4;
+
+					events |= INTERPRETER_STOP_SOUND;
+				}
+			}
+			result += COUNT_CYCLES_KEY_AWAIT_PASS;
+
+			COUNTERS_ADD(*this, keyWaitCycles, COUNT_CYCLES_KEY_AWAIT_PASS);
+		}
+		kb = kbState;
+
+		if (!isKeyAwaited()) {
+			Instruction scratch;
+			const Instruction *instruction = fetch(scratch);
+
+			if (!!instruction) {
+				TRACE_FETCH(*this, *instruction);
+				pc += PROGRAM_COUNTER_STEP;
+				// Stores may invalidate the cached instruction, so the code is kept aside.
+				const byte code = instruction->code;
+				const clock taken = (this->*instructions[code]) (*instruction);
+
+				COUNTERS_INSTRUCTION(*this, code, taken);
+				result += taken;
+				TRACE_RETIRE(*this, countCycles + result);
+
+				++rndSeed;
+				++countInstructions;
+			}
+		}
+		countCycles += result;
+
+		if (countCycles >= eventsNext) {
+			dispatchEvents();
+		}
+
+		return result;
+	}
+
+
+	INTERPRETER_TEMPLATE
+	inline clock INTERPRETER_CLASS::step() {
+		clock result = 0;
+
+		if (keyPadPolling) {
+			kb = pollKeyPad();
+		}
+		Instruction scratch;
+		const Instruction *instruction = fetch(scratch);
+
+		if (!!instruction) {
+			TRACE_FETCH(*this, *instruction);
+			pc += PROGRAM_COUNTER_STEP;
+			const byte code = instruction->code;
+			result = (this->*instructions[code]) (*instruction);
+
+			COUNTERS_INSTRUCTION(*this, code, result);
+			TRACE_RETIRE(*this, countCycles + result);
+			++rndSeed;
+			++countInstructions;
+		}
+		countCycles += result;
+
+		if (countCycles >= eventsNext) {
+			dispatchEvents();
+		}
+
+		return result;
+	}
+
+
+	INTERPRETER_TEMPLATE
+	clock INTERPRETER_CLASS::awaitKey(clock cyclesMax) {
+		clock result = 0;
+
+		do {
+			const clock eventsDue = eventsNext;
+
+			// The pass samples keys, it ends the wait on a key release.
+			result += doCycle();
+
+			if (!isKeyAwaited() || result >= cyclesMax || !isOk() || !!(events & stopConditions)) {
+				break;
+			}
+
+			// Events fired after the pass may have changed keys or timers,
+			// key pad device ones may change any pass while it is polled.
+			if (keyPadPolling || countCycles >= eventsDue) {
+				continue;
+			}
+
+			// Keys and timers stay the same until an event fires, so passes up to
+			// the one it's dispatched after would change nothing but cycles count.
+			const clock room = std::min<clock>(cyclesMax - result, eventsNext - countCycles);
+			const clock passes = (room + COUNT_CYCLES_KEY_AWAIT_PASS - 1) / COUNT_CYCLES_KEY_AWAIT_PASS;
+
+			COUNTERS_ADD(*this, keyWaitCycles, passes * COUNT_CYCLES_KEY_AWAIT_PASS);
+			countCycles += passes * COUNT_CYCLES_KEY_AWAIT_PASS;
+			result += passes * COUNT_CYCLES_KEY_AWAIT_PASS;
+
+			if (countCycles >= eventsNext) {
+				dispatchEvents();
+			}
+		} while (result < cyclesMax && !(events & stopConditions));
+
+		return result;
+	}
+
+	INTERPRETER_TEMPLATE
+	clock INTERPRETER_CLASS::skipIdleLoop(clock cyclesMax) {
+		enum : clock {
+			CYCLES_JUMP		= COUNT_CYCLES_TAKEN_BY_GROUPN(12),
+			CYCLES_DELAY	= COUNT_CYCLES_TAKEN_BY_GROUPN(10),
+			CYCLES_NO_SKIP	= COUNT_CYCLES_TAKEN_BY_GROUPN_BRANCH(false, 14, 10)
+		};
+
+		if (TRACE_ACTIVE(*this) || (pc & 0x01) || size_t(pc) + PROGRAM_COUNTER_STEP > memorySize) {
+			return 0;
+		}
+		const byte *code = memory + pc;
+		const byte jump[] = { byte(0x10 | pc >> 8), byte(pc) };
+
+		clock cycles = 0;
+		size_t length = 0;
+		size_t x = REGISTERS_COUNT;
+
+		if (code[0] == jump[0] && code[1] == jump[1]) {
+			cycles = CYCLES_JUMP;
+			length = 1;
+		}
+		// Delay timer is read until it's zero, nothing but a tick changes it.
+		else if (size_t(pc) + 3 * PROGRAM_COUNTER_STEP <= memorySize
+			&& (code[0] & 0xF0) == 0xF0 && code[1] == 0x07
+			&& code[2] == (0x30 | (code[0] & 0x0F)) && code[3] == 0x00
+			&& code[4] == jump[0] && code[5] == jump[1] && timers[TIMER_DELAY].value > 0) {
+
+			cycles = CYCLES_DELAY + CYCLES_NO_SKIP + CYCLES_JUMP;
+			length = 3;
+			x = code[0] & 0x0F;
+		}
+		else {
+			return 0;
+		}
+
+		// Passes of a wait end before the next event is due, so that the instruction
+		// it's dispatched after is run as usual. Passes of a jump to itself go on over
+		// events, as each of them is dispatched after a jump all the same.
+		clock result = 0;
+
+		while (result < cyclesMax && eventsNext > countCycles) {
+			const clock room = std::min<clock>(cyclesMax - result, eventsNext - countCycles);
+			const clock passes = length == 1 ? (room + cycles - 1) / cycles : (room - 1) / cycles;
+
+			if (passes == 0) {
+				break;
+			}
+			if (x < REGISTERS_COUNT) {
+				registers[x] = timers[TIMER_DELAY].value;
+
+				COUNTERS_INSTRUCTION_PASSES(*this, INSTRUCTION_FX07, passes, CYCLES_DELAY);
+				COUNTERS_INSTRUCTION_PASSES(*this, INSTRUCTION_3XNN, passes, CYCLES_NO_SKIP);
+			}
+			COUNTERS_INSTRUCTION_PASSES(*this, INSTRUCTION_1NNN, passes, CYCLES_JUMP);
+			COUNTERS_ADD(*this, idleCycles, passes * cycles);
+
+			rndSeed += word(passes * length);
+			countInstructions += passes * length;
+			countCycles += passes * cycles;
+			result += passes * cycles;
+
+			if (countCycles < eventsNext) {
+				break;
+			}
+			dispatchEvents();
+
+			if (!!(events & stopConditions)) {
+				break;
+			}
+		}
+		return result;
+	}
+
+
+	INTERPRETER_TEMPLATE
+	inline const InterpreterBase::Instruction *INTERPRETER_CLASS::fetch(Instruction &scratch) {
+		const byte *code = FETCH_OPCODE(pc, OFFSET_PROGRAM_START, memorySize - 1, INTERPRETER_ERROR_PROGRAM_COUNTER_CORRUPTED);
+
+		if (!isOk()) {
+			return nullptr;
+		}
+		const Opcode &opcode = *reinterpret_cast<const Opcode *>(code);
+		// Odd addresses are not cached, as any of them overlaps
+		// two adjacent slots. Programs hardly ever jump there.
+		if (!!(pc & 0x01)) {
+			decode(opcode, scratch);
+
+			return &scratch;
+		}
+		Instruction &instruction = instructionCache[pc >> 1];
+
+		if (instruction.code == INSTRUCTION_NONE) {
+			decode(opcode, instruction);
+		}
+		return &instruction;
+	}
+
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::invalidateInstruction(size_t address) {
+		if (address < memorySize) {
+			instructionCache[address >> 1].code = INSTRUCTION_NONE;
+#if CHIP8_RECOMPILER
+			if (!!recompiler) {
+				recompiler->invalidate(address);
+			}
+#endif // CHIP8_RECOMPILER
+		}
+	}
+
+
+	// ========================================================
+	// Program interpretation
+	// ========================================================
+
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::jmp(word address) {
+		pc = address;
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	inline void INTERPRETER_CLASS::jmp0(word address) {
+		pc = address + registers[!!(quirks & QUIRK_JUMP_VX) ? (address >> 8) & 0x0F : 0];
+	}
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::call(word address) {
+		push(pc);
+		pc = address;
+	}
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::ret() {
+		pc = pop();
+	}
+
+
+	INTERPRETER_TEMPLATE
+	inline bool INTERPRETER_CLASS::se(size_t idx, word value) {
+		if (READ_REGISTER(idx) == value) {
+			pc += PROGRAM_COUNTER_STEP;
+
+			return true;
+		}
+		return false;
+	}
+	INTERPRETER_TEMPLATE
+	inline bool INTERPRETER_CLASS::sne(size_t idx, word value) {
+		if (READ_REGISTER(idx) != value) {
+			pc += PROGRAM_COUNTER_STEP;
+
+			return true;
+		}
+		return false;
+	}
+	INTERPRETER_TEMPLATE
+	inline bool INTERPRETER_CLASS::sxye(size_t idx, size_t idy) {
+		if (READ_REGISTER(idx) == READ_REGISTER(idy)) {
+			pc += PROGRAM_COUNTER_STEP;
+			
+			return true;
+		}
+		return false;	
+	}
+	INTERPRETER_TEMPLATE
+	inline bool INTERPRETER_CLASS::sxyne(size_t idx, size_t idy) {
+		if (READ_REGISTER(idx) != READ_REGISTER(idy)) {
+			pc += PROGRAM_COUNTER_STEP;
+			
+			return true;
+		}
+		return false;	
+	}
+	INTERPRETER_TEMPLATE
+	inline bool INTERPRETER_CLASS::skbh(size_t idx) {
+		if (!!(kb & (0x01 << READ_REGISTER(idx)))) {
+			pc += PROGRAM_COUNTER_STEP;
+			
+			return true;
+		}
+		return false;
+	}
+	INTERPRETER_TEMPLATE
+	inline bool INTERPRETER_CLASS::skbnh(size_t idx) {
+		if (!(kb & (0x01 << READ_REGISTER(idx)))) {
+			pc += PROGRAM_COUNTER_STEP;
+			
+			return true;
+		}
+		return false;
+	}
+
+
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::movn(size_t idx, word value) {
+		MODIFY_REGISTER_OP(idx, =, byte(value));
+	}
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::movy(size_t idx, size_t idy) {
+		MODIFY_REGISTER_OP(idx, =, READ_REGISTER(idy));
+	}
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::movd(size_t idx) {
+		MODIFY_REGISTER_OP(idx, =, timers[TIMER_DELAY].value);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	inline void INTERPRETER_CLASS::movrs(size_t idx) {
+		word address = index;
+
+		if (CHECK_MEMORY_READ_RANGE(address, idx + 1)) {
+			for (size_t i = 0; i <= idx; ++i, ++address) {
+				MODIFY_REGISTER_OP(i, =, READ_MEMORY_RANGED(address));
+			}
+		}
+		else {
+			address += word(idx + 1);
+		}
+		if (!(quirks & QUIRK_LOAD_STORE_KEEP_I)) {
+			index = address;
+		}
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	inline void INTERPRETER_CLASS::movms(size_t idx) {
+		word address = index;
+
+		if (CHECK_MEMORY_MODIFY_RANGE(address, idx + 1)) {
+			for (size_t i = 0; i <= idx; ++i, ++address) {
+				MODIFY_MEMORY_RANGED(address, READ_REGISTER(i));
+			}
+		}
+		else {
+			address += word(idx + 1);
+		}
+		if (!(quirks & QUIRK_LOAD_STORE_KEEP_I)) {
+			index = address;
+		}
+	}
+
+
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::sti(word value) {
+		index = value;
+	}
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::adi(size_t idx) {
+		index += READ_REGISTER(idx);
+	}
+
+
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::add(size_t idx, word value) {
+		MODIFY_REGISTER_OP(idx, += , value);
+	}
+
+	// As per: http://laurencescotford.co.uk/?p=266
+	// carry flag is being assigned the last. This mean that if you
+	// use REG F as output, the result will be overwritten by a status flag.
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::adc(size_t idx, size_t idy) {
+		byte &dst = READ_REGISTER(idx);
+		word result = dst + READ_REGISTER(idy);
+
+		dst = byte(result);
+		carry = !!(result & 0x100) ? 0x01 : 0x00;
+	}
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::sbxyc(size_t idx, size_t idy) {
+		byte &dst = READ_REGISTER(idx);
+		word result = dst - READ_REGISTER(idy);
+
+		dst = byte(result);
+		carry = !!(result & 0x100) ? 0x00 : 0x01;
+	}
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::sbyxc(size_t idx, size_t idy) {
+		byte &dst = READ_REGISTER(idx);
+		word result = READ_REGISTER(idy) - dst;
+
+		dst = byte(result);
+		carry = !!(result & 0x100) ? 0x00 : 0x01;
+	}
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::shr_modern(size_t idx, size_t idy) {
+		byte &dst = READ_REGISTER(idx);
+		byte flag = dst & 0x01;
+
+		dst >>= 1;
+		carry = flag;		
+	}
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::shl_modern(size_t idx, size_t idy) {
+		byte &dst = READ_REGISTER(idx);
+		byte flag = dst >> 7;
+
+		dst <<= 1;
+		carry = flag;	
+	}
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::shr_original(size_t idx, size_t idy) {
+		byte value = READ_REGISTER(idy);
+
+		MODIFY_REGISTER_OP(idx, = , value >> 1);
+		carry = value & 0x01;
+	}
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::shl_original(size_t idx, size_t idy) {
+		byte value = READ_REGISTER(idy);
+
+		MODIFY_REGISTER_OP(idx, = , value << 1);
+		carry = value >> 7;
+	}
+
+
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::bor(size_t idx, size_t idy) {
+		MODIFY_REGISTER_OP(idx, |= , READ_REGISTER(idy));
+	}
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::band(size_t idx, size_t idy) {
+		MODIFY_REGISTER_OP(idx, &= , READ_REGISTER(idy));
+	}
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::bxor(size_t idx, size_t idy) {
+		MODIFY_REGISTER_OP(idx, ^= , READ_REGISTER(idy));
+	}
+
+
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::sym(size_t idx) {
+		index = READ_REGISTER(idx) * FONT_SYMBOL_HEIGHT;
+	}
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::rnd(size_t idx, word value) {
+		word loSeed = rndSeed + 1 & 0x00FF;
+		word result = READ_MEMORY(pc & 0xFF00U | loSeed);
+		{	
+			result = result + ((rndSeed + 1 & 0xFF00) >> 8) & 0xFF;
+			result += result >> 1 | (result & 0x01) << 7;
+		}
+		rndSeed = ((result & 0xFF) << 8) | loSeed;
+
+		MODIFY_REGISTER_OP(idx, = , byte(result & value));
+	}
+
+
+	INTERPRETER_TEMPLATE
+	inline size_t INTERPRETER_CLASS::bcd(size_t idx) {
+		word value = READ_REGISTER(idx);
+
+		int hundreds = value / 100;
+		value = value % 100;
+
+		int tens = value / 10;
+		int ones = value % 10;
+
+		if (CHECK_MEMORY_MODIFY_RANGE(index, 3U)) {
+			MODIFY_MEMORY_RANGED(index, hundreds);
+			MODIFY_MEMORY_RANGED(index + 1U, tens);
+			MODIFY_MEMORY_RANGED(index + 2U, ones);
+		}
+
+		return hundreds + tens + ones;
+	}
+
+
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::cls() {
+		deviceDisplay->clear();
+
+		deviceDisplay->invalidate();
+		events |= INTERPRETER_STOP_DISPLAY;
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	inline void INTERPRETER_CLASS::sprite(size_t idx, size_t idy, word value) {
+		bool collision = false;
+
+		if (value > 0) {
+			const size_t y = READ_REGISTER(idy) % deviceDisplay->height();
+			const size_t x = READ_REGISTER(idx) % deviceDisplay->width();
+			const size_t w = std::min<size_t>(deviceDisplay->width() - x, 8);
+			const size_t h = std::min<size_t>(deviceDisplay->height() - y, value);
+
+			if (!!(quirks & QUIRK_SPRITE_WRAP) && (w < 8 || h < value)) {
+				const size_t height = deviceDisplay->height();
+
+				for (size_t i = index, r = 0, rmax = CHECK_MEMORY_READ_RANGE(index, value) ? value : 0; r < rmax; ++i, ++r) {
+					collision |= deviceDisplay->xorLine(byte((y + r) % height), byte(x), READ_MEMORY_RANGED(i));
+					COUNTERS_ADD(*this, spriteRows, 1);
+				}
+				deviceDisplay->invalidate();
+				events |= INTERPRETER_STOP_DISPLAY;
+
+				carry = collision ? 0x01 : 0x00;
+				COUNTERS_ADD(*this, collisions, carry);
+				return;
+			}
+	
+			const byte strideMask = (w < 8) ? (0xFF << (8 - w)) : 0xFF;
+			for (size_t i = index, r = y, rmax = CHECK_MEMORY_READ_RANGE(index, h) ? y + h : y; r < rmax; ++i, ++r) {
+				collision |= deviceDisplay->xorLine(byte(r), byte(x), READ_MEMORY_RANGED(i) & strideMask);
+				COUNTERS_ADD(*this, spriteRows, 1);
+			}
+			deviceDisplay->invalidate(byte(x), byte(y), byte(w), byte(h));
+			events |= INTERPRETER_STOP_DISPLAY;
+		}
+		carry = collision ? 0x01 : 0x00;
+		COUNTERS_ADD(*this, collisions, carry);
+	}
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::sound(size_t idx) {
+		scheduleEvent(countCycles + COUNT_CYCLES_TIMER_SET, EVENT_TIMER_SET, TIMER_SOUND, READ_REGISTER(idx));
+	}
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::delay(size_t idx) {
+		scheduleEvent(countCycles + COUNT_CYCLES_TIMER_SET, EVENT_TIMER_SET, TIMER_DELAY, READ_REGISTER(idx));
+	}
+	INTERPRETER_TEMPLATE
+	inline void INTERPRETER_CLASS::key(size_t idx) {
+		keyHaltRegister = idx;
+
+		events |= INTERPRETER_STOP_KEY_AWAIT;
+	}
+	
+
+	// ========================================================
+	// complementary methods
+	// ========================================================
+
+	INTERPRETER_TEMPLATE
+	void INTERPRETER_CLASS::push(word value) {
+		size_t idx = --sp;
+
+		MODIFY_STACK(idx, value);
+	}
+
+	INTERPRETER_TEMPLATE
+	word INTERPRETER_CLASS::pop() {
+		size_t idx = sp++;
+
+		return READ_STACK(idx);
+	}
+
+
+	// ========================================================
+	// instruction handlers
+	// ========================================================
+
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op00E0(const Instruction &) {
+		cls();
+
+		return COUNT_CYCLES_TAKEN_BY_GROUP0(24);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op00EE(const Instruction &) {
+		ret();
+
+		return COUNT_CYCLES_TAKEN_BY_GROUP0(10);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op0NNN(const Instruction &) {
+		lastError = INTERPRETER_ERROR_UNEXPECTED;
+
+		return COUNT_CYCLES_GROUP0_DEFAULT;
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op1NNN(const Instruction &instruction) {
+#if CHIP8_IDLE_SKIP
+		// Jumps to itself or 3 instructions back may close an idle loop.
+		if (!TRACE_ACTIVE(*this) && (instruction.value + PROGRAM_COUNTER_STEP == pc
+			|| instruction.value + 3 * PROGRAM_COUNTER_STEP == pc)) {
+
+			events |= INTERPRETER_IDLE_LOOP;
+		}
+#endif // CHIP8_IDLE_SKIP
+		jmp(instruction.value);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(12);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op2NNN(const Instruction &instruction) {
+		call(instruction.value);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(26);
+	}
+
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op3XNN(const Instruction &instruction) {
+		return COUNT_CYCLES_TAKEN_BY_GROUPN_BRANCH(
+			se(instruction.x, instruction.value), 14, 10);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op4XNN(const Instruction &instruction) {
+		return COUNT_CYCLES_TAKEN_BY_GROUPN_BRANCH(
+			sne(instruction.x, instruction.value), 14, 10);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op5XY0(const Instruction &instruction) {
+		return COUNT_CYCLES_TAKEN_BY_GROUPN_BRANCH(
+			sxye(instruction.x, instruction.y), 18, 14);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op6XNN(const Instruction &instruction) {
+		movn(instruction.x, instruction.value);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(6);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op7XNN(const Instruction &instruction) {
+		add(instruction.x, instruction.value);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(10);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op8XY0(const Instruction &instruction) {
+		movy(instruction.x, instruction.y);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(12);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op8XY1(const Instruction &instruction) {
+		bor(instruction.x, instruction.y);
+
+		if (!!(quirks & QUIRK_LOGIC_VF_RESET)) {
+			carry = 0x00;
+		}
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(44);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op8XY2(const Instruction &instruction) {
+		band(instruction.x, instruction.y);
+
+		if (!!(quirks & QUIRK_LOGIC_VF_RESET)) {
+			carry = 0x00;
+		}
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(44);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op8XY3(const Instruction &instruction) {
+		bxor(instruction.x, instruction.y);
+
+		if (!!(quirks & QUIRK_LOGIC_VF_RESET)) {
+			carry = 0x00;
+		}
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(44);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op8XY4(const Instruction &instruction) {
+		adc(instruction.x, instruction.y);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(44);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op8XY5(const Instruction &instruction) {
+		sbxyc(instruction.x, instruction.y);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(44);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op8XY6(const Instruction &instruction) {
+		if (!!(quirks & QUIRK_SHIFT_VX)) {
+			shr_modern(instruction.x, instruction.y);
+		}
+		else {
+			shr_original(instruction.x, instruction.y);
+		}
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(44);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op8XY7(const Instruction &instruction) {
+		sbyxc(instruction.x, instruction.y);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(44);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op8XYE(const Instruction &instruction) {
+		if (!!(quirks & QUIRK_SHIFT_VX)) {
+			shl_modern(instruction.x, instruction.y);
+		}
+		else {
+			shl_original(instruction.x, instruction.y);
+		}
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(44);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::op9XY0(const Instruction &instruction) {
+		return COUNT_CYCLES_TAKEN_BY_GROUPN_BRANCH(
+			sxyne(instruction.x, instruction.y), 18, 14);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opANNN(const Instruction &instruction) {
+		sti(instruction.value);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(12);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opBNNN(const Instruction &instruction) {
+		jmp0<quirks>(instruction.value);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(22);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opCXNN(const Instruction &instruction) {
+		rnd(instruction.x, instruction.value);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(36);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opDXYN(const Instruction &instruction) {
+		auto rowsCount = instruction.value;
+
+		sprite<quirks>(instruction.x, instruction.y, rowsCount);
+
+		// Because it is really hard to estimate an exact number of cycles, 
+		// we provide a linear approximation here.
+		//
+		// (((2533 + 3666) / 3) + 3812) / 15 ~ 412,
+		// where first part is for avg. IDL await time,
+		// the second is a worst case of time consumtion by drawing routine 
+		// (15 rows, collision on each row, 7*14 pixels offscreen).
+		//
+		// See: http://laurencescotford.co.uk/?p=304 for details.
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(rowsCount * 412);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opEX9E(const Instruction &instruction) {
+		return COUNT_CYCLES_TAKEN_BY_GROUPN_BRANCH(
+			skbh(instruction.x), 18, 14);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opEXA1(const Instruction &instruction) {
+		return COUNT_CYCLES_TAKEN_BY_GROUPN_BRANCH(
+			skbnh(instruction.x), 18, 14);
+	}
+
+#define COUNT_CYCLES_TAKEN_BY_GROUPN_WEIGHTED(operation, instruction, base, perPoint)				\
+	{																								\
+		auto weight = operation(instruction.x);														\
+																									\
+		return COUNT_CYCLES_TAKEN_FOR(COUNT_CYCLES_GROUPN_DEFAULT, base + perPoint * (weight));		\
+	}	
+#define COUNT_CYCLES_TAKEN_BY_GROUPN_SERIAL(operation, instruction, base, perCycle)					\
+	{																								\
+		auto index = instruction.x;																	\
+																									\
+		operation(index);																			\
+		return COUNT_CYCLES_TAKEN_FOR(COUNT_CYCLES_GROUPN_DEFAULT, base + perCycle * (index + 2));	\
+	}
+
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opFX07(const Instruction &instruction) {
+		movd(instruction.x);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(10);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opFX0A(const Instruction &instruction) {
+		key(instruction.x);
+
+		// This number is an average of theoretical minimum for 
+		// every 0-F key.
+		//
+		// See: http://laurencescotford.co.uk/?p=347 for details.
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(17765);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opFX15(const Instruction &instruction) {
+		delay(instruction.x);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(10);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opFX18(const Instruction &instruction) {
+		sound(instruction.x);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(10);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opFX1E(const Instruction &instruction) {
+		adi(instruction.x);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(16);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opFX29(const Instruction &instruction) {
+		sym(instruction.x);
+
+		return COUNT_CYCLES_TAKEN_BY_GROUPN(20);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opFX33(const Instruction &instruction) {
+		COUNT_CYCLES_TAKEN_BY_GROUPN_WEIGHTED(bcd, instruction, 84, 16);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opFX55(const Instruction &instruction) {
+		COUNT_CYCLES_TAKEN_BY_GROUPN_SERIAL(movms<quirks>, instruction, 4, 14);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opFX65(const Instruction &instruction) {
+		COUNT_CYCLES_TAKEN_BY_GROUPN_SERIAL(movrs<quirks>, instruction, 4, 14);
+	}
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	size_t INTERPRETER_CLASS::opXXXX(const Instruction &) {
+		lastError = INTERPRETER_ERROR_UNEXPECTED;
+
+		return COUNT_CYCLES_GROUPN_DEFAULT;
+	}
+
+
+#define INSTRUCTION_HANDLER_ADDRESS(id) &INTERPRETER_CLASS::template op##id<quirks>,
+
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	const typename INTERPRETER_CLASS::InstructionHandler INTERPRETER_CLASS::InstructionsLUT<quirks>::value[INSTRUCTIONS_COUNT] = {
+		nullptr, CHIP8_INSTRUCTIONS(INSTRUCTION_HANDLER_ADDRESS)
+	};
+
+	// Expands X(quirks) for every quirks combination, 0 through QUIRKS_COUNT - 1.
+#define QUIRKS_COMBINATIONS_2(X, quirks) X(quirks) X(quirks + 0x01)
+#define QUIRKS_COMBINATIONS_4(X, quirks) QUIRKS_COMBINATIONS_2(X, quirks) QUIRKS_COMBINATIONS_2(X, quirks + 0x02)
+#define QUIRKS_COMBINATIONS_8(X, quirks) QUIRKS_COMBINATIONS_4(X, quirks) QUIRKS_COMBINATIONS_4(X, quirks + 0x04)
+#define QUIRKS_COMBINATIONS_16(X, quirks) QUIRKS_COMBINATIONS_8(X, quirks) QUIRKS_COMBINATIONS_8(X, quirks + 0x08)
+#define QUIRKS_COMBINATIONS(X) QUIRKS_COMBINATIONS_16(X, 0x00) QUIRKS_COMBINATIONS_16(X, 0x10)
+
+	static_assert(InterpreterBase::QUIRKS_COUNT == 0x20, "QUIRKS_COMBINATIONS must cover every quirks combination");
+
+#define INSTRUCTIONS_LUT_ADDRESS(quirks) InstructionsLUT<(quirks)>::value,
+
+	INTERPRETER_TEMPLATE
+	const typename INTERPRETER_CLASS::InstructionHandler *const INTERPRETER_CLASS::instructionsLUT[QUIRKS_COUNT] = {
+		QUIRKS_COMBINATIONS(INSTRUCTIONS_LUT_ADDRESS)
+	};
+
+
+	// ========================================================
+	// threaded dispatch
+	//
+	// doCycles() runs instructions back to back, so the handler
+	// of each instruction dispatches the next one on its own
+	// instead of returning to a common call site. Every handler
+	// gets its own indirect branch, which predicts way better
+	// than the single one of doCycle().
+	//
+	// Handlers jump to each other through GCC/Clang labels as values,
+	// or chain through tail calls with the other compilers. Define
+	// CHIP8_DISPATCH_THREADED=2 to take tail calls with any compiler,
+	// or CHIP8_DISPATCH_THREADED=0 to make doCycles() a plain loop
+	// over doCycle().
+	// ========================================================
+
+#if !defined(CHIP8_DISPATCH_THREADED)
+#define CHIP8_DISPATCH_THREADED 1
+#endif // CHIP8_DISPATCH_THREADED
+
+	// Interpretation stops as soon as native code is there to go on with.
+#if CHIP8_RECOMPILER
+#define DISPATCH_RECOMPILED(soc) \
+	(!!(soc).recompiler && !TRACE_ACTIVE(soc) && (soc).recompiler->lookup((soc).pc).length > 0)
+#else
+#define DISPATCH_RECOMPILED(soc) false
+#endif // CHIP8_RECOMPILER
+
+#if CHIP8_DISPATCH_THREADED
+#if CHIP8_DISPATCH_THREADED == 1 && defined(__GNUC__)
+
+	// Direct threaded code through GCC/Clang labels as values.
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	struct INTERPRETER_CLASS::Dispatcher {
+
+		static clock run(BasicInterpreter &soc, clock cyclesMin) {
+#define DISPATCH_LABEL_ADDRESS(id) &&label##id,
+
+			static void *const labelsLUT[INSTRUCTIONS_COUNT] = {
+				nullptr, CHIP8_INSTRUCTIONS(DISPATCH_LABEL_ADDRESS)
+			};
+			clock result = 0;
+			size_t cycles;
+
+			Instruction scratch;
+			const Instruction *instruction;
+
+#define DISPATCH_NEXT()													\
+			if (soc.keyPadPolling) {									\
+				soc.kb = soc.pollKeyPad();								\
+			}															\
+			if (!(instruction = soc.fetch(scratch))) {					\
+				return result;											\
+			}															\
+			TRACE_FETCH(soc, *instruction);								\
+			soc.pc += PROGRAM_COUNTER_STEP;								\
+			goto *labelsLUT[instruction->code];
+#define DISPATCH_HANDLER(id)											\
+		label##id:														\
+			cycles = soc.template op##id<quirks>(*instruction);			\
+			COUNTERS_INSTRUCTION(soc, INSTRUCTION_##id, cycles);		\
+			++soc.rndSeed;												\
+			++soc.countInstructions;									\
+			soc.countCycles += cycles;									\
+			TRACE_RETIRE(soc, soc.countCycles);							\
+			if (soc.countCycles >= soc.eventsNext) {					\
+				soc.dispatchEvents();									\
+			}															\
+			result += cycles;											\
+			if (result >= cyclesMin || !soc.isOk() || soc.isKeyAwaited()	\
+				|| !!(soc.events & (soc.stopConditions | INTERPRETER_IDLE_LOOP))	\
+				|| DISPATCH_RECOMPILED(soc)) {							\
+																		\
+				return result;											\
+			}															\
+			DISPATCH_NEXT()
+
+			DISPATCH_NEXT()
+			CHIP8_INSTRUCTIONS(DISPATCH_HANDLER)
+
+			return result;
+		}
+	};
+
+#else
+
+	// Handlers chain through tail calls. The chain is cut every
+	// DISPATCH_CHAIN_LENGTH instructions to keep the stack bounded
+	// for compilers (or builds) which don't eliminate tail calls.
+#define DISPATCH_CHAIN_LENGTH 64
+
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	struct INTERPRETER_CLASS::Dispatcher {
+
+		struct Context {
+			BasicInterpreter &soc;
+
+			clock cyclesMin;
+			clock result;
+			size_t chainLength;
+
+			Instruction scratch;
+		};
+
+		typedef void (*Handler) (Context &, const Instruction &);
+
+		static const Handler handlersLUT[INSTRUCTIONS_COUNT];
+
+		static void next(Context &context) {
+			BasicInterpreter &soc = context.soc;
+
+			if (context.result >= context.cyclesMin || !soc.isOk() || soc.isKeyAwaited()
+				|| !!(soc.events & (soc.stopConditions | INTERPRETER_IDLE_LOOP)) || !(context.chainLength--)) {
+
+				return;
+			}
+			if (soc.keyPadPolling) {
+				soc.kb = soc.pollKeyPad();
+			}
+
+			const Instruction *instruction = soc.fetch(context.scratch);
+			if (!!instruction) {
+				TRACE_FETCH(soc, *instruction);
+				soc.pc += PROGRAM_COUNTER_STEP;
+
+				return handlersLUT[instruction->code](context, *instruction);
+			}
+		}
+
+#define DISPATCH_HANDLER(id)											\
+		static void handle##id(Context &context, const Instruction &instruction) {	\
+			size_t cycles = context.soc.template op##id<quirks>(instruction);	\
+			COUNTERS_INSTRUCTION(context.soc, INSTRUCTION_##id, cycles);		\
+																		\
+			++context.soc.rndSeed;										\
+			++context.soc.countInstructions;							\
+			context.soc.countCycles += cycles;							\
+			TRACE_RETIRE(context.soc, context.soc.countCycles);			\
+			if (context.soc.countCycles >= context.soc.eventsNext) {	\
+				context.soc.dispatchEvents();							\
+			}															\
+			context.result += cycles;									\
+																		\
+			if (DISPATCH_RECOMPILED(context.soc)) {						\
+				return;													\
+			}															\
+			return next(context);										\
+		}
+
+		CHIP8_INSTRUCTIONS(DISPATCH_HANDLER)
+
+		static clock run(BasicInterpreter &soc, clock cyclesMin) {
+			Context context = { soc, cyclesMin, 0, DISPATCH_CHAIN_LENGTH, { 0, 0, 0, 0 } };
+
+			do {
+				context.chainLength = DISPATCH_CHAIN_LENGTH;
+
+				next(context);
+			} while (context.chainLength == size_t(-1));
+
+			return context.result;
+		}
+	};
+
+#define DISPATCH_HANDLER_ADDRESS(id) &INTERPRETER_CLASS::template Dispatcher<quirks>::handle##id,
+
+	INTERPRETER_TEMPLATE
+	template <unsigned quirks>
+	const typename INTERPRETER_CLASS::template Dispatcher<quirks>::Handler INTERPRETER_CLASS::Dispatcher<quirks>::handlersLUT[INSTRUCTIONS_COUNT] = {
+		nullptr, CHIP8_INSTRUCTIONS(DISPATCH_HANDLER_ADDRESS)
+	};
+
+#endif // CHIP8_DISPATCH_THREADED == 1 && __GNUC__
+
+#define DISPATCHER_ADDRESS(quirks) &Dispatcher<(quirks)>::run,
+
+	INTERPRETER_TEMPLATE
+	const typename INTERPRETER_CLASS::DispatchFunc INTERPRETER_CLASS::dispatchersLUT[QUIRKS_COUNT] = {
+		QUIRKS_COMBINATIONS(DISPATCHER_ADDRESS)
+	};
+
+#else
+
+	INTERPRETER_TEMPLATE
+	const typename INTERPRETER_CLASS::DispatchFunc INTERPRETER_CLASS::dispatchersLUT[QUIRKS_COUNT] = {
+		nullptr
+	};
+
+#endif // CHIP8_DISPATCH_THREADED
+
+	INTERPRETER_TEMPLATE
+	clock INTERPRETER_CLASS::doCycles(clock cyclesMin) {
+		stopConditions = INTERPRETER_STOP_NONE;
+		keyPadPolling = true;
+
+		return execute(cyclesMin);
+	}
+
+	INTERPRETER_TEMPLATE
+	InterpreterBase::RunStatus INTERPRETER_CLASS::run(clock cycleBudget, unsigned stopConditions) {
+		RunStatus status = { 0, INTERPRETER_STOP_NONE };
+
+		if (isOk()) {
+			// While a key is awaited, the sample taken last is kept,
+			// as key release is detected against it.
+			if (!isKeyAwaited()) {
+				kb = pollKeyPad();
+			}
+			events = INTERPRETER_STOP_NONE;
+
+			this->stopConditions = stopConditions;
+			keyPadPolling = false;
+
+			status.cycles = execute(cycleBudget);
+			status.stoppedBy = events & stopConditions;
+		}
+		if (status.cycles >= cycleBudget) {
+			status.stoppedBy |= INTERPRETER_STOP_BUDGET;
+		}
+		if (!isOk()) {
+			status.stoppedBy |= INTERPRETER_STOP_ERROR;
+		}
+		return status;
+	}
+
+	INTERPRETER_TEMPLATE
+	clock INTERPRETER_CLASS::execute(clock cyclesMin) {
+		clock result = 0;
+
+		while (result < cyclesMin && isOk() && !(events & stopConditions)) {
+#if CHIP8_IDLE_SKIP
+			if (!!(events & INTERPRETER_IDLE_LOOP)) {
+				events &= ~INTERPRETER_IDLE_LOOP;
+				result += skipIdleLoop(cyclesMin - result);
+
+				continue;
+			}
+#endif // CHIP8_IDLE_SKIP
+			// Key await is handled apart, as it has nothing
+			// to dispatch until a key is hit.
+			if (isKeyAwaited()) {
+				result += awaitKey(cyclesMin - result);
+
+				continue;
+			}
+#if CHIP8_RECOMPILER
+			if (!!recompiler && !TRACE_ACTIVE(*this)) {
+				const Recompiler::Block &block = recompiler->lookup(pc);
+
+				// A block runs as a whole, so it is entered only if the budget
+				// can't run out before its last instruction. This keeps cycles
+				// count exactly the same as interpreter's one.
+				if (block.length > 0 && result + block.cyclesPrefix < cyclesMin
+					&& countCycles + block.cyclesPrefix < eventsNext) {
+					if (keyPadPolling) {
+						kb = pollKeyPad();
+					}
+					size_t cycles = block.code(registers);
+
+					rndSeed += block.length;
+					countInstructions += block.length;
+					COUNTERS_ADD(*this, recompiledInstructions, block.length);
+					COUNTERS_ADD(*this, recompiledCycles, cycles);
+					countCycles += cycles;
+					result += cycles;
+
+					if (countCycles >= eventsNext) {
+						dispatchEvents();
+					}
+
+					continue;
+				}
+				if (block.length > 0) {
+					result += step();
+
+					continue;
+				}
+			}
+#endif // CHIP8_RECOMPILER
+#if CHIP8_DISPATCH_THREADED
+			result += dispatch(*this, cyclesMin - result);
+#else
+			result += step();
+#endif // CHIP8_DISPATCH_THREADED
+		}
+		return result;
+	}
+
+	INTERPRETER_TEMPLATE
+	bool INTERPRETER_CLASS::enableRecompiler(bool enable) {
+#if CHIP8_RECOMPILER
+		if (enable && !recompiler) {
+			const byte *base = registers;
+
+			Recompiler::Layout layout = {
+				reinterpret_cast<const byte *>(&index) - base,
+				reinterpret_cast<const byte *>(&pc) - base,
+				reinterpret_cast<const byte *>(&timers[TIMER_DELAY].value) - base
+			};
+			recompiler = new Recompiler(memory, memorySize, OFFSET_PROGRAM_START, 
+				layout, quirksActive);
+
+			if (!recompiler->isReady()) {
+				delete recompiler;
+				recompiler = nullptr;
+			}
+		}
+		else if (!enable) {
+			delete recompiler;
+			recompiler = nullptr;
+		}
+		return !!recompiler;
+#else
+		return false;
+#endif // CHIP8_RECOMPILER
+	}
+
+#undef INTERPRETER_TEMPLATE
+#undef INTERPRETER_CLASS
+
+#undef FONT_SYMBOL_HEIGHT
+#undef MODIFY_REGISTER_OP
+#undef READ_REGISTER
+#undef IN_RANGE_
+#undef MODIFY_ARRAY_OP_
+#undef READ_ARRAY_
+#undef CHECK_RANGE_
+#undef READ_ARRAY_RANGED_
+#undef MODIFY_STACK
+#undef READ_STACK
+#undef MODIFY_MEMORY
+#undef READ_MEMORY
+#undef CHECK_MEMORY_MODIFY_RANGE
+#undef CHECK_MEMORY_READ_RANGE
+#undef MODIFY_MEMORY_RANGED
+#undef READ_MEMORY_RANGED
+#undef FETCH_OPCODE
+#undef PROGRAM_COUNTER_STEP
+#undef COUNT_CYCLES_TAKEN_BY_GROUPN_WEIGHTED
+#undef COUNT_CYCLES_TAKEN_BY_GROUPN_SERIAL
+#undef INSTRUCTION_HANDLER_ADDRESS
+#undef QUIRKS_COMBINATIONS_2
+#undef QUIRKS_COMBINATIONS_4
+#undef QUIRKS_COMBINATIONS_8
+#undef QUIRKS_COMBINATIONS_16
+#undef QUIRKS_COMBINATIONS
+#undef INSTRUCTIONS_LUT_ADDRESS
+#undef DISPATCHER_ADDRESS
+#undef DISPATCH_RECOMPILED
+#undef DISPATCH_LABEL_ADDRESS
+#undef DISPATCH_NEXT
+#undef DISPATCH_HANDLER
+#undef DISPATCH_CHAIN_LENGTH
+#undef DISPATCH_HANDLER_ADDRESS
+#undef COUNTERS_ADD
+#undef COUNTERS_INSTRUCTION
+#undef COUNTERS_INSTRUCTION_PASSES
+#undef TRACE_ACTIVE
+#undef TRACE_FETCH
+#undef TRACE_RETIRE
+} // namespace chip8
+
+#endif // CHIP8_INTERPRETER_IMPL_
\ No newline at end of file
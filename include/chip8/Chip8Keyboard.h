@@ -34,6 +34,15 @@ namespace chip8 {
 		virtual PadKeys getState() const = 0;
 	};
 
+	// Key pad, which never has a key held. Input of headless runs comes
+	// from the keys scheduled only.
+	class NullKeyPad final : public IKeyPad {
+	public:
+		PadKeys getState() const final {
+			return KEY_NONE;
+		}
+	};
+
 } // namespace chip8
 
 #endif // CHIP8_KEYBOARD_
\ No newline at end of file
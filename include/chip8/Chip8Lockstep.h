@@ -0,0 +1,202 @@
+#pragma once
+
+#ifndef CHIP8_LOCKSTEP_
+#define CHIP8_LOCKSTEP_
+
+#include "Chip8Base.h"
+#include "Chip8Display.h"
+#include "Chip8Interpreter.h"
+#include "Chip8Keyboard.h"
+#include "Chip8Scheduler.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace chip8 {
+
+	// Runs one program on LANES machines at once, which differ by input and random
+	// seed only (or by the states loaded). Registers, index, program counter, stack
+	// and timers are kept as arrays of lanes, so that an instruction is executed for
+	// all the lanes it's fetched by through plain loops over lanes, which compilers
+	// turn into vector code. Lanes, which have diverged, are run in groups of the same
+	// program counter, the lowest one first, so that they meet again as soon as possible.
+	//
+	// Once lanes have diverged for good (few of them run together on average), they go
+	// on one by one through a plain interpreter, until run() returns.
+	//
+	// Each lane behaves exactly as BasicInterpreter::run() over a display and a key pad,
+	// which never has a key held. Input comes from the keys scheduled.
+	template <size_t LANES>
+	class Lockstep : public InterpreterBase {
+	public:
+
+		enum : size_t {
+			LANES_COUNT = LANES
+		};
+
+		Lockstep(
+			size_t memorySize = ADDRESS_SPACE_DEFAULT,
+
+			byte width = DefaultDisplay::FRAME_WIDTH,
+			byte height = DefaultDisplay::FRAME_HEIGHT
+			);
+
+		~Lockstep();
+
+
+		// Quirks are the same for all the lanes and take effect on the next reset().
+		void setQuirks(unsigned quirks);
+
+		unsigned getQuirks() const {
+			return quirks;
+		}
+
+		// Load the program to all the lanes, seeds are kept.
+		void reset(const byte *prg, size_t prgLen);
+
+		void setSeed(size_t lane, word seed);
+
+		// See BasicInterpreter::scheduleKeys().
+		bool scheduleKeys(size_t lane, clock timestamp, PadKeys keys);
+
+		// Run each lane until cycleBudget is used up, see BasicInterpreter::run().
+		void run(clock cycleBudget);
+
+
+		// State format is the one of BasicInterpreter, so that a lane may go on
+		// with a state saved by an interpreter and vice versa. A state is loaded
+		// only if its quirks are the active ones.
+		size_t getStateSize(size_t lane) const;
+
+		bool saveState(size_t lane, void *buffer, size_t size) const;
+		bool loadState(size_t lane, const void *buffer, size_t size);
+
+
+		Error getLastError(size_t lane) const {
+			return Error(lastError[lane]);
+		}
+
+		clock getCyclesCount(size_t lane) const {
+			return countCycles[lane];
+		}
+
+		bool isOk(size_t lane) const {
+			return getLastError(lane) == INTERPRETER_ERROR_OK;
+		}
+
+		const PackedDisplay &getDisplay(size_t lane) const {
+			return *displays[lane];
+		}
+
+		// Instructions executed in lockstep, counted once per group of lanes and
+		// per lane. The ratio shows how much of the time lanes run together.
+		clock getStepsCount() const {
+			return countSteps;
+		}
+		clock getLaneStepsCount() const {
+			return countLaneSteps;
+		}
+
+	private:
+
+		Lockstep(const Lockstep &);
+
+
+		enum : size_t {
+			OCCUPANCY_WINDOW	= 0x40,						// Steps occupancy is checked over.
+			OCCUPANCY_MIN		= LANES / 4					// Lanes per step, below which lanes go on one by one.
+		};
+
+		typedef BasicInterpreter<PackedDisplay, NullKeyPad, FastAccess> LaneInterpreter;
+
+		unsigned quirks;
+		unsigned quirksActive;
+
+		const size_t memorySize;
+		byte *memory;										// Lane memories one after another.
+
+		PackedDisplay *displays[LANES];
+		Scheduler *schedulers;								// One per lane.
+
+		// ========================================================
+		// lanes
+		// ========================================================
+
+		byte registers[REGISTERS_COUNT][LANES];
+		word stack[STACK_DEPTH][LANES];
+
+		word pc[LANES];
+		word index[LANES];
+		word sp[LANES];
+		word kb[LANES];
+		word keysScheduled[LANES];
+		word rndSeed[LANES];
+
+		byte timers[2][LANES];
+		byte keyHaltRegister[LANES];						// STATE_KEY_HALT_UNSET, if no key is awaited.
+		byte lastError[LANES];
+
+		clock countCycles[LANES];
+		clock eventsNext[LANES];
+
+		clock result[LANES];								// Cycles taken since run() has started.
+		clock pending[LANES];								// Key await cycles to count along with the next instruction.
+		clock cycles[LANES];								// Cycles taken by the instruction executed.
+
+		byte active[LANES];									// Lanes, which go on running.
+		byte group[LANES];									// Lanes, which execute the instruction.
+
+		clock countSteps;
+		clock countLaneSteps;
+
+		byte *laneMemory(size_t lane) const {
+			return memory + lane * memorySize;
+		}
+
+		NullKeyPad keyPad;
+		PackedDisplay *scalarDisplay;
+		LaneInterpreter *scalar;							// Runs the lanes, which have diverged.
+
+		std::vector<clock> stateBuffer;						// Words of clock size keep it aligned as State is.
+
+		void resetLane(size_t lane);
+		bool loadLane(size_t lane, const byte *data);
+		void runScalar(size_t lane, clock cycleBudget);
+
+		void awaitKey(size_t lane);
+		void commitPending(size_t lane);
+
+		void dispatchEvents(size_t lane);
+		void scheduleEvent(size_t lane, clock timestamp, byte kind, byte target, word value);
+
+
+		// ========================================================
+		// instructions execution
+		// ========================================================
+
+		struct CacheEntry {
+			Opcode opcode;
+			Instruction instruction;
+		};
+
+		std::vector<CacheEntry> instructionCache;			// Decoded instructions by address, checked against the opcode.
+		std::vector<byte> codeWritten;						// Addresses, which any lane has written to since reset.
+
+		const Instruction &decodeCached(word address, const Opcode &opcode, Instruction &scratch);
+
+#define CHIP8_LOCKSTEP_HANDLER(id) void op##id(const Instruction &instruction);
+		CHIP8_INSTRUCTIONS(CHIP8_LOCKSTEP_HANDLER)
+#undef CHIP8_LOCKSTEP_HANDLER
+
+		typedef void (Lockstep::*InstructionHandler) (const Instruction &);
+
+		static const InstructionHandler instructions[INSTRUCTIONS_COUNT];
+	};
+
+	extern template class Lockstep<8>;
+	extern template class Lockstep<16>;
+	extern template class Lockstep<32>;
+
+} // namespace chip8
+
+#endif // CHIP8_LOCKSTEP_
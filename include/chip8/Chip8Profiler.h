@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef CHIP8_PROFILER_
+#define CHIP8_PROFILER_
+
+#include "Chip8Base.h"
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <vector>
+
+namespace chip8 {
+
+	// Guest program profiler, see BasicInterpreter::setProfiler. Interpreter takes a sample
+	// of pc and the call stack each interval machine cycles, on the instruction boundary
+	// the interval ends at. Return addresses on the stack are resolved into the entries of
+	// routines they return from by the 2NNN instruction just before each of them.
+	class Profiler {
+	public:
+
+		enum : word {
+			ROUTINE_UNKNOWN = 0xFFFF						// Call instruction is overwritten since.
+		};
+
+		struct Hotspot {
+			word address;
+			clock samples;									// Samples taken within the routine (self) or at the address.
+			clock samplesTotal;								// Samples taken within the routine and routines it called.
+		};
+
+		// Program is entered at the root routine.
+		explicit Profiler(clock interval, word root = 0x200);
+
+
+		void clear();
+
+		clock getInterval() const {
+			return interval;
+		}
+
+		clock getSamplesCount() const {
+			return samplesCount;
+		}
+
+		// Record a sample, weighted by the count of intervals it stands for. Stack holds depth
+		// return addresses, the innermost call first.
+		void sample(word pc, const word *stack, size_t depth, const byte *memory, size_t memorySize, clock weight = 1);
+
+
+		// Both are sorted by samples, the hottest first.
+		std::vector<Hotspot> getHotAddresses() const;
+		std::vector<Hotspot> getHotRoutines() const;
+
+		// Tables of hot routines and addresses, up to limit rows each.
+		void writeReport(std::ostream &stream, size_t limit = 20) const;
+
+		// Call stacks folded into "root;routine;...;routine samples" lines,
+		// as flamegraph.pl and compatible tools take them.
+		void writeFolded(std::ostream &stream) const;
+
+	private:
+
+		typedef std::vector<word> Routines;					// Routine entries, the outermost first.
+
+		const clock interval;
+		const word root;
+
+		clock samplesCount;
+
+		std::map<word, clock> addresses;
+		std::map<Routines, clock> stacks;
+
+		Routines scratch;
+
+		static void writeLabel(std::ostream &stream, word address);
+	};
+
+} // namespace chip8
+
+#endif // CHIP8_PROFILER_
@@ -0,0 +1,129 @@
+#pragma once
+
+#ifndef CHIP8_RECOMPILER_
+#define CHIP8_RECOMPILER_
+
+#include "Chip8Base.h"
+
+#include <cstddef>
+
+// Native code generation is only available for x86-64 hosts.
+// Define CHIP8_RECOMPILER=0 to leave it out of the build at all.
+#if !defined(CHIP8_RECOMPILER)
+#if defined(_M_X64) || defined(__x86_64__)
+#define CHIP8_RECOMPILER 1
+#else
+#define CHIP8_RECOMPILER 0
+#endif
+#endif // CHIP8_RECOMPILER
+
+#if CHIP8_RECOMPILER
+
+namespace chip8 {
+
+	// Translates straight-line runs of Chip-8 instructions (basic blocks)
+	// into x86-64 machine code.
+	//
+	// Only register, index and timer read instructions are translated;
+	// a block ends on a jump or skip instruction, which is translated too,
+	// or right before any other instruction, which is left to interpreter.
+	// Generated code never fails, so it has no error paths at all.
+	class Recompiler {
+	public:
+
+		// Addresses of the machine state fields relative to V0.
+		struct Layout {
+			ptrdiff_t index;
+			ptrdiff_t pc;
+			ptrdiff_t timerDelay;
+		};
+
+		struct Block {
+			size_t (*code) (byte *registers);				// Runs the block, stores a new pc and returns cycles taken.
+
+			word length;									// Instructions count, 0 if block can not start here.
+			word size;										// Program bytes covered, 0 if not compiled yet.
+
+			size_t cyclesPrefix;							// Cycles taken by all the instructions, but the last one.
+		};
+
+		// Quirks are InterpreterBase::Quirk flags generated code must honour.
+		Recompiler(const byte *memory, size_t memorySize,
+			word programStart, const Layout &layout, unsigned quirks);
+
+		~Recompiler();
+
+
+		// False, if memory for native code can't be had or made executable,
+		// nothing is compiled then.
+		bool isReady() const {
+			return !!codeBuffer;
+		}
+
+		// Obtain a block starting at address, compile it if necessary.
+		const Block &lookup(word address) {
+			if (address < memorySize && blocks[address].size > 0 && !!codeBuffer) {
+				return blocks[address];
+			}
+			return lookupImpl(address);
+		}
+
+		// Drop the blocks covering address. Must be called on each memory write.
+		void invalidate(size_t address) {
+			if (address < memorySize && coverage[address] > 0) {
+				invalidateImpl(address);
+			}
+		}
+
+		// Drop all the blocks compiled so far.
+		void flush();
+		// Drop all the blocks, compile the further ones for quirks given.
+		void flush(unsigned quirks);
+
+	private:
+
+		Recompiler(const Recompiler&);
+
+
+		enum : size_t {
+			// Shorter blocks are left to interpreter: leaving the dispatcher
+			// for them costs more than native code saves, and a jump to itself
+			// has to be seen by interpreter to be skipped as an idle loop.
+			BLOCK_LENGTH_MIN	= 0x02,
+			BLOCK_LENGTH_MAX	= 0x40,
+			BLOCK_SIZE_MAX		= BLOCK_LENGTH_MAX * 2,
+
+			CODE_BUFFER_SIZE	= 0x40000
+		};
+
+		const byte *memory;
+		const size_t memorySize;
+		const word programStart;
+
+		const Layout layout;
+		unsigned quirks;
+
+		Block *blocks;										// One block per each address.
+		byte *coverage;										// Count of blocks covering each address.
+
+		// Code is written to pages, which are not executable, and gets executable,
+		// but not writable, right after (W^X). Pages past codeUsed stay writable.
+		byte *codeBuffer;
+		size_t codeUsed;
+		size_t pageSize;
+
+		bool protect(size_t begin, size_t end, bool executable);
+		void release();
+
+		const Block &lookupImpl(word address);
+		void invalidateImpl(size_t address);
+		void drop(size_t address);
+
+		bool compile(word address, Block &block);
+	};
+
+} // namespace chip8
+
+#endif // CHIP8_RECOMPILER
+
+#endif // CHIP8_RECOMPILER_
@@ -0,0 +1,112 @@
+#pragma once
+
+#ifndef CHIP8_REWIND_
+#define CHIP8_REWIND_
+
+#include "Chip8Base.h"
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+namespace chip8 {
+
+	// History of interpreter states (see BasicInterpreter::saveState) to step back through.
+	// The newest state is kept as is, each older one as XOR delta to the state after it,
+	// made of the pages that differ only. Deltas live within a ring of the budget size,
+	// the oldest ones are dropped to make room for new ones.
+	class Rewind {
+	public:
+
+		enum : size_t {
+			PAGE_SIZE = 0x100
+		};
+
+		// Snapshot is taken on each interval-th frame.
+		Rewind(size_t budget, unsigned interval = 1);
+
+
+		void clear();
+
+		template <class TInterpreter>
+		void onFrame(const TInterpreter &interpreter) {
+			if (++frames >= interval) {
+				frames = 0;
+
+				push(interpreter);
+			}
+		}
+
+		template <class TInterpreter>
+		bool push(const TInterpreter &interpreter) {
+			const size_t size = interpreter.getStateSize();
+
+			if (scratch.size() < size) {
+				scratch.resize(size);
+			}
+			return interpreter.saveState(scratch.data(), size) && push(scratch.data(), size);
+		}
+
+		// Step back up to count snapshots and load the state reached.
+		// Returns count of steps taken, zero if there's no state to load.
+		template <class TInterpreter>
+		size_t rewind(TInterpreter &interpreter, size_t count) {
+			const size_t steps = rewind(count);
+
+			if (currentSize == 0 || !interpreter.loadState(current.data(), currentSize)) {
+				return 0;
+			}
+			return steps;
+		}
+
+		// Returns false, if the delta doesn't fit the budget, the history is dropped then.
+		bool push(const void *state, size_t size);
+
+		size_t rewind(size_t count);
+
+
+		// The newest state, nullptr if nothing is pushed yet.
+		const void *getState() const {
+			return currentSize > 0 ? current.data() : nullptr;
+		}
+		size_t getStateSize() const {
+			return currentSize;
+		}
+
+		// Count of snapshots to step back through.
+		size_t getDepth() const {
+			return records.size();
+		}
+
+	private:
+
+		Rewind(const Rewind &);
+
+
+		struct Record {
+			size_t offset;									// Delta location within the ring.
+			size_t length;
+			size_t stateSize;								// Size of the state the delta leads to.
+			size_t pagesCount;
+		};
+
+		std::vector<byte> ring;
+		std::deque<Record> records;							// Oldest first.
+
+		size_t tail;										// Ring offset the next delta goes to.
+
+		std::vector<byte> current;							// The newest state, zero padded to a page.
+		size_t currentSize;
+
+		std::vector<byte> scratch;
+		std::vector<size_t> changed;
+
+		const unsigned interval;
+		unsigned frames;
+
+		byte *allocate(size_t length);
+	};
+
+} // namespace chip8
+
+#endif // CHIP8_REWIND_
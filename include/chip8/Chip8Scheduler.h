@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef CHIP8_SCHEDULER_
+#define CHIP8_SCHEDULER_
+
+#include "Chip8Base.h"
+
+#include <cstddef>
+
+namespace chip8 {
+
+	// Queue of events stamped with the machine cycle they are due at.
+	// Events come out earliest first, the ones due at the same cycle
+	// come out in the order they were scheduled.
+	class Scheduler {
+	public:
+
+		enum : size_t {
+			CAPACITY = 0x100
+		};
+
+		struct Event {
+			clock timestamp;								// Machine cycle the event is due at.
+
+			byte kind;										// Meaning of the fields below is up to event owner.
+			byte target;
+			word value;
+		};
+
+		Scheduler();
+
+
+		// Returns false, if the queue is full.
+		bool schedule(const Event &event);
+
+		// Take the earliest event out. The queue must not be empty.
+		Event pop();
+
+		void clear();
+
+		// Copy events out in the order they are due. Returns count of the events.
+		size_t save(Event *events) const;
+
+		// Replace the queue with events given in the order they are due.
+		// Returns false and leaves the queue intact, if they are not, or
+		// if any of them is not valid as told by the owner.
+		bool load(const Event *events, size_t count, bool (*valid) (const Event &));
+
+
+		// Timestamp of the earliest event, or the farthest cycle possible.
+		clock next() const {
+			return count > 0 ? heap[0].event.timestamp : clock(-1);
+		}
+
+		size_t size() const {
+			return count;
+		}
+
+	private:
+
+		struct Entry {
+			Event event;
+
+			clock sequence;									// Keeps the order of events due at the same cycle.
+		};
+
+		Entry heap[CAPACITY];								// Binary min-heap by timestamp, then sequence.
+
+		size_t count;
+		clock sequence;
+
+		static bool precedes(const Entry &a, const Entry &b) {
+			return a.event.timestamp < b.event.timestamp
+				|| (a.event.timestamp == b.event.timestamp && a.sequence < b.sequence);
+		}
+	};
+
+} // namespace chip8
+
+#endif // CHIP8_SCHEDULER_
@@ -0,0 +1,142 @@
+#pragma once
+
+#ifndef CHIP8_TRACE_
+#define CHIP8_TRACE_
+
+#include "Chip8Base.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace chip8 {
+
+	// Instruction trace, see BasicInterpreter::setTracer. Interpreter puts a fixed size
+	// record per instruction into a ring, a writer thread drains the ring into a memory
+	// mapped file. Records are encoded there against the previous ones: pc as a delta,
+	// opcodes already seen at the address and narrow cycle deltas take a byte or nothing.
+	// The ring is single producer single consumer, the producer waits only if it's full.
+	class TraceRecorder {
+	public:
+
+		enum : size_t {
+			CAPACITY_DEFAULT = 0x10000						// Records, a power of 2.
+		};
+
+		enum : byte {
+			TARGET_INDEX	= 0x10,							// Index register, otherwise target is VX index.
+			TARGET_NONE		= 0xFF,
+
+			CARRY_NONE		= 0xFF
+		};
+
+		struct Record {
+			uint32_t cycle;									// Low half of the cycles count after the instruction.
+			word pc;
+			word opcode;
+
+			word value;										// Target value after the instruction.
+			byte target;
+			byte carry;										// VF, if the instruction sets it as a flag.
+		};
+
+		explicit TraceRecorder(size_t capacity = CAPACITY_DEFAULT);
+		~TraceRecorder();
+
+
+		// Create the file and start the writer. Returns false, if the file can't be created.
+		bool open(const char *fileName);
+
+		// Write out what's recorded and close the file. Returns false, if any write failed.
+		bool close();
+
+		bool isOpen() const {
+			return writer.joinable();
+		}
+
+		void record(const Record &record) {
+			if (head - tailCached == ring.size()) {
+				waitRoom();
+			}
+			ring[head & (ring.size() - 1)] = record;
+
+			headShared.store(++head, std::memory_order_release);
+		}
+
+		clock getRecordsCount() const {
+			return head;
+		}
+
+
+		// Turn a trace file into text, a line per instruction:
+		// "<cycle> <pc> <opcode> [V<x>=<value>|I=<value>] [VF=<carry>]". Returns false,
+		// if the stream is not a trace. A trace cut short (by a crash) is decoded up to
+		// the last record written.
+		static bool decode(std::istream &stream, std::ostream &text);
+
+	private:
+
+		TraceRecorder(const TraceRecorder &);
+
+
+		enum : uint32_t {
+			FILE_MAGIC		= 0x52543843,					// "C8TR"
+			FILE_VERSION	= 0x0001
+		};
+
+		// Encoded record header, the fields it flags go in the order of the flags.
+		enum : byte {
+			HEADER_DELTA_BYTE		= 0x00,					// Cycle delta takes 1, 2 or 4 bytes.
+			HEADER_DELTA_WORD		= 0x01,
+			HEADER_DELTA_DWORD		= 0x02,
+			HEADER_DELTA_MASK		= 0x03,
+
+			HEADER_PC_NEXT			= 0x00,					// pc follows the previous one,
+			HEADER_PC_NEAR			= 0x04,					// or is a signed byte away from it,
+			HEADER_PC_FAR			= 0x08,					// or goes as is.
+			HEADER_PC_MASK			= 0x0C,
+
+			HEADER_OPCODE_SEEN		= 0x10,					// Opcode is the last one seen at pc, otherwise it follows.
+			HEADER_TARGET			= 0x20,					// Target and its value (a byte, a word for index) follow.
+			HEADER_CARRY			= 0x40,
+			HEADER_MARK				= 0x80					// Zero bytes of an unfinished file aren't records.
+		};
+
+		enum : size_t {
+			RECORD_ENCODED_MAX	= 13,
+			FILE_HEADER_SIZE	= 8
+		};
+
+		// Producer and consumer positions go on separate cache lines.
+		alignas(64) std::atomic<size_t> headShared;
+		size_t head;
+		size_t tailCached;
+
+		alignas(64) std::atomic<size_t> tailShared;
+		std::atomic<bool> stopping;
+
+		alignas(64) std::vector<Record> ring;
+
+		std::thread writer;
+		bool failed;
+
+		struct MappedFile;
+		MappedFile *file;
+
+		// Writer thread state, see encode().
+		uint32_t cyclePrevious;
+		word pcPrevious;
+		std::vector<word> opcodesSeen;						// The last opcode seen per address, the decoder keeps the same.
+
+		void waitRoom();
+		void drain();
+		size_t encode(const Record *records, size_t count, byte *data);
+	};
+
+} // namespace chip8
+
+#endif // CHIP8_TRACE_
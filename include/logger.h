@@ -3,7 +3,9 @@
 #ifndef LOGGER_H_
 #define LOGGER_H_
 
+#include <cstdarg>
 #include <string>
+#include <type_traits>
 
 
 #ifdef _DEBUG
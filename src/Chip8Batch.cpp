@@ -0,0 +1,216 @@
+#include "chip8/Chip8Batch.h"
+#include "chip8/Chip8Display.h"
+#include "chip8/Chip8InterpreterImpl.h"
+
+#include <cassert>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace chip8 {
+
+	namespace {
+
+		typedef BasicInterpreter<PackedDisplay, NullKeyPad, FastAccess> BatchInterpreter;
+
+		struct Instance {
+			PackedDisplay display;
+			BatchInterpreter interpreter;
+
+			size_t job;
+			size_t keyNext;									// The first key not scheduled yet.
+			size_t keyPending;								// The first key not fired yet.
+
+			Instance(NullKeyPad *keyPad)
+				: interpreter(&display, keyPad) {
+
+				/* Nothing to do */
+			}
+		};
+
+		struct WorkQueue {
+			std::mutex mutex;
+			std::deque<size_t> jobs;
+		};
+
+		struct Context {
+			const Batch::Job *jobs;
+			Batch::Result *results;
+
+			std::vector<WorkQueue> *queues;
+
+			clock slice;
+			size_t instancesPerWorker;
+		};
+
+		// Keys scheduled ahead are limited, so that interpreter's own events always fit.
+		const size_t KEYS_IN_FLIGHT = Scheduler::CAPACITY / 2;
+
+
+		// Take the newest job from the own queue, or steal the oldest one from the others.
+		bool take(Context &context, size_t id, size_t &job) {
+			std::vector<WorkQueue> &queues = *context.queues;
+
+			for (size_t i = 0; i < queues.size(); ++i) {
+				WorkQueue &queue = queues[(id + i) % queues.size()];
+				std::lock_guard<std::mutex> lock(queue.mutex);
+
+				if (queue.jobs.empty()) {
+					continue;
+				}
+				if (i == 0) {
+					job = queue.jobs.back();
+					queue.jobs.pop_back();
+				}
+				else {
+					job = queue.jobs.front();
+					queue.jobs.pop_front();
+				}
+				return true;
+			}
+			return false;
+		}
+
+		void start(Context &context, Instance &instance, size_t job) {
+			instance.job = job;
+			instance.keyNext = 0;
+			instance.keyPending = 0;
+
+			// Instances are reused, so nothing is left to the one taking the job.
+			instance.interpreter.setQuirks(context.jobs[job].quirks);
+			instance.interpreter.setSeed(context.jobs[job].seed);
+			instance.interpreter.reset(context.jobs[job].program, context.jobs[job].programSize);
+		}
+
+		// Returns false, once the job is done. Slices end on the first instruction boundary past
+		// their budget, so that the job ends on the same cycle, whatever the slice is.
+		bool advance(Context &context, Instance &instance) {
+			const Batch::Job &job = context.jobs[instance.job];
+			BatchInterpreter &interpreter = instance.interpreter;
+
+			const clock cycles = interpreter.getCyclesCount();
+			if (!interpreter.isOk() || cycles >= job.cycles) {
+				return false;
+			}
+
+			while (instance.keyPending < instance.keyNext && job.keys[instance.keyPending].timestamp <= cycles) {
+				++instance.keyPending;
+			}
+			while (instance.keyNext < job.keysCount && instance.keyNext - instance.keyPending < KEYS_IN_FLIGHT
+				&& interpreter.scheduleKeys(job.keys[instance.keyNext].timestamp, job.keys[instance.keyNext].keys)) {
+
+				++instance.keyNext;
+			}
+			interpreter.run(std::min(context.slice, job.cycles - cycles));
+
+			return interpreter.isOk() && interpreter.getCyclesCount() < job.cycles;
+		}
+
+		void finish(Context &context, Instance &instance, std::vector<byte> &frame) {
+			Batch::Result &result = context.results[instance.job];
+
+			frame.resize(instance.display.area());
+			instance.display.unpack(frame.data());
+
+			result.frameHash = Batch::hashFrame(frame.data(), frame.size());
+			result.cycles = instance.interpreter.getCyclesCount();
+			result.error = instance.interpreter.getLastError();
+		}
+
+		void work(Context &context, size_t id) {
+			NullKeyPad keyPad;
+			std::vector<byte> frame;
+
+			std::vector<std::unique_ptr<Instance>> instances;
+			std::vector<Instance *> idle;
+			std::vector<Instance *> active;
+
+			for (bool starving = false; ; ) {
+				// Jobs are never queued once started, so there's nothing to wait for
+				// when all the queues are empty.
+				while (!starving && active.size() < context.instancesPerWorker) {
+					size_t job;
+
+					if (!take(context, id, job)) {
+						starving = true;
+						break;
+					}
+					if (idle.empty()) {
+						instances.emplace_back(new Instance(&keyPad));
+						idle.push_back(instances.back().get());
+					}
+					Instance *instance = idle.back();
+					idle.pop_back();
+
+					start(context, *instance, job);
+					active.push_back(instance);
+				}
+				if (active.empty()) {
+					break;
+				}
+
+				for (size_t i = 0; i < active.size(); ) {
+					if (advance(context, *active[i])) {
+						++i;
+						continue;
+					}
+					finish(context, *active[i], frame);
+
+					idle.push_back(active[i]);
+					active[i] = active.back();
+					active.pop_back();
+				}
+			}
+		}
+
+	} // namespace
+
+
+	Batch::Batch(size_t workersCount, clock slice, size_t instancesPerWorker)
+		: workersCount(workersCount), slice(slice), instancesPerWorker(instancesPerWorker) {
+
+		if (this->workersCount == 0) {
+			this->workersCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		}
+		assert(slice > 0);
+		assert(instancesPerWorker > 0);
+	}
+
+
+	void Batch::run(const Job *jobs, size_t count, Result *results) {
+		assert(jobs || count == 0);
+		assert(results || count == 0);
+
+		std::vector<WorkQueue> queues(workersCount);
+
+		for (size_t job = 0; job < count; ++job) {
+			queues[job % workersCount].jobs.push_back(job);
+		}
+		Context context = { jobs, results, &queues, slice, instancesPerWorker };
+
+		std::vector<std::thread> workers;
+		for (size_t id = 1; id < workersCount; ++id) {
+			workers.emplace_back(work, std::ref(context), id);
+		}
+		work(context, 0);
+
+		for (auto &worker : workers) {
+			worker.join();
+		}
+	}
+
+
+	uint64_t Batch::hashFrame(const byte *frame, size_t size) {
+		uint64_t hash = 0xCBF29CE484222325ULL;
+
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ frame[i]) * 0x100000001B3ULL;
+		}
+		return hash;
+	}
+
+} // namespace chip8
@@ -1,28 +1,33 @@
-#include "chip8\Chip8Display.h"
+#include "chip8/Chip8Display.h"
 
 #include <cassert>
+#include <cstring>
 
 
 namespace chip8 {
 
-	void DisplayBase::validate() {
-		invalid = false;
+	DisplayBase::DisplayBase() {
+		validate();
 	}
 
-	void DisplayBase::invalidate() {
+
+	void DisplayBase::validate() {
 		invalidArea.x = 0;
 		invalidArea.y = 0;
-		invalidArea.w = width();
-		invalidArea.h = height();
+		invalidArea.w = 0;
+		invalidArea.h = 0;
 
-		invalid = true;
+		invalidLines = 0;
+		invalid = false;
+	}
+
+	void DisplayBase::invalidate() {
+		invalidate(0, 0, width(), height());
 	}
 	void DisplayBase::invalidate(byte x, byte y, byte w, byte h) {
-		invalidArea.x = x;
-		invalidArea.y = y;
-		invalidArea.w = w;
-		invalidArea.h = h;
+		uniteArea(invalidArea, x, y, w, h);
 
+		invalidLines |= linesMask(y, h);
 		invalid = true;
 	}
 
@@ -31,6 +36,10 @@ namespace chip8 {
 		r = invalidArea;
 	}
 
+	uint64_t DisplayBase::getInvalidLines() const {
+		return invalidLines;
+	}
+
 	bool DisplayBase::isInvalid() const {
 		return invalid;
 	}
@@ -40,6 +49,8 @@ namespace chip8 {
 		: w(width), h(height), a(width * height) {
 
 		assert(a > 0);
+		assert(height <= LINES_TRACKED);
+
 		buffer = new byte[a];
 	}
 
@@ -48,21 +59,88 @@ namespace chip8 {
 	}
 
 
-	word DefaultDisplay::area() const {
-		return a;
+	void DefaultDisplay::clear() {
+		memset(buffer, 0x00, a);
 	}
 
-	byte DefaultDisplay::width() const {
-		return w;
+	void DefaultDisplay::unpack(byte *frame) const {
+		memcpy(frame, buffer, a);
 	}
 
-	byte DefaultDisplay::height() const {
-		return h;
+	void DefaultDisplay::load(const byte *frame) {
+		memcpy(buffer, frame, a);
 	}
 
 
-	byte *DefaultDisplay::getLine(byte index, byte offset) {
-		return buffer + index * w + offset;
+	namespace {
+
+		// Byte per pixel images of all the 8 pixels sets.
+		struct PixelsExpansion {
+			byte value[0x100][8];
+
+			PixelsExpansion() {
+				for (size_t bits = 0; bits < 0x100; ++bits) {
+					for (size_t column = 0; column < 8; ++column) {
+						value[bits][column] = !!(bits & (0x80 >> column)) ? 0xFF : 0x00;
+					}
+				}
+			}
+		};
+
+		const PixelsExpansion pixelsExpansion;
+
+	} // namespace
+
+
+	PackedDisplay::PackedDisplay(byte width, byte height)
+		: w(width), h(height), a(width * height), stride(width / WORD_PIXELS) {
+
+		assert(a > 0);
+		assert(height <= LINES_TRACKED);
+		assert(width % WORD_PIXELS == 0);
+
+		buffer = new uint64_t[stride * height];
+		clear();
+	}
+
+	PackedDisplay::~PackedDisplay() {
+		delete[] buffer;
+	}
+
+
+	void PackedDisplay::clear() {
+		memset(buffer, 0x00, stride * h * sizeof(uint64_t));
+	}
+
+	void PackedDisplay::unpack(byte *frame) const {
+		for (byte index = 0; index < h; ++index, frame += w) {
+			unpackLine(index, frame);
+		}
+	}
+
+	void PackedDisplay::unpackLine(byte index, byte *line) const {
+		const uint64_t *words = getPackedLine(index);
+
+		for (size_t i = 0; i < stride; ++i) {
+			for (size_t shift = WORD_PIXELS; shift > 0; line += 8) {
+				shift -= 8;
+				memcpy(line, pixelsExpansion.value[byte(words[i] >> shift)], 8);
+			}
+		}
+	}
+
+	void PackedDisplay::load(const byte *frame) {
+		uint64_t *words = buffer;
+
+		for (size_t i = 0, count = stride * h; i < count; ++i) {
+			uint64_t value = 0;
+
+			for (size_t column = 0; column < WORD_PIXELS; ++column) {
+				value = (value << 1) | (frame[column] != 0x00 ? 1 : 0);
+			}
+			words[i] = value;
+			frame += WORD_PIXELS;
+		}
 	}
 
 } // namespace chip8
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include "chip8/Chip8Executor.h"
+
+#include <cstdint>
+
+
+namespace chip8 {
+
+	static_assert((Executor::CAPACITY & (Executor::CAPACITY - 1)) == 0, "Capacity must be a power of 2");
+
+	Executor::Executor(std::function<void()> step)
+		: tail(0), head(0), running(false), stopping(false), signaled(false), sleeping(false), step(std::move(step)) {
+
+		for (size_t i = 0; i < CAPACITY; ++i) {
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		worker = std::thread(&Executor::loop, this);
+	}
+
+	Executor::~Executor() {
+		stopping.store(true, std::memory_order_release);
+		notify();
+
+		worker.join();
+
+		// Tasks the worker didn't get to are dropped.
+		while (isPending()) {
+			Slot &slot = slots[head & (CAPACITY - 1)];
+
+			slot.discard(slot.storage);
+			slot.sequence.store(head + CAPACITY, std::memory_order_release);
+			++head;
+		}
+	}
+
+
+	Executor::Slot *Executor::claim() {
+		size_t position = tail.load(std::memory_order_relaxed);
+
+		for (;;) {
+			Slot *slot = &slots[position & (CAPACITY - 1)];
+			const intptr_t lag = intptr_t(slot->sequence.load(std::memory_order_acquire)) - intptr_t(position);
+
+			if (lag == 0) {
+				if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					return slot;
+				}
+			}
+			// The slot still holds a task from the previous lap.
+			else if (lag < 0) {
+				return nullptr;
+			}
+			// Another producer took the position.
+			else {
+				position = tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	void Executor::publish(Slot *slot) {
+		slot->sequence.store(slot->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+		notify();
+	}
+
+	void Executor::notify() {
+		// Pairs with the fence in waitUntil(): either the worker sees what's published,
+		// or this sees it sleeping.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (sleeping.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> lock(mutex);
+
+			wakeup.notify_one();
+		}
+	}
+
+
+	void Executor::pause() {
+		running.store(false, std::memory_order_release);
+		signaled.store(true, std::memory_order_release);
+
+		notify();
+	}
+
+	void Executor::resume() {
+		running.store(true, std::memory_order_release);
+		signaled.store(true, std::memory_order_release);
+
+		notify();
+	}
+
+
+	bool Executor::isPending() const {
+		return slots[head & (CAPACITY - 1)].sequence.load(std::memory_order_acquire) == head + 1;
+	}
+
+	bool Executor::isIdle() const {
+		return !isPending() && !signaled.load(std::memory_order_acquire)
+			&& !stopping.load(std::memory_order_acquire);
+	}
+
+	bool Executor::waitUntil(Clock::time_point deadline) {
+		if (isIdle()) {
+			std::unique_lock<std::mutex> lock(mutex);
+
+			sleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			while (isIdle()) {
+				// No deadline is waited for a day at a time, as time_point::max() overflows
+				// within some implementations.
+				const Clock::time_point until = deadline == Clock::time_point::max()
+					? Clock::now() + std::chrono::hours(24) : deadline;
+
+				if (wakeup.wait_until(lock, until) == std::cv_status::timeout && until == deadline) {
+					break;
+				}
+			}
+			sleeping.store(false, std::memory_order_relaxed);
+		}
+		const bool result = !isIdle();
+
+		// Pause or resume is seen by the caller, as it checks isPaused() next.
+		signaled.exchange(false, std::memory_order_acq_rel);
+
+		return result;
+	}
+
+
+	size_t Executor::drain() {
+		size_t result = 0;
+
+		while (isPending()) {
+			Slot &slot = slots[head & (CAPACITY - 1)];
+
+			slot.perform(slot.storage);
+			slot.sequence.store(head + CAPACITY, std::memory_order_release);
+
+			++head;
+			++result;
+		}
+		return result;
+	}
+
+	void Executor::loop() {
+		while (!stopping.load(std::memory_order_acquire)) {
+			drain();
+
+			if (!isPaused() && !!step) {
+				step();
+			}
+			else if (!isPending()) {
+				waitUntil(Clock::time_point::max());
+			}
+		}
+	}
+
+} // namespace chip8
@@ -0,0 +1,111 @@
+#include "chip8/Chip8FrameChannel.h"
+
+#include <cassert>
+#include <cstring>
+
+
+namespace chip8 {
+
+	FrameChannel::FrameChannel(byte width, byte height)
+		: w(width), h(height), a(width * height) {
+
+		assert(a > 0);
+		assert(height <= LINES_TRACKED);
+
+		buffer = new byte[a * PLANES_COUNT];
+		memset(buffer, 0x00, a * PLANES_COUNT);
+
+		for (unsigned i = 0; i < PLANES_COUNT; ++i) {
+			planes[i].buffer = buffer + i * a;
+			planes[i].sequence = 0;
+
+			for (unsigned j = 0; j < PLANES_COUNT; ++j) {
+				planes[i].linesSince[j] = 0;
+			}
+			linesPending[i] = 0;
+		}
+		back = 0;
+		drawing = planes[back].buffer;
+		sequence = 0;
+		linesDrawn = 0;
+		linesCopied = 0;
+
+		middle.store(1, std::memory_order_relaxed);
+
+		front = 2;
+		linesChanged = 0;
+	}
+
+	FrameChannel::~FrameChannel() {
+		delete[] buffer;
+	}
+
+
+	void FrameChannel::clear() {
+		memset(drawing, 0x00, a);
+
+		linesDrawn = linesMask(0, h);
+	}
+
+	void FrameChannel::unpack(byte *frame) const {
+		memcpy(frame, drawing, a);
+	}
+
+	void FrameChannel::load(const byte *frame) {
+		memcpy(drawing, frame, a);
+
+		linesDrawn = linesMask(0, h);
+	}
+
+
+	void FrameChannel::publish() {
+		Plane &plane = planes[back];
+		const unsigned published = back;
+
+		plane.sequence = ++sequence;
+
+		for (unsigned i = 0; i < PLANES_COUNT; ++i) {
+			linesPending[i] = i == published ? 0 : linesPending[i] | linesDrawn;
+			plane.linesSince[i] = linesPending[i];
+		}
+		linesDrawn = 0;
+
+		back = middle.exchange(published | PLANE_FRESH, std::memory_order_acq_rel) & PLANE_INDEX;
+		drawing = planes[back].buffer;
+
+		// Published frame is not written to any more, so it's safe to read, while
+		// the consumer may read it too. Runs of lines go by a copy each.
+		uint64_t lines = linesPending[back];
+		for (byte y = 0; !!lines; ) {
+			if (!(lines & 0x01)) {
+				lines >>= 1;
+				++y;
+				continue;
+			}
+			byte count = 0;
+			for (; !!(lines & 0x01); lines >>= 1) {
+				++count;
+			}
+			memcpy(drawing + y * w, plane.buffer + y * w, count * w);
+
+			linesCopied += count;
+			y += count;
+		}
+		linesPending[back] = 0;
+	}
+
+
+	bool FrameChannel::acquire() {
+		// Only acquire() clears the flag, so the plane is still there to take.
+		if (!(middle.load(std::memory_order_relaxed) & PLANE_FRESH)) {
+			return false;
+		}
+		const unsigned latest = middle.exchange(front, std::memory_order_acq_rel) & PLANE_INDEX;
+
+		linesChanged = planes[latest].linesSince[front];
+		front = latest;
+
+		return true;
+	}
+
+} // namespace chip8
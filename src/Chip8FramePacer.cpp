@@ -0,0 +1,118 @@
+#include "chip8/Chip8FramePacer.h"
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+
+namespace chip8 {
+
+	// Spin margin bounds and the one to start with, before any sleep is measured.
+#define PACER_MARGIN_MIN std::chrono::microseconds(200)
+#define PACER_MARGIN_INITIAL std::chrono::milliseconds(2)
+
+	// Margin covers the mean oversleep and that many mean deviations of it,
+	// both follow samples by PACER_CALIBRATION_WEIGHT each.
+#define PACER_MARGIN_DEVIATIONS 4.0
+#define PACER_CALIBRATION_WEIGHT 0.125
+
+	FramePacer::FramePacer(unsigned rate, TimeSource timeSource)
+		: rate(rate), period(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(1000000000 / rate))),
+		timeSource(std::move(timeSource)) {
+
+		assert(rate > 0);
+
+		margin = std::min<Clock::duration>(PACER_MARGIN_INITIAL, period);
+		oversleepMean = 0.0;
+		oversleepDeviation = 0.0;
+
+		stats = Stats();
+		restart();
+	}
+
+
+	void FramePacer::restart() {
+		origin = timeSource();
+		frame = 0;
+	}
+
+	FramePacer::Clock::time_point FramePacer::deadline() const {
+		// Whole seconds and the frames past them go apart, so that periods don't round off.
+		const std::chrono::nanoseconds offset = std::chrono::seconds(frame / rate)
+			+ std::chrono::nanoseconds((frame % rate) * 1000000000 / rate);
+
+		return origin + std::chrono::duration_cast<Clock::duration>(offset);
+	}
+
+	void FramePacer::calibrate(Clock::duration oversleep) {
+		const double sample = double(std::chrono::duration_cast<std::chrono::nanoseconds>(oversleep).count());
+
+		oversleepMean += (sample - oversleepMean) * PACER_CALIBRATION_WEIGHT;
+		oversleepDeviation += (std::fabs(sample - oversleepMean) - oversleepDeviation) * PACER_CALIBRATION_WEIGHT;
+
+		const Clock::duration estimate = std::chrono::duration_cast<Clock::duration>(
+			std::chrono::nanoseconds(clock(oversleepMean + PACER_MARGIN_DEVIATIONS * oversleepDeviation)));
+
+		margin = std::min<Clock::duration>(std::max<Clock::duration>(estimate, PACER_MARGIN_MIN), period);
+	}
+
+
+	bool FramePacer::wait() {
+		return wait([](Clock::time_point time) {
+			std::this_thread::sleep_until(time);
+
+			return false;
+		});
+	}
+
+	bool FramePacer::wait(const Sleeper &sleeper) {
+		Clock::time_point now = timeSource();
+		Clock::time_point due = deadline();
+
+		// Frames missed after a pause or a stall are not run in a burst.
+		if (now - due > period * LAG_MAX) {
+			++stats.restarts;
+
+			origin = now;
+			frame = 0;
+			due = now;
+		}
+		else if (now >= due) {
+			++stats.late;
+		}
+
+		const Clock::time_point wake = due - margin;
+		if (now < wake) {
+			const bool woken = sleeper(wake);
+			const Clock::time_point woke = timeSource();
+
+			stats.slept += woke - now;
+			now = woke;
+
+			if (woken) {
+				return false;
+			}
+			calibrate(woke - wake);
+		}
+
+		const Clock::time_point spinning = now;
+		while (now < due) {
+			std::this_thread::yield();
+
+			now = timeSource();
+		}
+		stats.spun += now - spinning;
+
+		const Clock::duration jitter = now - due;
+		stats.jitterTotal += jitter;
+		stats.jitterMax = std::max<Clock::duration>(stats.jitterMax, jitter);
+
+		++stats.frames;
+		++frame;
+
+		return true;
+	}
+
+} // namespace chip8
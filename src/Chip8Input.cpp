@@ -0,0 +1,93 @@
+#include "chip8/Chip8Input.h"
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+
+namespace chip8 {
+
+	InputLog::InputLog() {
+		clear(0, 0);
+	}
+
+
+	void InputLog::clear(word seed, unsigned quirks) {
+		this->seed = seed;
+		this->quirks = quirks;
+		cycles = 0;
+
+		entries.clear();
+	}
+
+	void InputLog::record(clock timestamp, PadKeys keys) {
+		while (!entries.empty() && entries.back().timestamp >= timestamp) {
+			entries.pop_back();
+		}
+		if (keys != getKeys()) {
+			Entry entry = { timestamp, keys };
+			entries.push_back(entry);
+		}
+	}
+
+
+	bool InputLog::write(std::ostream &stream) const {
+		stream << "C8IN " << VERSION << std::endl
+			<< "seed " << seed << std::endl
+			<< "quirks " << quirks << std::endl
+			<< "cycles " << cycles << std::endl;
+
+		stream << std::hex << std::uppercase << std::setfill('0');
+		for (const Entry &entry : entries) {
+			stream << std::dec << entry.timestamp << ' '
+				<< std::hex << std::setw(4) << entry.keys << std::endl;
+		}
+		stream << std::dec << std::nouppercase << std::setfill(' ');
+
+		return !!stream;
+	}
+
+	bool InputLog::read(std::istream &stream) {
+		std::string magic;
+		unsigned version = 0;
+
+		if (!(stream >> magic >> version) || magic != "C8IN" || version != VERSION) {
+			return false;
+		}
+
+		InputLog log;
+		std::string seedKey, quirksKey, cyclesKey;
+
+		if (!(stream >> seedKey >> log.seed >> quirksKey >> log.quirks >> cyclesKey >> log.cycles)
+			|| seedKey != "seed" || quirksKey != "quirks" || cyclesKey != "cycles") {
+
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(stream, line)) {
+			std::istringstream fields(line);
+			Entry entry;
+			unsigned keys = 0;
+
+			if (!(fields >> entry.timestamp)) {
+				// Blank lines are skipped.
+				if (line.find_first_not_of(" \t\r") != std::string::npos) {
+					return false;
+				}
+				continue;
+			}
+			if (!(fields >> std::hex >> keys) || keys > 0xFFFF
+				|| (!log.entries.empty() && entry.timestamp <= log.entries.back().timestamp)) {
+
+				return false;
+			}
+			entry.keys = PadKeys(keys);
+			log.entries.push_back(entry);
+		}
+
+		*this = log;
+		return true;
+	}
+
+} // namespace chip8
@@ -0,0 +1,1017 @@
+#include "chip8/Chip8Lockstep.h"
+#include "chip8/Chip8Cycles.h"
+#include "chip8/Chip8InterpreterImpl.h"
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+
+namespace chip8 {
+
+#define LOCKSTEP_TEMPLATE template <size_t LANES>
+#define LOCKSTEP_CLASS Lockstep<LANES>
+
+#define FOR_EACH_LANE(lane) for (size_t lane = 0; lane < LANES; ++lane)
+
+	// Lane keeps its value, unless it executes the instruction.
+#define SELECT(lane, value, other) (!!group[lane] ? (value) : (other))
+
+#define FONT_SYMBOL_HEIGHT 5
+
+#define PROGRAM_COUNTER_STEP word(sizeof(Opcode))
+
+	// Program counter none of the lanes is fetched at.
+#define ADDRESS_NONE word(0xFFFF)
+
+	// Count of key await passes to take the cycles given.
+#define PASSES_TO(cycles) ((cycles) / COUNT_CYCLES_KEY_AWAIT_PASS + ((cycles) % COUNT_CYCLES_KEY_AWAIT_PASS != 0 ? 1 : 0))
+
+	LOCKSTEP_TEMPLATE
+	LOCKSTEP_CLASS::Lockstep(size_t memorySize, byte width, byte height)
+		: quirks(QUIRK_NONE), quirksActive(QUIRK_NONE), memorySize(memorySize),
+		instructionCache((memorySize + 1) / 2), codeWritten(memorySize, 0x00) {
+
+		assert(memorySize > OFFSET_PROGRAM_START);
+		memory = new byte[LANES * memorySize];
+		schedulers = new Scheduler[LANES];
+
+		FOR_EACH_LANE(lane) {
+			displays[lane] = new PackedDisplay(width, height);
+
+			memset(laneMemory(lane), 0x00, memorySize);
+			memcpy(laneMemory(lane), font, sizeof(font));
+
+			rndSeed[lane] = word(lane);
+			resetLane(lane);
+		}
+		countSteps = 0;
+		countLaneSteps = 0;
+
+		scalarDisplay = new PackedDisplay(width, height);
+		scalar = new LaneInterpreter(scalarDisplay, &keyPad, ALU_PROFILE_ORIGINAL, memorySize);
+	}
+
+	LOCKSTEP_TEMPLATE
+	LOCKSTEP_CLASS::~Lockstep() {
+		FOR_EACH_LANE(lane) {
+			delete displays[lane];
+		}
+		delete scalar;
+		delete scalarDisplay;
+
+		delete[] schedulers;
+		delete[] memory;
+	}
+
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::setQuirks(unsigned quirks) {
+		assert(quirks < QUIRKS_COUNT);
+		this->quirks = quirks & (QUIRKS_COUNT - 1);
+	}
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::setSeed(size_t lane, word seed) {
+		assert(lane < LANES);
+		rndSeed[lane] = seed;
+	}
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::resetLane(size_t lane) {
+		for (size_t i = 0; i < REGISTERS_COUNT; ++i) {
+			registers[i][lane] = 0;
+		}
+		for (size_t i = 0; i < STACK_DEPTH; ++i) {
+			stack[i][lane] = 0;
+		}
+		timers[TIMER_DELAY][lane] = 0;
+		timers[TIMER_SOUND][lane] = 0;
+
+		countCycles[lane] = 0;
+
+		schedulers[lane].clear();
+		scheduleEvent(lane, COUNT_CYCLES_TIMER_TICK, EVENT_TIMER_TICK, 0, 0);
+		keysScheduled[lane] = KEY_NONE;
+
+		sp[lane] = STACK_DEPTH;
+		keyHaltRegister[lane] = STATE_KEY_HALT_UNSET;
+
+		index[lane] = 0;
+		pc[lane] = OFFSET_PROGRAM_START;
+		kb[lane] = KEY_NONE;
+
+		displays[lane]->clear();
+		displays[lane]->invalidate();
+
+		lastError[lane] = INTERPRETER_ERROR_NO_PROGRAM;
+	}
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::reset(const byte *prg, size_t prgLen) {
+		assert(prg);
+		quirksActive = quirks;
+
+		// Program is loaded the way BasicInterpreter::reset() does it.
+		Error error = INTERPRETER_ERROR_NO_PROGRAM;
+		size_t count = 0;
+
+		if (prgLen > 0) {
+			error = INTERPRETER_ERROR_OK;
+
+			if (prgLen < sizeof(Opcode)) {
+				error = INTERPRETER_ERROR_PROGRAM_TOO_SMALL;
+			}
+			else if (prgLen > memorySize - OFFSET_PROGRAM_START) {
+				error = INTERPRETER_ERROR_PROGRAM_TOO_LARGE;
+			}
+			if (error == INTERPRETER_ERROR_OK) {
+				count = prgLen;
+			}
+		}
+		std::fill(codeWritten.begin(), codeWritten.end(), 0x00);
+
+		FOR_EACH_LANE(lane) {
+			resetLane(lane);
+
+			byte *clientMemory = laneMemory(lane) + OFFSET_PROGRAM_START;
+
+			memcpy(clientMemory, prg, count);
+			memset(clientMemory + count, 0x00, memorySize - OFFSET_PROGRAM_START - count);
+
+			lastError[lane] = byte(error);
+		}
+	}
+
+
+	// ========================================================
+	// state saving
+	// ========================================================
+
+	LOCKSTEP_TEMPLATE
+	size_t LOCKSTEP_CLASS::getStateSize(size_t lane) const {
+		return stateSize(schedulers[lane].size(), memorySize, displays[lane]->area());
+	}
+
+	LOCKSTEP_TEMPLATE
+	bool LOCKSTEP_CLASS::saveState(size_t lane, void *buffer, size_t size) const {
+		assert(lane < LANES);
+		assert(buffer);
+		if (size < getStateSize(lane)) {
+			return false;
+		}
+		byte *data = static_cast<byte *>(buffer);
+		State &state = *reinterpret_cast<State *>(data);
+
+		const PackedDisplay &display = *displays[lane];
+
+		state.magic = STATE_MAGIC;
+		state.version = STATE_VERSION;
+		state.quirks = word(quirksActive);
+
+		state.memorySize = uint32_t(memorySize);
+		state.frameWidth = display.width();
+		state.frameHeight = display.height();
+		state.eventsCount = word(schedulers[lane].save(reinterpret_cast<Scheduler::Event *>(data + stateOffsetEvents(memorySize, display.area()))));
+
+		state.countCycles = countCycles[lane];
+
+		state.pc = pc[lane];
+		state.index = index[lane];
+		state.sp = sp[lane];
+		state.kb = kb[lane];
+		state.rndSeed = rndSeed[lane];
+		state.keysScheduled = keysScheduled[lane];
+
+		state.keyHaltRegister = keyHaltRegister[lane];
+		state.lastError = lastError[lane];
+		state.timers[TIMER_DELAY] = timers[TIMER_DELAY][lane];
+		state.timers[TIMER_SOUND] = timers[TIMER_SOUND][lane];
+
+		for (size_t i = 0; i < REGISTERS_COUNT; ++i) {
+			state.registers[i] = registers[i][lane];
+		}
+		for (size_t i = 0; i < STACK_DEPTH; ++i) {
+			state.stack[i] = stack[i][lane];
+		}
+
+		memcpy(data + stateOffsetMemory(), laneMemory(lane), memorySize);
+		display.unpack(data + stateOffsetFrame(memorySize));
+
+		return true;
+	}
+
+	LOCKSTEP_TEMPLATE
+	bool LOCKSTEP_CLASS::loadState(size_t lane, const void *buffer, size_t size) {
+		assert(lane < LANES);
+		assert(buffer);
+		if (size < sizeof(State)) {
+			return false;
+		}
+		const byte *data = static_cast<const byte *>(buffer);
+		const State &state = *reinterpret_cast<const State *>(data);
+
+		const PackedDisplay &display = *displays[lane];
+
+		if (state.magic != STATE_MAGIC || state.version != STATE_VERSION
+			|| state.memorySize != memorySize
+			|| state.frameWidth != display.width() || state.frameHeight != display.height()
+			|| size < stateSize(state.eventsCount, state.memorySize, display.area())) {
+
+			return false;
+		}
+		if (state.quirks != quirksActive || state.sp > STACK_DEPTH
+			|| (state.keyHaltRegister != STATE_KEY_HALT_UNSET && state.keyHaltRegister >= REGISTERS_COUNT)
+			|| state.lastError > INTERPRETER_ERROR_UNEXPECTED) {
+
+			return false;
+		}
+		if (!loadLane(lane, data)) {
+			return false;
+		}
+		std::fill(codeWritten.begin(), codeWritten.end(), 0x01);
+
+		return true;
+	}
+
+	LOCKSTEP_TEMPLATE
+	bool LOCKSTEP_CLASS::loadLane(size_t lane, const byte *data) {
+		const State &state = *reinterpret_cast<const State *>(data);
+		PackedDisplay &display = *displays[lane];
+
+		if (!schedulers[lane].load(reinterpret_cast<const Scheduler::Event *>(data + stateOffsetEvents(memorySize, display.area())), state.eventsCount, &isStateEvent)) {
+			return false;
+		}
+		eventsNext[lane] = schedulers[lane].next();
+
+		countCycles[lane] = state.countCycles;
+
+		pc[lane] = state.pc;
+		index[lane] = state.index;
+		sp[lane] = state.sp;
+		kb[lane] = state.kb;
+		rndSeed[lane] = state.rndSeed;
+		keysScheduled[lane] = state.keysScheduled;
+
+		keyHaltRegister[lane] = state.keyHaltRegister;
+		lastError[lane] = state.lastError;
+		timers[TIMER_DELAY][lane] = state.timers[TIMER_DELAY];
+		timers[TIMER_SOUND][lane] = state.timers[TIMER_SOUND];
+
+		for (size_t i = 0; i < REGISTERS_COUNT; ++i) {
+			registers[i][lane] = state.registers[i];
+		}
+		for (size_t i = 0; i < STACK_DEPTH; ++i) {
+			stack[i][lane] = state.stack[i];
+		}
+
+		memcpy(laneMemory(lane), data + stateOffsetMemory(), memorySize);
+
+		display.load(data + stateOffsetFrame(memorySize));
+		display.invalidate();
+
+		return true;
+	}
+
+
+	// ========================================================
+	// cycle driven events (see BasicInterpreter)
+	// ========================================================
+
+	LOCKSTEP_TEMPLATE
+	bool LOCKSTEP_CLASS::scheduleKeys(size_t lane, clock timestamp, PadKeys keys) {
+		assert(lane < LANES);
+		Scheduler::Event event = { timestamp, EVENT_KEYS, 0, keys };
+
+		if (schedulers[lane].size() + EVENTS_RESERVED >= Scheduler::CAPACITY || !schedulers[lane].schedule(event)) {
+			return false;
+		}
+		eventsNext[lane] = schedulers[lane].next();
+
+		return true;
+	}
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::scheduleEvent(size_t lane, clock timestamp, byte kind, byte target, word value) {
+		Scheduler::Event event = { timestamp, kind, target, value };
+
+		if (!schedulers[lane].schedule(event)) {
+			assert(false);
+		}
+		eventsNext[lane] = schedulers[lane].next();
+	}
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::dispatchEvents(size_t lane) {
+		Scheduler &scheduler = schedulers[lane];
+
+		while (scheduler.next() <= countCycles[lane]) {
+			Scheduler::Event event = scheduler.pop();
+
+			switch (event.kind) {
+			case EVENT_TIMER_TICK:
+				for (size_t timer = TIMER_DELAY; timer <= TIMER_SOUND; ++timer) {
+					if (timers[timer][lane] > 0) {
+						timers[timer][lane]--;
+					}
+				}
+				event.timestamp += COUNT_CYCLES_TIMER_TICK;
+				scheduler.schedule(event);
+				break;
+
+			case EVENT_TIMER_SET:
+				// Sound timer values below 2 are ignored by COSMAC VIP.
+				timers[event.target][lane] = (event.target != TIMER_SOUND || event.value > 1) ? byte(event.value) : 0;
+				break;
+
+			case EVENT_KEYS:
+				keysScheduled[lane] = event.value;
+
+				if (keyHaltRegister[lane] == STATE_KEY_HALT_UNSET) {
+					kb[lane] = keysScheduled[lane];
+				}
+				break;
+			}
+		}
+		eventsNext[lane] = scheduler.next();
+	}
+
+
+	// The part of BasicInterpreter::doCycle() done while a key is awaited.
+	// Its cycles are counted along with the instruction, which follows
+	// in the same pass, if the key gets hit.
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::awaitKey(size_t lane) {
+		const word kbState = keysScheduled[lane];
+		byte &timer = timers[TIMER_SOUND][lane];
+
+		if (kbState == KEY_NONE && kb[lane] != KEY_NONE) {
+			byte keyIdx = 0;
+			while (((kb[lane] >> keyIdx) & 0x01) == 0) {
+				++keyIdx;
+			}
+			registers[keyHaltRegister[lane]][lane] = keyIdx;
+			keyHaltRegister[lane] = STATE_KEY_HALT_UNSET;
+
+			timer = 0;
+		}
+		else if (kbState != KEY_NONE && timer == 0) {
+			timer = 4;
+		}
+		kb[lane] = kbState;
+		pending[lane] = COUNT_CYCLES_KEY_AWAIT_PASS;
+	}
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::commitPending(size_t lane) {
+		countCycles[lane] += pending[lane];
+		result[lane] += pending[lane];
+		pending[lane] = 0;
+
+		if (countCycles[lane] >= eventsNext[lane]) {
+			dispatchEvents(lane);
+		}
+	}
+
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::run(clock cycleBudget) {
+		FOR_EACH_LANE(lane) {
+			if (lastError[lane] == INTERPRETER_ERROR_OK && keyHaltRegister[lane] == STATE_KEY_HALT_UNSET) {
+				kb[lane] = keysScheduled[lane];
+			}
+			result[lane] = 0;
+			pending[lane] = 0;
+		}
+
+		size_t windowSteps = 0;
+		size_t windowLanes = 0;
+		bool diverged = false;
+
+		for (;;) {
+			// Lanes, which are fetched. The lowest program counter among them
+			// leads, as the loops are mostly backwards.
+			// Conditions are combined bitwise, so that loops over lanes have no branches.
+			unsigned running = 0;
+			unsigned awaiting = 0;
+			word address = ADDRESS_NONE;
+
+			FOR_EACH_LANE(lane) {
+				const unsigned on = unsigned(lastError[lane] == INTERPRETER_ERROR_OK) & unsigned(result[lane] < cycleBudget);
+				const unsigned fetched = on & unsigned(keyHaltRegister[lane] == STATE_KEY_HALT_UNSET)
+					& unsigned(OFFSET_PROGRAM_START <= pc[lane]) & unsigned(pc[lane] < memorySize - 1);
+
+				active[lane] = byte(0x00 - fetched);
+				running |= on;
+				awaiting |= on & ~fetched;
+				address = std::min<word>(address, !!fetched ? pc[lane] : ADDRESS_NONE);
+			}
+			if (!running) {
+				break;
+			}
+
+			// Lanes, which await a key, take a pass each.
+			if (awaiting) {
+				FOR_EACH_LANE(lane) {
+					if (!!active[lane] || lastError[lane] != INTERPRETER_ERROR_OK || result[lane] >= cycleBudget) {
+						continue;
+					}
+					if (keyHaltRegister[lane] != STATE_KEY_HALT_UNSET) {
+						awaitKey(lane);
+
+						// Passes, which follow, change nothing until an event is due,
+						// or the budget is used up, so they are all taken at once.
+						if (keyHaltRegister[lane] != STATE_KEY_HALT_UNSET) {
+							pending[lane] = COUNT_CYCLES_KEY_AWAIT_PASS * std::min<clock>(
+								PASSES_TO(eventsNext[lane] - countCycles[lane]), PASSES_TO(cycleBudget - result[lane]));
+
+							commitPending(lane);
+							continue;
+						}
+					}
+					if (!(OFFSET_PROGRAM_START <= pc[lane] && pc[lane] < memorySize - 1)) {
+						lastError[lane] = INTERPRETER_ERROR_PROGRAM_COUNTER_CORRUPTED;
+						commitPending(lane);
+						continue;
+					}
+					active[lane] = 0xFF;
+					address = std::min<word>(address, pc[lane]);
+				}
+			}
+			if (address == ADDRESS_NONE) {
+				continue;
+			}
+
+			size_t count = 0;
+			size_t leader = 0;
+
+			FOR_EACH_LANE(lane) {
+				group[lane] = active[lane] & byte(0x00 - unsigned(pc[lane] == address));
+				count += group[lane] & 0x01;
+			}
+			while (!group[leader]) {
+				++leader;
+			}
+			const Opcode &opcode = *reinterpret_cast<const Opcode *>(laneMemory(leader) + address);
+
+			// Lanes may only differ by the code, which is written by the program.
+			if (!!(codeWritten[address] | codeWritten[address + 1])) {
+				FOR_EACH_LANE(lane) {
+					const byte *code = laneMemory(lane) + address;
+
+					if (!!group[lane] && (code[0] != opcode.hi || code[1] != opcode.lo)) {
+						group[lane] = 0x00;
+						--count;
+					}
+				}
+			}
+
+			Instruction scratch;
+			const Instruction &instruction = decodeCached(address, opcode, scratch);
+
+			FOR_EACH_LANE(lane) {
+				pc[lane] += SELECT(lane, PROGRAM_COUNTER_STEP, 0);
+				cycles[lane] = 0;
+			}
+			(this->*instructions[instruction.code]) (instruction);
+
+			unsigned eventsDue = 0;
+			FOR_EACH_LANE(lane) {
+				const clock taken = SELECT(lane, cycles[lane] + pending[lane], 0);
+
+				countCycles[lane] += taken;
+				result[lane] += taken;
+				pending[lane] = SELECT(lane, 0, pending[lane]);
+				rndSeed[lane] += group[lane] & 0x01;
+
+				eventsDue |= group[lane] & unsigned(countCycles[lane] >= eventsNext[lane]);
+			}
+			if (!!eventsDue) {
+				FOR_EACH_LANE(lane) {
+					if (!!group[lane] && countCycles[lane] >= eventsNext[lane]) {
+						dispatchEvents(lane);
+					}
+				}
+			}
+			++countSteps;
+			countLaneSteps += count;
+
+			// Lanes go on one by one once they have diverged, unless some of
+			// them have key await cycles to count along with an instruction.
+			windowLanes += count;
+			if (++windowSteps == OCCUPANCY_WINDOW) {
+				bool settled = true;
+
+				FOR_EACH_LANE(lane) {
+					settled &= pending[lane] == 0;
+				}
+				if (settled && windowLanes < OCCUPANCY_WINDOW * OCCUPANCY_MIN) {
+					diverged = true;
+					break;
+				}
+				windowSteps = 0;
+				windowLanes = 0;
+			}
+		}
+
+		if (diverged) {
+			FOR_EACH_LANE(lane) {
+				if (lastError[lane] == INTERPRETER_ERROR_OK && result[lane] < cycleBudget) {
+					runScalar(lane, cycleBudget);
+				}
+			}
+		}
+	}
+
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::runScalar(size_t lane, clock cycleBudget) {
+		size_t size = getStateSize(lane);
+		stateBuffer.resize((size + sizeof(clock) - 1) / sizeof(clock));
+
+		byte *data = reinterpret_cast<byte *>(stateBuffer.data());
+		if (!saveState(lane, data, size) || !scalar->loadState(data, size)) {
+			assert(false);
+			return;
+		}
+		scalar->run(cycleBudget - result[lane]);
+
+		size = scalar->getStateSize();
+		stateBuffer.resize((size + sizeof(clock) - 1) / sizeof(clock));
+
+		data = reinterpret_cast<byte *>(stateBuffer.data());
+		scalar->saveState(data, size);
+
+		// Code written by the lane is no longer the same for all the lanes.
+		const byte *laneMem = laneMemory(lane);
+		const byte *written = data + stateOffsetMemory();
+
+		for (size_t address = 0; address < memorySize; ++address) {
+			codeWritten[address] |= laneMem[address] != written[address] ? 0x01 : 0x00;
+		}
+		loadLane(lane, data);
+	}
+
+
+	LOCKSTEP_TEMPLATE
+	const InterpreterBase::Instruction &LOCKSTEP_CLASS::decodeCached(word address, const Opcode &opcode, Instruction &scratch) {
+		if (!!(address & 0x01)) {
+			decode(opcode, scratch);
+
+			return scratch;
+		}
+		CacheEntry &entry = instructionCache[address >> 1];
+
+		if (entry.instruction.code == INSTRUCTION_NONE
+			|| entry.opcode.hi != opcode.hi || entry.opcode.lo != opcode.lo) {
+
+			entry.opcode = opcode;
+			decode(opcode, entry.instruction);
+		}
+		return entry.instruction;
+	}
+
+
+	// ========================================================
+	// instruction handlers
+	//
+	// Each one works on the lanes of the group. Errors are
+	// reported the way FastAccess does, the same as CheckedAccess
+	// does for valid programs.
+	// ========================================================
+
+#define SET_CYCLES(value)												\
+	FOR_EACH_LANE(lane) {												\
+		cycles[lane] = (value);											\
+	}
+
+#define DEFINE_SKIP(id, condition, execTrue, execFalse)				\
+	LOCKSTEP_TEMPLATE													\
+	void LOCKSTEP_CLASS::op##id(const Instruction &instruction) {		\
+		const size_t x = instruction.x;									\
+		const size_t y = instruction.y;									\
+		(void)y;														\
+																		\
+		FOR_EACH_LANE(lane) {											\
+			const bool taken = (condition);								\
+																		\
+			pc[lane] += SELECT(lane, taken ? PROGRAM_COUNTER_STEP : 0, 0);	\
+			cycles[lane] = COUNT_CYCLES_TAKEN_BY_GROUPN_BRANCH(taken, execTrue, execFalse);	\
+		}																\
+	}
+
+	// VF is assigned the last, so that it overrides the result, if VF is VX.
+#define DEFINE_ALU(id, expression, flag)								\
+	LOCKSTEP_TEMPLATE													\
+	void LOCKSTEP_CLASS::op##id(const Instruction &instruction) {		\
+		byte *vx = registers[instruction.x];							\
+		const byte *vy = registers[instruction.y];						\
+		byte *vf = registers[REGISTERS_COUNT - 1];						\
+																		\
+		FOR_EACH_LANE(lane) {											\
+			const byte x = vx[lane];									\
+			const byte y = vy[lane];									\
+			const byte f = vf[lane];									\
+			(void)x; (void)y; (void)f;									\
+																		\
+			vx[lane] = SELECT(lane, byte(expression), x);				\
+			vf[lane] = SELECT(lane, byte(flag), vf[lane]);				\
+		}																\
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(44));					\
+	}
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::op00E0(const Instruction &) {
+		FOR_EACH_LANE(lane) {
+			if (!!group[lane]) {
+				displays[lane]->clear();
+				displays[lane]->invalidate();
+			}
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUP0(24));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::op00EE(const Instruction &) {
+		FOR_EACH_LANE(lane) {
+			if (!!group[lane]) {
+				const word idx = sp[lane]++;
+
+				if (idx < STACK_DEPTH) {
+					pc[lane] = stack[idx][lane];
+				}
+				else {
+					lastError[lane] = INTERPRETER_ERROR_STACK_OVERFLOW;
+					pc[lane] = stack[0][lane];
+				}
+			}
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUP0(10));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::op0NNN(const Instruction &) {
+		FOR_EACH_LANE(lane) {
+			lastError[lane] = SELECT(lane, byte(INTERPRETER_ERROR_UNEXPECTED), lastError[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_GROUP0_DEFAULT);
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::op1NNN(const Instruction &instruction) {
+		FOR_EACH_LANE(lane) {
+			pc[lane] = SELECT(lane, instruction.value, pc[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(12));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::op2NNN(const Instruction &instruction) {
+		FOR_EACH_LANE(lane) {
+			if (!!group[lane]) {
+				const word idx = --sp[lane];
+
+				if (idx < STACK_DEPTH) {
+					stack[idx][lane] = pc[lane];
+				}
+				else {
+					lastError[lane] = INTERPRETER_ERROR_STACK_OVERFLOW;
+				}
+				pc[lane] = instruction.value;
+			}
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(26));
+	}
+
+	DEFINE_SKIP(3XNN, registers[x][lane] == instruction.value, 14, 10)
+	DEFINE_SKIP(4XNN, registers[x][lane] != instruction.value, 14, 10)
+	DEFINE_SKIP(5XY0, registers[x][lane] == registers[y][lane], 18, 14)
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::op6XNN(const Instruction &instruction) {
+		byte *vx = registers[instruction.x];
+
+		FOR_EACH_LANE(lane) {
+			vx[lane] = SELECT(lane, byte(instruction.value), vx[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(6));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::op7XNN(const Instruction &instruction) {
+		byte *vx = registers[instruction.x];
+
+		FOR_EACH_LANE(lane) {
+			vx[lane] = SELECT(lane, byte(vx[lane] + instruction.value), vx[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(10));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::op8XY0(const Instruction &instruction) {
+		byte *vx = registers[instruction.x];
+		const byte *vy = registers[instruction.y];
+
+		FOR_EACH_LANE(lane) {
+			vx[lane] = SELECT(lane, vy[lane], vx[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(12));
+	}
+
+	DEFINE_ALU(8XY1, x | y, !!(quirksActive & QUIRK_LOGIC_VF_RESET) ? 0x00 : (instruction.x == REGISTERS_COUNT - 1 ? byte(x | y) : f))
+	DEFINE_ALU(8XY2, x & y, !!(quirksActive & QUIRK_LOGIC_VF_RESET) ? 0x00 : (instruction.x == REGISTERS_COUNT - 1 ? byte(x & y) : f))
+	DEFINE_ALU(8XY3, x ^ y, !!(quirksActive & QUIRK_LOGIC_VF_RESET) ? 0x00 : (instruction.x == REGISTERS_COUNT - 1 ? byte(x ^ y) : f))
+	DEFINE_ALU(8XY4, x + y, (x + y) >> 8)
+	DEFINE_ALU(8XY5, x - y, x >= y ? 0x01 : 0x00)
+	DEFINE_ALU(8XY7, y - x, y >= x ? 0x01 : 0x00)
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::op8XY6(const Instruction &instruction) {
+		byte *vx = registers[instruction.x];
+		const byte *vy = registers[!!(quirksActive & QUIRK_SHIFT_VX) ? instruction.x : instruction.y];
+		byte *vf = registers[REGISTERS_COUNT - 1];
+
+		FOR_EACH_LANE(lane) {
+			const byte value = vy[lane];
+
+			vx[lane] = SELECT(lane, byte(value >> 1), vx[lane]);
+			vf[lane] = SELECT(lane, byte(value & 0x01), vf[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(44));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::op8XYE(const Instruction &instruction) {
+		byte *vx = registers[instruction.x];
+		const byte *vy = registers[!!(quirksActive & QUIRK_SHIFT_VX) ? instruction.x : instruction.y];
+		byte *vf = registers[REGISTERS_COUNT - 1];
+
+		FOR_EACH_LANE(lane) {
+			const byte value = vy[lane];
+
+			vx[lane] = SELECT(lane, byte(value << 1), vx[lane]);
+			vf[lane] = SELECT(lane, byte(value >> 7), vf[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(44));
+	}
+
+	DEFINE_SKIP(9XY0, registers[x][lane] != registers[y][lane], 18, 14)
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opANNN(const Instruction &instruction) {
+		FOR_EACH_LANE(lane) {
+			index[lane] = SELECT(lane, instruction.value, index[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(12));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opBNNN(const Instruction &instruction) {
+		const byte *v = registers[!!(quirksActive & QUIRK_JUMP_VX) ? (instruction.value >> 8) & 0x0F : 0];
+
+		FOR_EACH_LANE(lane) {
+			pc[lane] = SELECT(lane, word(instruction.value + v[lane]), pc[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(22));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opCXNN(const Instruction &instruction) {
+		FOR_EACH_LANE(lane) {
+			if (!!group[lane]) {
+				const word loSeed = (rndSeed[lane] + 1) & 0x00FF;
+				const word address = (pc[lane] & 0xFF00U) | loSeed;
+
+				word result = 0;
+				if (address < memorySize) {
+					result = laneMemory(lane)[address];
+				}
+				else {
+					lastError[lane] = INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS;
+					result = laneMemory(lane)[0];
+				}
+				result = (result + (((rndSeed[lane] + 1) & 0xFF00) >> 8)) & 0xFF;
+				result += (result >> 1) | ((result & 0x01) << 7);
+
+				rndSeed[lane] = word(((result & 0xFF) << 8) | loSeed);
+				registers[instruction.x][lane] = byte(result & instruction.value);
+			}
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(36));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opDXYN(const Instruction &instruction) {
+		const size_t value = instruction.value;
+
+		FOR_EACH_LANE(lane) {
+			if (!group[lane] || value == 0) {
+				continue;
+			}
+			PackedDisplay &display = *displays[lane];
+			const byte *laneMem = laneMemory(lane);
+			const word i = index[lane];
+
+			const size_t y = registers[instruction.y][lane] % display.height();
+			const size_t x = registers[instruction.x][lane] % display.width();
+			const size_t w = std::min<size_t>(display.width() - x, 8);
+			const size_t h = std::min<size_t>(display.height() - y, value);
+
+			bool collision = false;
+
+			if (!!(quirksActive & QUIRK_SPRITE_WRAP) && (w < 8 || h < value)) {
+				if (i + value <= memorySize) {
+					for (size_t r = 0; r < value; ++r) {
+						collision |= display.xorLine(byte((y + r) % display.height()), byte(x), laneMem[i + r]);
+					}
+				}
+				else {
+					lastError[lane] = INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS;
+				}
+				display.invalidate();
+			}
+			else {
+				const byte strideMask = (w < 8) ? (0xFF << (8 - w)) : 0xFF;
+
+				if (i + h <= memorySize) {
+					for (size_t r = 0; r < h; ++r) {
+						collision |= display.xorLine(byte(y + r), byte(x), laneMem[i + r] & strideMask);
+					}
+				}
+				else {
+					lastError[lane] = INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS;
+				}
+				display.invalidate(byte(x), byte(y), byte(w), byte(h));
+			}
+			registers[REGISTERS_COUNT - 1][lane] = collision ? 0x01 : 0x00;
+		}
+		if (value == 0) {
+			byte *vf = registers[REGISTERS_COUNT - 1];
+
+			FOR_EACH_LANE(lane) {
+				vf[lane] = SELECT(lane, 0x00, vf[lane]);
+			}
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(value * 412));
+	}
+
+	DEFINE_SKIP(EX9E, registers[x][lane] < 0x10 && !!((kb[lane] >> registers[x][lane]) & 0x01), 18, 14)
+	DEFINE_SKIP(EXA1, !(registers[x][lane] < 0x10 && !!((kb[lane] >> registers[x][lane]) & 0x01)), 18, 14)
+
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opFX07(const Instruction &instruction) {
+		byte *vx = registers[instruction.x];
+
+		FOR_EACH_LANE(lane) {
+			vx[lane] = SELECT(lane, timers[TIMER_DELAY][lane], vx[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(10));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opFX0A(const Instruction &instruction) {
+		FOR_EACH_LANE(lane) {
+			keyHaltRegister[lane] = SELECT(lane, instruction.x, keyHaltRegister[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(17765));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opFX15(const Instruction &instruction) {
+		FOR_EACH_LANE(lane) {
+			if (!!group[lane]) {
+				scheduleEvent(lane, countCycles[lane] + COUNT_CYCLES_TIMER_SET, EVENT_TIMER_SET, TIMER_DELAY, registers[instruction.x][lane]);
+			}
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(10));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opFX18(const Instruction &instruction) {
+		FOR_EACH_LANE(lane) {
+			if (!!group[lane]) {
+				scheduleEvent(lane, countCycles[lane] + COUNT_CYCLES_TIMER_SET, EVENT_TIMER_SET, TIMER_SOUND, registers[instruction.x][lane]);
+			}
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(10));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opFX1E(const Instruction &instruction) {
+		const byte *vx = registers[instruction.x];
+
+		FOR_EACH_LANE(lane) {
+			index[lane] = SELECT(lane, word(index[lane] + vx[lane]), index[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(16));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opFX29(const Instruction &instruction) {
+		const byte *vx = registers[instruction.x];
+
+		FOR_EACH_LANE(lane) {
+			index[lane] = SELECT(lane, word(vx[lane] * FONT_SYMBOL_HEIGHT), index[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(20));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opFX33(const Instruction &instruction) {
+		FOR_EACH_LANE(lane) {
+			const byte value = registers[instruction.x][lane];
+
+			const byte hundreds = value / 100;
+			const byte tens = (value % 100) / 10;
+			const byte ones = value % 10;
+
+			if (!!group[lane]) {
+				const word i = index[lane];
+
+				if (OFFSET_PROGRAM_START <= i && i + 3U <= memorySize) {
+					byte *laneMem = laneMemory(lane);
+
+					laneMem[i] = hundreds;
+					laneMem[i + 1U] = tens;
+					laneMem[i + 2U] = ones;
+
+					memset(codeWritten.data() + i, 0x01, 3U);
+				}
+				else {
+					lastError[lane] = INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS;
+				}
+			}
+			cycles[lane] = COUNT_CYCLES_TAKEN_BY_GROUPN(84 + 16 * (hundreds + tens + ones));
+		}
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opFX55(const Instruction &instruction) {
+		const size_t count = instruction.x + 1U;
+
+		FOR_EACH_LANE(lane) {
+			if (!group[lane]) {
+				continue;
+			}
+			const word i = index[lane];
+
+			if (OFFSET_PROGRAM_START <= i && i + count <= memorySize) {
+				byte *laneMem = laneMemory(lane);
+
+				for (size_t r = 0; r < count; ++r) {
+					laneMem[i + r] = registers[r][lane];
+				}
+				memset(codeWritten.data() + i, 0x01, count);
+			}
+			else {
+				lastError[lane] = INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS;
+			}
+			if (!(quirksActive & QUIRK_LOAD_STORE_KEEP_I)) {
+				index[lane] = word(i + count);
+			}
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(4 + 14 * (instruction.x + 2)));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opFX65(const Instruction &instruction) {
+		const size_t count = instruction.x + 1U;
+
+		FOR_EACH_LANE(lane) {
+			if (!group[lane]) {
+				continue;
+			}
+			const word i = index[lane];
+
+			if (i + count <= memorySize) {
+				const byte *laneMem = laneMemory(lane);
+
+				for (size_t r = 0; r < count; ++r) {
+					registers[r][lane] = laneMem[i + r];
+				}
+			}
+			else {
+				lastError[lane] = INTERPRETER_ERROR_INDEX_OUT_OF_BOUNDS;
+			}
+			if (!(quirksActive & QUIRK_LOAD_STORE_KEEP_I)) {
+				index[lane] = word(i + count);
+			}
+		}
+		SET_CYCLES(COUNT_CYCLES_TAKEN_BY_GROUPN(4 + 14 * (instruction.x + 2)));
+	}
+	LOCKSTEP_TEMPLATE
+	void LOCKSTEP_CLASS::opXXXX(const Instruction &) {
+		FOR_EACH_LANE(lane) {
+			lastError[lane] = SELECT(lane, byte(INTERPRETER_ERROR_UNEXPECTED), lastError[lane]);
+		}
+		SET_CYCLES(COUNT_CYCLES_GROUPN_DEFAULT);
+	}
+
+
+#define INSTRUCTION_HANDLER_ADDRESS(id) &LOCKSTEP_CLASS::op##id,
+
+	LOCKSTEP_TEMPLATE
+	const typename LOCKSTEP_CLASS::InstructionHandler LOCKSTEP_CLASS::instructions[INSTRUCTIONS_COUNT] = {
+		nullptr, CHIP8_INSTRUCTIONS(INSTRUCTION_HANDLER_ADDRESS)
+	};
+
+	template class Lockstep<8>;
+	template class Lockstep<16>;
+	template class Lockstep<32>;
+
+#undef LOCKSTEP_TEMPLATE
+#undef LOCKSTEP_CLASS
+#undef FOR_EACH_LANE
+#undef SELECT
+#undef FONT_SYMBOL_HEIGHT
+#undef PROGRAM_COUNTER_STEP
+#undef PASSES_TO
+#undef ADDRESS_NONE
+#undef SET_CYCLES
+#undef DEFINE_SKIP
+#undef DEFINE_ALU
+#undef INSTRUCTION_HANDLER_ADDRESS
+
+} // namespace chip8
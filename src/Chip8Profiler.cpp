@@ -0,0 +1,148 @@
+#include "chip8/Chip8Profiler.h"
+
+#include <cassert>
+#include <algorithm>
+#include <iomanip>
+
+
+namespace chip8 {
+
+	Profiler::Profiler(clock interval, word root)
+		: interval(interval), root(root) {
+
+		assert(interval > 0);
+		clear();
+	}
+
+
+	void Profiler::clear() {
+		samplesCount = 0;
+
+		addresses.clear();
+		stacks.clear();
+	}
+
+	void Profiler::sample(word pc, const word *stack, size_t depth, const byte *memory, size_t memorySize, clock weight) {
+		assert(!!stack || depth == 0);
+		assert(memory);
+
+		samplesCount += weight;
+		addresses[pc] += weight;
+
+		scratch.assign(1, root);
+		for (size_t i = depth; i-- > 0;) {
+			const size_t call = size_t(stack[i]) - 2;
+			word entry = ROUTINE_UNKNOWN;
+
+			if (stack[i] >= 2 && call + 1 < memorySize && (memory[call] >> 4) == 0x2) {
+				entry = word((memory[call] & 0x0F) << 8 | memory[call + 1]);
+			}
+			scratch.push_back(entry);
+		}
+		stacks[scratch] += weight;
+	}
+
+
+	namespace {
+
+		bool hotter(const Profiler::Hotspot &a, const Profiler::Hotspot &b) {
+			return a.samples > b.samples
+				|| (a.samples == b.samples && a.address < b.address);
+		}
+
+	} // namespace
+
+	std::vector<Profiler::Hotspot> Profiler::getHotAddresses() const {
+		std::vector<Hotspot> result;
+		result.reserve(addresses.size());
+
+		for (const auto &address : addresses) {
+			Hotspot hotspot = { address.first, address.second, address.second };
+			result.push_back(hotspot);
+		}
+		std::sort(result.begin(), result.end(), hotter);
+
+		return result;
+	}
+
+	std::vector<Profiler::Hotspot> Profiler::getHotRoutines() const {
+		std::map<word, Hotspot> routines;
+
+		for (const auto &stack : stacks) {
+			const Routines &entries = stack.first;
+
+			for (size_t i = 0; i < entries.size(); ++i) {
+				Hotspot &routine = routines[entries[i]];
+				routine.address = entries[i];
+
+				// Recursive calls count once towards the total.
+				if (std::find(entries.begin(), entries.begin() + i, entries[i]) == entries.begin() + i) {
+					routine.samplesTotal += stack.second;
+				}
+			}
+			routines[entries.back()].samples += stack.second;
+		}
+
+		std::vector<Hotspot> result;
+		result.reserve(routines.size());
+
+		for (const auto &routine : routines) {
+			result.push_back(routine.second);
+		}
+		std::sort(result.begin(), result.end(), hotter);
+
+		return result;
+	}
+
+
+	void Profiler::writeLabel(std::ostream &stream, word address) {
+		if (address == ROUTINE_UNKNOWN) {
+			stream << "????";
+		}
+		else {
+			stream << std::hex << std::uppercase << std::setfill('0') << std::setw(4) << address
+				<< std::dec << std::setfill(' ');
+		}
+	}
+
+	void Profiler::writeReport(std::ostream &stream, size_t limit) const {
+		const double percent = samplesCount > 0 ? 100.0 / samplesCount : 0.0;
+
+		stream << "samples " << samplesCount << ", each of " << interval << " cycles" << std::endl;
+
+		const std::vector<Hotspot> routines = getHotRoutines();
+
+		stream << std::endl << "routine self% total% samples" << std::endl;
+		for (size_t i = 0; i < routines.size() && i < limit; ++i) {
+			writeLabel(stream, routines[i].address);
+			stream << std::fixed << std::setprecision(1)
+				<< ' ' << routines[i].samples * percent
+				<< ' ' << routines[i].samplesTotal * percent
+				<< ' ' << routines[i].samples << std::endl;
+		}
+
+		const std::vector<Hotspot> hot = getHotAddresses();
+
+		stream << std::endl << "address self% samples" << std::endl;
+		for (size_t i = 0; i < hot.size() && i < limit; ++i) {
+			writeLabel(stream, hot[i].address);
+			stream << std::fixed << std::setprecision(1)
+				<< ' ' << hot[i].samples * percent
+				<< ' ' << hot[i].samples << std::endl;
+		}
+	}
+
+	void Profiler::writeFolded(std::ostream &stream) const {
+		for (const auto &stack : stacks) {
+			const char *separator = "";
+
+			for (word entry : stack.first) {
+				stream << separator;
+				writeLabel(stream, entry);
+				separator = ";";
+			}
+			stream << ' ' << stack.second << std::endl;
+		}
+	}
+
+} // namespace chip8
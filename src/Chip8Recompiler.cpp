@@ -0,0 +1,712 @@
+#include "chip8/Chip8Recompiler.h"
+#include "chip8/Chip8Interpreter.h"
+#include "chip8/Chip8Cycles.h"
+
+#if CHIP8_RECOMPILER
+
+#include <cassert>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <bitset>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+namespace chip8 {
+
+	namespace {
+
+		enum Register : unsigned {
+			RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+			R8, R9, R10, R11, R12, R13, R14, R15
+		};
+
+		// RDI holds V0 address through the whole block, RAX and RDX
+		// are scratch ones. The rest are given to guest registers,
+		// caller-saved go first, so short blocks need no spills.
+		const Register BASE = RDI;
+
+		const Register allocatable[] = {
+			RCX, R8, R9, R10, R11, RSI, RBX, RBP, R12, R13, R14, R15
+		};
+
+#if defined(_WIN32)
+		const unsigned calleeSaved = (1U << RBX) | (1U << RBP) | (1U << RSI)
+			| (1U << R12) | (1U << R13) | (1U << R14) | (1U << R15);
+#else
+		const unsigned calleeSaved = (1U << RBX) | (1U << RBP)
+			| (1U << R12) | (1U << R13) | (1U << R14) | (1U << R15);
+#endif
+
+		enum Alu : unsigned {
+			ALU_ADD = 0, ALU_OR = 1, ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6, ALU_CMP = 7
+		};
+		enum Shift : unsigned {
+			SHIFT_LEFT = 4, SHIFT_RIGHT = 5
+		};
+		enum Condition : unsigned {
+			CONDITION_AE = 0x3, CONDITION_E = 0x4, CONDITION_NE = 0x5
+		};
+
+		// Encodes the very few x86-64 instructions blocks are made of.
+		// All the operations are 32 bit wide unless stated otherwise.
+		class Assembler {
+
+			byte *cursor;
+			byte *const end;
+
+			bool overflow;
+
+			void emit(byte value) {
+				if (cursor < end) {
+					*cursor++ = value;
+				}
+				else {
+					overflow = true;
+				}
+			}
+			void emit32(uint32_t value) {
+				for (size_t i = 0; i < 4; ++i, value >>= 8) {
+					emit(byte(value));
+				}
+			}
+
+			void rex(bool wide, unsigned reg, unsigned rm, bool force = false) {
+				byte prefix = byte(0x40 | (wide ? 0x08 : 0x00) | ((reg & 0x08) >> 1) | ((rm & 0x08) >> 3));
+
+				// Byte operations need the prefix to address SIL, DIL and BPL.
+				if (prefix != 0x40 || force) {
+					emit(prefix);
+				}
+			}
+			void modrm(unsigned reg, unsigned rm) {
+				emit(byte(0xC0 | ((reg & 0x07) << 3) | (rm & 0x07)));
+			}
+			void modrmBase(unsigned reg, ptrdiff_t displacement) {
+				emit(byte(0x80 | ((reg & 0x07) << 3) | (BASE & 0x07)));
+				emit32(uint32_t(int32_t(displacement)));
+			}
+
+		public:
+			Assembler(byte *begin, byte *end)
+				: cursor(begin), end(end), overflow(false) {
+
+				/* Nothing to do */
+			}
+
+			byte *position() const {
+				return cursor;
+			}
+			bool isOverflow() const {
+				return overflow;
+			}
+
+			void push(Register reg) {
+				rex(false, 0, reg);
+				emit(byte(0x50 | (reg & 0x07)));
+			}
+			void pop(Register reg) {
+				rex(false, 0, reg);
+				emit(byte(0x58 | (reg & 0x07)));
+			}
+			void ret() {
+				emit(0xC3);
+			}
+
+			void mov64(Register dst, Register src) {
+				rex(true, src, dst);
+				emit(0x89);
+				modrm(src, dst);
+			}
+			void mov(Register dst, Register src) {
+				rex(false, src, dst);
+				emit(0x89);
+				modrm(src, dst);
+			}
+			void mov(Register dst, uint32_t value) {
+				rex(false, 0, dst);
+				emit(byte(0xB8 | (dst & 0x07)));
+				emit32(value);
+			}
+			void movzxb(Register dst, Register src) {
+				rex(false, dst, src, true);
+				emit(0x0F); emit(0xB6);
+				modrm(dst, src);
+			}
+			void movzxw(Register dst, Register src) {
+				rex(false, dst, src);
+				emit(0x0F); emit(0xB7);
+				modrm(dst, src);
+			}
+
+			void alu(Alu op, Register dst, Register src) {
+				rex(false, src, dst);
+				emit(byte((op << 3) | 0x01));
+				modrm(src, dst);
+			}
+			void alu(Alu op, Register dst, uint32_t value) {
+				rex(false, 0, dst);
+				emit(0x81);
+				modrm(op, dst);
+				emit32(value);
+			}
+			void shift(Shift op, Register reg, byte count) {
+				rex(false, 0, reg);
+				emit(0xC1);
+				modrm(op, reg);
+				emit(count);
+			}
+			void imul(Register dst, Register src, byte value) {
+				rex(false, dst, src);
+				emit(0x6B);
+				modrm(dst, src);
+				emit(value);
+			}
+			void setcc(Condition condition, Register reg) {
+				rex(false, 0, reg, true);
+				emit(0x0F); emit(byte(0x90 | condition));
+				modrm(0, reg);
+			}
+
+			// Short forward jump, the returned label must be bound later.
+			byte *jcc(Condition condition) {
+				emit(byte(0x70 | condition));
+				emit(0x00);
+
+				return cursor - 1;
+			}
+			void bind(byte *label) {
+				if (!overflow) {
+					*label = byte(cursor - label - 1);
+				}
+			}
+
+			void loadb(Register dst, ptrdiff_t displacement) {
+				rex(false, dst, BASE);
+				emit(0x0F); emit(0xB6);
+				modrmBase(dst, displacement);
+			}
+			void loadw(Register dst, ptrdiff_t displacement) {
+				rex(false, dst, BASE);
+				emit(0x0F); emit(0xB7);
+				modrmBase(dst, displacement);
+			}
+			void storeb(Register src, ptrdiff_t displacement) {
+				rex(false, src, BASE, true);
+				emit(0x88);
+				modrmBase(src, displacement);
+			}
+			void storew(Register src, ptrdiff_t displacement) {
+				emit(0x66);
+				rex(false, src, BASE);
+				emit(0x89);
+				modrmBase(src, displacement);
+			}
+		};
+
+
+		// Guest registers are V0-VF and I.
+		enum : unsigned {
+			SLOT_VF		= 0x0F,
+			SLOT_INDEX	= 0x10,
+			SLOTS_COUNT
+		};
+
+#define SLOT(idx) (1U << (idx))
+
+		// Tells, whether an instruction can be translated, which guest
+		// registers it touches and if it ends a block.
+		bool analyze(byte hi, byte lo, unsigned quirks, unsigned &slots, bool &terminator) {
+			unsigned x = hi & 0x0F;
+			unsigned y = lo >> 4;
+
+			slots = 0;
+			terminator = false;
+
+			switch (hi >> 4) {
+			case 0x1:
+				terminator = true;
+				return true;
+
+			case 0x3: case 0x4:
+				slots = SLOT(x);
+				terminator = true;
+				return true;
+
+			case 0x5: case 0x9:
+				slots = SLOT(x) | SLOT(y);
+				terminator = true;
+				return (lo & 0x0F) == 0x0;
+
+			case 0x6: case 0x7:
+				slots = SLOT(x);
+				return true;
+
+			case 0x8:
+				slots = SLOT(x) | SLOT(y);
+
+				switch (lo & 0x0F) {
+				case 0x0:
+					return true;
+				case 0x1: case 0x2: case 0x3:
+					if (!!(quirks & InterpreterBase::QUIRK_LOGIC_VF_RESET)) {
+						slots |= SLOT(SLOT_VF);
+					}
+					return true;
+				case 0x4: case 0x5: case 0x6: case 0x7: case 0xE:
+					slots |= SLOT(SLOT_VF);
+					return true;
+				}
+				return false;
+
+			case 0xA:
+				slots = SLOT(SLOT_INDEX);
+				return true;
+
+			case 0xB:
+				slots = SLOT(!!(quirks & InterpreterBase::QUIRK_JUMP_VX) ? x : 0);
+				terminator = true;
+				return true;
+
+			case 0xF:
+				switch (lo) {
+				case 0x07:
+					slots = SLOT(x);
+					return true;
+				case 0x1E: case 0x29:
+					slots = SLOT(x) | SLOT(SLOT_INDEX);
+					return true;
+				}
+				return false;
+			}
+			return false;
+		}
+	} // namespace
+
+
+	Recompiler::Recompiler(const byte *memory, size_t memorySize,
+		word programStart, const Layout &layout, unsigned quirks)
+
+		: memory(memory), memorySize(memorySize), programStart(programStart),
+		layout(layout), quirks(quirks) {
+
+		assert(memory);
+		assert(memorySize > 0);
+
+		blocks = new Block[memorySize];
+		coverage = new byte[memorySize];
+
+#if defined(_WIN32)
+		SYSTEM_INFO system;
+		GetSystemInfo(&system);
+
+		pageSize = system.dwPageSize;
+		codeBuffer = static_cast<byte *>(VirtualAlloc(nullptr, CODE_BUFFER_SIZE,
+			MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+		pageSize = size_t(sysconf(_SC_PAGESIZE));
+
+		void *buffer = mmap(nullptr, CODE_BUFFER_SIZE,
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		codeBuffer = buffer != MAP_FAILED ? static_cast<byte *>(buffer) : nullptr;
+#endif
+		codeUsed = 0;
+		flush();
+	}
+
+	Recompiler::~Recompiler() {
+		release();
+
+		delete[] coverage;
+		delete[] blocks;
+	}
+
+
+	bool Recompiler::protect(size_t begin, size_t end, bool executable) {
+		const size_t first = begin / pageSize * pageSize;
+		const size_t last = std::min<size_t>((end + pageSize - 1) / pageSize * pageSize, CODE_BUFFER_SIZE);
+
+		if (!codeBuffer || first >= last) {
+			return !!codeBuffer;
+		}
+#if defined(_WIN32)
+		DWORD previous;
+		const bool result = !!VirtualProtect(codeBuffer + first, last - first,
+			executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &previous);
+
+		if (result && executable) {
+			FlushInstructionCache(GetCurrentProcess(), codeBuffer + first, last - first);
+		}
+#else
+		const bool result = mprotect(codeBuffer + first, last - first,
+			executable ? PROT_READ | PROT_EXEC : PROT_READ | PROT_WRITE) == 0;
+#endif
+		// Code, which can't be switched over, is not run nor written any more.
+		if (!result) {
+			release();
+		}
+		return result;
+	}
+
+	void Recompiler::release() {
+		if (!codeBuffer) {
+			return;
+		}
+#if defined(_WIN32)
+		VirtualFree(codeBuffer, 0, MEM_RELEASE);
+#else
+		munmap(codeBuffer, CODE_BUFFER_SIZE);
+#endif
+		codeBuffer = nullptr;
+	}
+
+
+	const Recompiler::Block &Recompiler::lookupImpl(word address) {
+		static const Block none = { nullptr, 0, 0, 0 };
+
+		if (address >= memorySize || !codeBuffer) {
+			return none;
+		}
+		Block &block = blocks[address];
+
+		if (block.size == 0 && !compile(address, block)) {
+			// Out of code space: start it over.
+			flush();
+			compile(address, block);
+		}
+		return block;
+	}
+
+	void Recompiler::flush() {
+		memset(blocks, 0x00, sizeof(Block) * memorySize);
+		memset(coverage, 0x00, memorySize);
+
+		if (codeUsed > 0) {
+			protect(0, codeUsed, false);
+		}
+		codeUsed = 0;
+	}
+
+	void Recompiler::flush(unsigned quirks) {
+		this->quirks = quirks;
+
+		flush();
+	}
+
+	void Recompiler::invalidateImpl(size_t address) {
+		size_t start = address >= BLOCK_SIZE_MAX ? address - BLOCK_SIZE_MAX + 1 : 0;
+
+		for (; start <= address; ++start) {
+			const Block &block = blocks[start];
+
+			if (block.size > 0 && start + block.size > address) {
+				drop(start);
+			}
+		}
+	}
+
+	void Recompiler::drop(size_t address) {
+		Block &block = blocks[address];
+
+		for (size_t i = 0; i < block.size; ++i) {
+			--coverage[address + i];
+		}
+		// Generated code is left in place until next flush.
+		memset(&block, 0x00, sizeof(Block));
+	}
+
+
+#define REGISTER_OF(slot) hosts[(slot)]
+
+	bool Recompiler::compile(word address, Block &block) {
+		size_t length = 0;
+		size_t end = address;
+
+		unsigned slots = 0;
+		bool terminated = false;
+
+		if (address >= programStart) {
+			while (length < BLOCK_LENGTH_MAX && end + 1 < memorySize) {
+				unsigned used;
+
+				if (!analyze(memory[end], memory[end + 1], quirks, used, terminated)
+					|| std::bitset<SLOTS_COUNT>(slots | used).count() > sizeof(allocatable) / sizeof(*allocatable)) {
+
+					terminated = false;
+					break;
+				}
+				slots |= used;
+				end += 2;
+				++length;
+
+				if (terminated) {
+					break;
+				}
+			}
+		}
+		block.code = nullptr;
+		block.length = 0;
+		block.size = word(std::min<size_t>(2, memorySize - address));
+		block.cyclesPrefix = 0;
+
+		// The page code goes on at may be executable, as it holds the end of the previous block.
+		if (length >= BLOCK_LENGTH_MIN && protect(codeUsed, codeUsed + 1, false)) {
+			Assembler assembler(codeBuffer + codeUsed, codeBuffer + CODE_BUFFER_SIZE);
+
+			Register hosts[SLOTS_COUNT];
+			unsigned saved = 0;
+
+			for (unsigned slot = 0, i = 0; slot < SLOTS_COUNT; ++slot) {
+				hosts[slot] = RAX;
+
+				if (!!(slots & SLOT(slot))) {
+					hosts[slot] = allocatable[i++];
+					saved |= SLOT(hosts[slot]) & calleeSaved;
+				}
+			}
+#if defined(_WIN32)
+			assembler.push(RDI);
+			assembler.mov64(RDI, RCX);
+#endif
+			for (auto reg : allocatable) {
+				if (!!(saved & SLOT(reg))) {
+					assembler.push(reg);
+				}
+			}
+			for (unsigned slot = 0; slot < SLOT_INDEX; ++slot) {
+				if (!!(slots & SLOT(slot))) {
+					assembler.loadb(REGISTER_OF(slot), ptrdiff_t(slot));
+				}
+			}
+			if (!!(slots & SLOT(SLOT_INDEX))) {
+				assembler.loadw(REGISTER_OF(SLOT_INDEX), layout.index);
+			}
+
+			unsigned dirty = 0;
+			size_t cycles = 0;
+			size_t cyclesPrefix = 0;
+
+			// Each instruction leaves the cycles it takes here. Terminators
+			// compute their cycles and the new pc in RAX and RDX on their own.
+			size_t cost = 0;
+
+			for (size_t offset = address; offset < end; offset += 2) {
+				byte hi = memory[offset];
+				byte lo = memory[offset + 1];
+
+				const bool shiftVY = !(quirks & InterpreterBase::QUIRK_SHIFT_VX);
+				const bool resetVF = !!(quirks & InterpreterBase::QUIRK_LOGIC_VF_RESET);
+
+				Register vx = REGISTER_OF(hi & 0x0F);
+				Register vy = REGISTER_OF(lo >> 4);
+
+				word value = word(((hi & 0x0F) << 8) | lo);
+				word next = word(offset + 2);
+
+				cyclesPrefix = cycles;
+				cost = 0;
+
+				switch (hi >> 4) {
+				case 0x1:
+					assembler.mov(RAX, uint32_t(cycles + COUNT_CYCLES_TAKEN_BY_GROUPN(12)));
+					assembler.mov(RDX, value);
+					break;
+
+				case 0x3: case 0x4: case 0x5: case 0x9: {
+					size_t costTrue = 14, costFalse = 10;
+
+					if ((hi >> 4) == 0x5 || (hi >> 4) == 0x9) {
+						assembler.alu(ALU_CMP, vx, vy);
+
+						costTrue = 18; costFalse = 14;
+					}
+					else {
+						assembler.alu(ALU_CMP, vx, uint32_t(lo));
+					}
+					assembler.mov(RAX, uint32_t(cycles + COUNT_CYCLES_TAKEN_BY_GROUPN(costFalse)));
+					assembler.mov(RDX, next);
+
+					// Moves leave flags intact, so the comparison is still there.
+					byte *label = assembler.jcc(
+						(hi >> 4) == 0x3 || (hi >> 4) == 0x5 ? CONDITION_NE : CONDITION_E);
+
+					assembler.mov(RAX, uint32_t(cycles + COUNT_CYCLES_TAKEN_BY_GROUPN(costTrue)));
+					assembler.mov(RDX, word(next + 2));
+					assembler.bind(label);
+				}	break;
+
+				case 0x6:
+					assembler.mov(vx, uint32_t(lo));
+
+					dirty |= SLOT(hi & 0x0F);
+					cost = COUNT_CYCLES_TAKEN_BY_GROUPN(6);
+					break;
+
+				case 0x7:
+					assembler.alu(ALU_ADD, vx, uint32_t(lo));
+					assembler.movzxb(vx, vx);
+
+					dirty |= SLOT(hi & 0x0F);
+					cost = COUNT_CYCLES_TAKEN_BY_GROUPN(10);
+					break;
+
+				case 0x8:
+					dirty |= SLOT(hi & 0x0F);
+					cost = COUNT_CYCLES_TAKEN_BY_GROUPN(44);
+
+					switch (lo & 0x0F) {
+					case 0x0:
+						assembler.mov(vx, vy);
+
+						cost = COUNT_CYCLES_TAKEN_BY_GROUPN(12);
+						break;
+					case 0x1: case 0x2: case 0x3: {
+						static const Alu logic[] = { ALU_OR, ALU_AND, ALU_XOR };
+
+						assembler.alu(logic[(lo & 0x0F) - 1], vx, vy);
+
+						if (resetVF) {
+							assembler.mov(REGISTER_OF(SLOT_VF), 0U);
+						}
+					}	break;
+
+					// Flag is always assigned last, so VF as VX ends up with the flag.
+					case 0x4:
+						assembler.mov(RAX, vx);
+						assembler.alu(ALU_ADD, RAX, vy);
+						assembler.mov(RDX, RAX);
+						assembler.shift(SHIFT_RIGHT, RDX, 8);
+						assembler.movzxb(vx, RAX);
+						assembler.mov(REGISTER_OF(SLOT_VF), RDX);
+						break;
+					case 0x5:
+					case 0x7:
+						if ((lo & 0x0F) == 0x5) {
+							assembler.mov(RAX, vx);
+							assembler.alu(ALU_SUB, RAX, vy);
+						}
+						else {
+							assembler.mov(RAX, vy);
+							assembler.alu(ALU_SUB, RAX, vx);
+						}
+						assembler.setcc(CONDITION_AE, RDX);
+						assembler.movzxb(RDX, RDX);
+						assembler.movzxb(vx, RAX);
+						assembler.mov(REGISTER_OF(SLOT_VF), RDX);
+						break;
+					case 0x6:
+						assembler.mov(RAX, shiftVY ? vy : vx);
+						assembler.mov(RDX, RAX);
+						assembler.alu(ALU_AND, RDX, 1U);
+						assembler.shift(SHIFT_RIGHT, RAX, 1);
+						assembler.mov(vx, RAX);
+						assembler.mov(REGISTER_OF(SLOT_VF), RDX);
+						break;
+					case 0xE:
+						assembler.mov(RAX, shiftVY ? vy : vx);
+						assembler.mov(RDX, RAX);
+						assembler.shift(SHIFT_RIGHT, RDX, 7);
+						assembler.shift(SHIFT_LEFT, RAX, 1);
+						assembler.movzxb(vx, RAX);
+						assembler.mov(REGISTER_OF(SLOT_VF), RDX);
+						break;
+					}
+					if ((lo & 0x0F) >= 0x4 || ((lo & 0x0F) != 0x0 && resetVF)) {
+						dirty |= SLOT(SLOT_VF);
+					}
+					break;
+
+				case 0xA:
+					assembler.mov(REGISTER_OF(SLOT_INDEX), uint32_t(value));
+
+					dirty |= SLOT(SLOT_INDEX);
+					cost = COUNT_CYCLES_TAKEN_BY_GROUPN(12);
+					break;
+
+				case 0xB:
+					assembler.mov(RDX, !!(quirks & InterpreterBase::QUIRK_JUMP_VX) ? vx : REGISTER_OF(0));
+					assembler.alu(ALU_ADD, RDX, uint32_t(value));
+					assembler.mov(RAX, uint32_t(cycles + COUNT_CYCLES_TAKEN_BY_GROUPN(22)));
+					break;
+
+				case 0xF:
+					switch (lo) {
+					case 0x07:
+						assembler.loadb(vx, layout.timerDelay);
+
+						dirty |= SLOT(hi & 0x0F);
+						cost = COUNT_CYCLES_TAKEN_BY_GROUPN(10);
+						break;
+					case 0x1E:
+						assembler.alu(ALU_ADD, REGISTER_OF(SLOT_INDEX), vx);
+						assembler.movzxw(REGISTER_OF(SLOT_INDEX), REGISTER_OF(SLOT_INDEX));
+
+						dirty |= SLOT(SLOT_INDEX);
+						cost = COUNT_CYCLES_TAKEN_BY_GROUPN(16);
+						break;
+					case 0x29:
+						assembler.imul(REGISTER_OF(SLOT_INDEX), vx, 5);
+
+						dirty |= SLOT(SLOT_INDEX);
+						cost = COUNT_CYCLES_TAKEN_BY_GROUPN(20);
+						break;
+					}
+					break;
+				}
+				cycles += cost;
+			}
+			if (!terminated) {
+				assembler.mov(RAX, uint32_t(cycles));
+				assembler.mov(RDX, uint32_t(end));
+			}
+			assembler.storew(RDX, layout.pc);
+
+			for (unsigned slot = 0; slot < SLOT_INDEX; ++slot) {
+				if (!!(dirty & SLOT(slot))) {
+					assembler.storeb(REGISTER_OF(slot), ptrdiff_t(slot));
+				}
+			}
+			if (!!(dirty & SLOT(SLOT_INDEX))) {
+				assembler.storew(REGISTER_OF(SLOT_INDEX), layout.index);
+			}
+			for (size_t i = sizeof(allocatable) / sizeof(*allocatable); i-- > 0;) {
+				if (!!(saved & SLOT(allocatable[i]))) {
+					assembler.pop(allocatable[i]);
+				}
+			}
+#if defined(_WIN32)
+			assembler.pop(RDI);
+#endif
+			assembler.ret();
+
+			if (assembler.isOverflow()) {
+				return false;
+			}
+			const size_t codeEnd = size_t(assembler.position() - codeBuffer);
+
+			if (protect(codeUsed, codeEnd, true)) {
+				block.code = reinterpret_cast<size_t (*) (byte *)>(codeBuffer + codeUsed);
+				block.length = word(length);
+				block.size = word(end - address);
+				block.cyclesPrefix = cyclesPrefix;
+
+				codeUsed = codeEnd;
+			}
+		}
+		for (size_t i = 0; i < block.size; ++i) {
+			++coverage[address + i];
+		}
+		return true;
+	}
+
+} // namespace chip8
+
+#endif // CHIP8_RECOMPILER
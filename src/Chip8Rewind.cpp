@@ -0,0 +1,149 @@
+#include "chip8/Chip8Rewind.h"
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+
+namespace chip8 {
+
+	// Each page of a delta goes with its index.
+#define DELTA_PAGE_SIZE (sizeof(word) + PAGE_SIZE)
+
+	Rewind::Rewind(size_t budget, unsigned interval)
+		: ring(budget), interval(interval) {
+
+		assert(interval > 0);
+		clear();
+	}
+
+
+	void Rewind::clear() {
+		records.clear();
+		tail = 0;
+
+		currentSize = 0;
+		frames = 0;
+	}
+
+	bool Rewind::push(const void *state, size_t size) {
+		assert(state);
+		assert(size > 0);
+
+		const byte *data = static_cast<const byte *>(state);
+		const size_t sizePadded = (std::max(size, currentSize) + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+
+		if (current.size() < sizePadded) {
+			current.resize(sizePadded, 0x00);
+		}
+		if (currentSize == 0) {
+			memcpy(current.data(), data, size);
+			currentSize = size;
+
+			return true;
+		}
+
+		// New state is compared as if it's zero padded as well.
+		changed.clear();
+		for (size_t offset = 0; offset < sizePadded; offset += PAGE_SIZE) {
+			const byte *page = current.data() + offset;
+			const size_t count = offset < size ? std::min<size_t>(size - offset, PAGE_SIZE) : 0;
+
+			bool same = memcmp(page, data + offset, count) == 0;
+			for (size_t i = count; same && i < PAGE_SIZE; ++i) {
+				same = page[i] == 0x00;
+			}
+			if (!same) {
+				changed.push_back(offset / PAGE_SIZE);
+			}
+		}
+
+		Record record = { 0, changed.size() * DELTA_PAGE_SIZE, currentSize, changed.size() };
+		byte *delta = allocate(record.length);
+
+		if (!!delta) {
+			record.offset = delta - ring.data();
+			records.push_back(record);
+		}
+		else {
+			clear();
+		}
+
+		for (size_t index : changed) {
+			const size_t offset = index * PAGE_SIZE;
+			const size_t count = offset < size ? std::min<size_t>(size - offset, PAGE_SIZE) : 0;
+
+			byte *page = current.data() + offset;
+			byte pageNext[PAGE_SIZE] = { 0x00 };
+			memcpy(pageNext, data + offset, count);
+
+			if (!!delta) {
+				const word pageIndex = word(index);
+				memcpy(delta, &pageIndex, sizeof(pageIndex));
+
+				for (size_t i = 0; i < PAGE_SIZE; ++i) {
+					delta[sizeof(word) + i] = page[i] ^ pageNext[i];
+				}
+				delta += DELTA_PAGE_SIZE;
+			}
+			memcpy(page, pageNext, PAGE_SIZE);
+		}
+		currentSize = size;
+
+		return !!delta;
+	}
+
+	size_t Rewind::rewind(size_t count) {
+		size_t steps = 0;
+
+		for (; steps < count && !records.empty(); ++steps) {
+			const Record &record = records.back();
+			const byte *delta = ring.data() + record.offset;
+
+			for (size_t i = 0; i < record.pagesCount; ++i, delta += DELTA_PAGE_SIZE) {
+				word pageIndex;
+				memcpy(&pageIndex, delta, sizeof(pageIndex));
+
+				byte *page = current.data() + pageIndex * PAGE_SIZE;
+				for (size_t j = 0; j < PAGE_SIZE; ++j) {
+					page[j] ^= delta[sizeof(word) + j];
+				}
+			}
+			currentSize = record.stateSize;
+
+			tail = record.offset;
+			records.pop_back();
+		}
+		frames = 0;
+
+		return steps;
+	}
+
+
+	// Deltas are laid out one after another and wrap to the ring start as a whole.
+	// Records, which are older, are found at the tail offset and above, the newer
+	// ones (those written since the last wrap) below it.
+	byte *Rewind::allocate(size_t length) {
+		if (length > ring.size()) {
+			return nullptr;
+		}
+		if (tail + length > ring.size()) {
+			while (!records.empty() && records.front().offset >= tail) {
+				records.pop_front();
+			}
+			tail = 0;
+		}
+		while (!records.empty() && records.front().offset >= tail
+			&& records.front().offset < tail + length) {
+
+			records.pop_front();
+		}
+		byte *result = ring.data() + tail;
+		tail += length;
+
+		return result;
+	}
+
+#undef DELTA_PAGE_SIZE
+
+} // namespace chip8
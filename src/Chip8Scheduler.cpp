@@ -0,0 +1,99 @@
+#include "chip8/Chip8Scheduler.h"
+
+#include <cassert>
+#include <algorithm>
+
+
+namespace chip8 {
+
+	Scheduler::Scheduler() {
+		clear();
+	}
+
+
+	bool Scheduler::schedule(const Event &event) {
+		if (count >= CAPACITY) {
+			return false;
+		}
+		size_t i = count++;
+
+		heap[i].event = event;
+		heap[i].sequence = sequence++;
+
+		while (i > 0) {
+			size_t parent = (i - 1) / 2;
+
+			if (!precedes(heap[i], heap[parent])) {
+				break;
+			}
+			std::swap(heap[i], heap[parent]);
+			i = parent;
+		}
+		return true;
+	}
+
+	Scheduler::Event Scheduler::pop() {
+		assert(count > 0);
+
+		Event result = heap[0].event;
+		heap[0] = heap[--count];
+
+		for (size_t i = 0;;) {
+			size_t least = i;
+			size_t left = 2 * i + 1;
+			size_t right = left + 1;
+
+			if (left < count && precedes(heap[left], heap[least])) {
+				least = left;
+			}
+			if (right < count && precedes(heap[right], heap[least])) {
+				least = right;
+			}
+			if (least == i) {
+				break;
+			}
+			std::swap(heap[i], heap[least]);
+			i = least;
+		}
+		return result;
+	}
+
+	void Scheduler::clear() {
+		count = 0;
+		sequence = 0;
+	}
+
+	size_t Scheduler::save(Event *events) const {
+		Entry entries[CAPACITY];
+
+		std::copy(heap, heap + count, entries);
+		std::sort(entries, entries + count, precedes);
+
+		for (size_t i = 0; i < count; ++i) {
+			events[i] = entries[i].event;
+		}
+		return count;
+	}
+
+	bool Scheduler::load(const Event *events, size_t count, bool (*valid) (const Event &)) {
+		assert(valid);
+		if (count > CAPACITY) {
+			return false;
+		}
+		for (size_t i = 0; i < count; ++i) {
+			if ((i > 0 && events[i].timestamp < events[i - 1].timestamp) || !valid(events[i])) {
+				return false;
+			}
+		}
+		// Sorted array is a valid heap already.
+		for (size_t i = 0; i < count; ++i) {
+			heap[i].event = events[i];
+			heap[i].sequence = i;
+		}
+		this->count = count;
+		sequence = count;
+
+		return true;
+	}
+
+} // namespace chip8
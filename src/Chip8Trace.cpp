@@ -0,0 +1,463 @@
+#include "chip8/Chip8Trace.h"
+
+#include <cassert>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+
+namespace chip8 {
+
+	// File is grown by this much at least, each time it's remapped.
+#define TRACE_FILE_CHUNK size_t(0x1000000)
+
+	// Writer yields that many times in a row, if there's nothing to drain, then it
+	// sleeps. A ring fills up in a millisecond at full speed, so it keeps up by yields.
+#define TRACE_WRITER_SPINS 0x1000
+#define TRACE_WRITER_IDLE std::chrono::milliseconds(1)
+
+	// Records drained before room is given back to the producer.
+#define TRACE_WRITER_SLICE size_t(0x400)
+
+	// ========================================================
+	// memory mapped file
+	// ========================================================
+
+	struct TraceRecorder::MappedFile {
+		byte *data;
+		size_t size;										// Bytes mapped.
+		size_t used;										// Bytes written.
+
+#if defined(_WIN32)
+		HANDLE handle;
+		HANDLE mapping;
+#else
+		int descriptor;
+#endif // _WIN32
+
+		MappedFile() : data(nullptr), size(0), used(0) {
+			/* Nothing to do */
+		}
+
+		bool create(const char *fileName);
+
+		// Make room for length bytes more, growing the file if it's needed.
+		bool reserve(size_t length);
+
+		// Cut the file down to the bytes written.
+		bool finish();
+
+	private:
+
+		bool map(size_t size);
+		void unmap();
+	};
+
+#if defined(_WIN32)
+
+	bool TraceRecorder::MappedFile::create(const char *fileName) {
+		mapping = nullptr;
+		handle = CreateFileA(fileName, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+			CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		return handle != INVALID_HANDLE_VALUE;
+	}
+
+	bool TraceRecorder::MappedFile::map(size_t size) {
+		const uint64_t size64 = size;
+
+		mapping = CreateFileMappingA(handle, nullptr, PAGE_READWRITE, DWORD(size64 >> 32), DWORD(size64), nullptr);
+		if (!mapping) {
+			return false;
+		}
+		data = static_cast<byte *>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size));
+		if (!data) {
+			return false;
+		}
+		this->size = size;
+
+		return true;
+	}
+
+	void TraceRecorder::MappedFile::unmap() {
+		if (!!data) {
+			UnmapViewOfFile(data);
+			data = nullptr;
+		}
+		if (!!mapping) {
+			CloseHandle(mapping);
+			mapping = nullptr;
+		}
+		size = 0;
+	}
+
+	bool TraceRecorder::MappedFile::finish() {
+		unmap();
+
+		LARGE_INTEGER length;
+		length.QuadPart = LONGLONG(used);
+
+		const bool result = !!SetFilePointerEx(handle, length, nullptr, FILE_BEGIN) && !!SetEndOfFile(handle);
+		CloseHandle(handle);
+
+		return result;
+	}
+
+#else
+
+	bool TraceRecorder::MappedFile::create(const char *fileName) {
+		descriptor = ::open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+		return descriptor >= 0;
+	}
+
+	bool TraceRecorder::MappedFile::map(size_t size) {
+		if (ftruncate(descriptor, off_t(size)) != 0) {
+			return false;
+		}
+		void *address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+		if (address == MAP_FAILED) {
+			return false;
+		}
+		data = static_cast<byte *>(address);
+		this->size = size;
+
+		return true;
+	}
+
+	void TraceRecorder::MappedFile::unmap() {
+		if (!!data) {
+			munmap(data, size);
+			data = nullptr;
+		}
+		size = 0;
+	}
+
+	bool TraceRecorder::MappedFile::finish() {
+		unmap();
+
+		const bool result = ftruncate(descriptor, off_t(used)) == 0;
+		::close(descriptor);
+
+		return result;
+	}
+
+#endif // _WIN32
+
+	bool TraceRecorder::MappedFile::reserve(size_t length) {
+		if (used + length <= size) {
+			return true;
+		}
+		const size_t sizeNew = size + std::max<size_t>(TRACE_FILE_CHUNK, size / 2);
+
+		unmap();
+
+		return map(sizeNew);
+	}
+
+
+	// ========================================================
+	// recording
+	// ========================================================
+
+	namespace {
+
+		// Encoded fields are little endian.
+		byte *put(byte *data, uint32_t value, size_t length) {
+			for (size_t i = 0; i < length; ++i) {
+				*data++ = byte(value >> (i * 8));
+			}
+			return data;
+		}
+
+		bool get(std::istream &stream, size_t length, uint32_t &value) {
+			value = 0;
+
+			for (size_t i = 0; i < length; ++i) {
+				const int c = stream.get();
+				if (c == EOF) {
+					return false;
+				}
+				value |= uint32_t(c) << (i * 8);
+			}
+			return true;
+		}
+
+	} // namespace
+
+	TraceRecorder::TraceRecorder(size_t capacity)
+		: headShared(0), head(0), tailCached(0), tailShared(0), stopping(false),
+		ring(capacity), failed(false), file(nullptr) {
+
+		assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+	}
+
+	TraceRecorder::~TraceRecorder() {
+		close();
+	}
+
+
+	bool TraceRecorder::open(const char *fileName) {
+		assert(fileName);
+		close();
+
+		file = new MappedFile;
+		if (!file->create(fileName)) {
+			delete file;
+			file = nullptr;
+
+			return false;
+		}
+
+		head = tailCached = 0;
+		headShared.store(0, std::memory_order_relaxed);
+		tailShared.store(0, std::memory_order_relaxed);
+		stopping.store(false, std::memory_order_relaxed);
+
+		cyclePrevious = 0;
+		pcPrevious = 0;
+		opcodesSeen.assign(0x10000, 0);
+
+		failed = !file->reserve(FILE_HEADER_SIZE);
+		if (!failed) {
+			byte *data = put(file->data, FILE_MAGIC, 4);
+			put(data, FILE_VERSION, 4);
+
+			file->used = FILE_HEADER_SIZE;
+		}
+
+		writer = std::thread(&TraceRecorder::drain, this);
+
+		return true;
+	}
+
+	bool TraceRecorder::close() {
+		if (!isOpen()) {
+			return !failed;
+		}
+		stopping.store(true, std::memory_order_release);
+		writer.join();
+
+		failed = !file->finish() || failed;
+
+		delete file;
+		file = nullptr;
+
+		return !failed;
+	}
+
+	void TraceRecorder::waitRoom() {
+		assert(isOpen());
+
+		while ((tailCached = tailShared.load(std::memory_order_acquire)) + ring.size() == head) {
+			std::this_thread::yield();
+		}
+	}
+
+	void TraceRecorder::drain() {
+		size_t tail = tailShared.load(std::memory_order_relaxed);
+		size_t spins = 0;
+
+		for (;;) {
+			const size_t headLocal = headShared.load(std::memory_order_acquire);
+
+			if (headLocal == tail) {
+				// Records made before stop was requested are all visible by now.
+				if (stopping.load(std::memory_order_acquire) && headShared.load(std::memory_order_acquire) == tail) {
+					break;
+				}
+				if (++spins < TRACE_WRITER_SPINS) {
+					std::this_thread::yield();
+				}
+				else {
+					std::this_thread::sleep_for(TRACE_WRITER_IDLE);
+				}
+				continue;
+			}
+			spins = 0;
+			// Records are dropped once a write fails, so that the producer never stalls.
+			// Room is given back to the producer a slice at a time.
+			// Slices don't wrap around the ring end.
+			while (tail != headLocal) {
+				const size_t offset = tail & (ring.size() - 1);
+				const size_t count = std::min<size_t>(std::min<size_t>(headLocal - tail, TRACE_WRITER_SLICE), ring.size() - offset);
+
+				if (!failed && !(failed = !file->reserve(count * RECORD_ENCODED_MAX))) {
+					file->used += encode(ring.data() + offset, count, file->data + file->used);
+				}
+				tail += count;
+				tailShared.store(tail, std::memory_order_release);
+			}
+		}
+	}
+
+	size_t TraceRecorder::encode(const Record *records, size_t count, byte *data) {
+		// State is kept local, as byte stores may alias the members.
+		uint32_t cycle = cyclePrevious;
+		word pc = pcPrevious;
+		word *const seen = opcodesSeen.data();
+
+		byte *out = data;
+
+		for (const Record *record = records; record != records + count; ++record) {
+			byte &header = *out++;
+			header = HEADER_MARK;
+
+			const uint32_t delta = record->cycle - cycle;
+
+			if (delta <= 0xFF) {
+				header |= HEADER_DELTA_BYTE;
+				out = put(out, delta, 1);
+			}
+			else if (delta <= 0xFFFF) {
+				header |= HEADER_DELTA_WORD;
+				out = put(out, delta, 2);
+			}
+			else {
+				header |= HEADER_DELTA_DWORD;
+				out = put(out, delta, 4);
+			}
+
+			const int pcDelta = int(record->pc) - int(word(pc + 2));
+
+			if (pcDelta == 0) {
+				header |= HEADER_PC_NEXT;
+			}
+			else if (pcDelta >= -0x80 && pcDelta < 0x80) {
+				header |= HEADER_PC_NEAR;
+				*out++ = byte(pcDelta);
+			}
+			else {
+				header |= HEADER_PC_FAR;
+				out = put(out, record->pc, 2);
+			}
+
+			word &opcodeSeen = seen[record->pc];
+
+			if (opcodeSeen == record->opcode) {
+				header |= HEADER_OPCODE_SEEN;
+			}
+			else {
+				out = put(out, record->opcode, 2);
+				opcodeSeen = record->opcode;
+			}
+
+			if (record->target != TARGET_NONE) {
+				header |= HEADER_TARGET;
+				*out++ = record->target;
+				out = put(out, record->value, record->target == TARGET_INDEX ? 2 : 1);
+			}
+			if (record->carry != CARRY_NONE) {
+				header |= HEADER_CARRY;
+				*out++ = record->carry;
+			}
+
+			cycle = record->cycle;
+			pc = record->pc;
+		}
+
+		cyclePrevious = cycle;
+		pcPrevious = pc;
+
+		return size_t(out - data);
+	}
+
+
+	// ========================================================
+	// decoding
+	// ========================================================
+
+	bool TraceRecorder::decode(std::istream &stream, std::ostream &text) {
+		uint32_t magic, version;
+
+		if (!get(stream, 4, magic) || !get(stream, 4, version) || magic != FILE_MAGIC || version != FILE_VERSION) {
+			return false;
+		}
+
+		clock cycle = 0;
+		word pc = 0;
+		std::vector<word> opcodes(0x10000, 0);
+
+		for (int header; (header = stream.get()) != EOF && header != 0;) {
+			if (!(header & HEADER_MARK)) {
+				return false;
+			}
+			static const size_t DELTA_LENGTHS[] = { 1, 2, 4, 0 };
+			uint32_t delta, field;
+
+			if (!get(stream, DELTA_LENGTHS[header & HEADER_DELTA_MASK], delta)) {
+				break;
+			}
+			cycle += delta;
+
+			switch (header & HEADER_PC_MASK) {
+			case HEADER_PC_NEXT:
+				pc = word(pc + 2);
+				break;
+
+			case HEADER_PC_NEAR:
+				if (!get(stream, 1, field)) {
+					return !!text;
+				}
+				pc = word(pc + 2 + static_cast<signed char>(field));
+				break;
+
+			case HEADER_PC_FAR:
+				if (!get(stream, 2, field)) {
+					return !!text;
+				}
+				pc = word(field);
+				break;
+
+			default:
+				return false;
+			}
+
+			if (!(header & HEADER_OPCODE_SEEN)) {
+				if (!get(stream, 2, field)) {
+					break;
+				}
+				opcodes[pc] = word(field);
+			}
+
+			char line[64];
+			int length = snprintf(line, sizeof(line), "%llu %04X %04X", cycle, unsigned(pc), unsigned(opcodes[pc]));
+
+			if (!!(header & HEADER_TARGET)) {
+				uint32_t target, value;
+
+				if (!get(stream, 1, target) || !get(stream, target == TARGET_INDEX ? 2 : 1, value)) {
+					break;
+				}
+				length += target == TARGET_INDEX
+					? snprintf(line + length, sizeof(line) - length, " I=%03X", unsigned(value))
+					: snprintf(line + length, sizeof(line) - length, " V%X=%02X", unsigned(target), unsigned(value));
+			}
+			if (!!(header & HEADER_CARRY)) {
+				if (!get(stream, 1, field)) {
+					break;
+				}
+				snprintf(line + length, sizeof(line) - length, " VF=%02X", unsigned(field));
+			}
+			text << line << '\n';
+		}
+		return !!text;
+	}
+
+#undef TRACE_FILE_CHUNK
+#undef TRACE_WRITER_SPINS
+#undef TRACE_WRITER_IDLE
+#undef TRACE_WRITER_SLICE
+
+} // namespace chip8
@@ -1,11 +1,12 @@
 #include "logger.h"
 
 #include <cstdarg>
+#include <memory>
 
 namespace logger {
 
 	namespace {
-		std::auto_ptr<ILogger> logger;
+		std::unique_ptr<ILogger> logger;
 	}
 	
 	void init(const LoggerInitializerBase &initializer) {